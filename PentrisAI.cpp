@@ -1,10 +1,239 @@
 #include "PentrisAI.h"
+#include "PentrisMCTS.h"
+#include <cstdlib>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    /*The heuristic field valuation behind PentrisAI::EvaluateField, templated over the field dimensions like the
+      PentrisFieldKernels (W = H = 0 uses the runtime width and height)*/
+    template<int W, int H>
+    int EvaluateFieldKernel(const PentrisField& field, PentrisAI::EvaluateScratch& scratch)
+    {
+        const int* blocks = field.blocks.data();
+        const int w = (W > 0) ? W : field.Width();
+        const int h = (H > 0) ? H : field.Height();
+        int eval = 0;
+        int maxHeight = 0;
+        //The number of empty blocks in each row (on the stack if the height is known at compile time)
+        int rowBuffer[(H > 0) ? H : 1] = {};
+        if (H == 0)
+            scratch.rows.assign(h, 0);
+        int* blocksMissingRow = (H > 0) ? rowBuffer : scratch.rows.data();
+        //The number of empty blocks above the highest block in the previous column
+        int blocksMissingPrevCol = 0;
+        int avg = 0;
+        //The loop will detect overhangs; count empty blocks in rows; count empty blocks in columns; sum up column height differences
+        for (int i = 1; i < w - 1; i++)
+        {
+            int columnHeight = 0;
+            //Rows above the stack top are empty: they hold no overhangs and no column tops
+            for (int j = field.StackTop(); j < h - 1; j++)
+            {
+                const int block = blocks[i + j * w];
+                if ((block != 0) && (columnHeight == 0))
+                    columnHeight = (h - j - 1);
+                else if (block == 0)
+                {
+                    //j loops from top to bottom. If columnHeight was already set in a prior loop, then an overhang must exist
+                    if (columnHeight > 0)
+                        eval -= 50;
+
+                    blocksMissingRow[j]++;
+                }
+            }
+            const int blocksMissingCol = h - columnHeight - 1;
+
+            if (columnHeight > maxHeight)
+                maxHeight = columnHeight;
+
+            //Add up the height difference between subsequent columns for later averaging
+            if (i > 1)
+                avg += abs(blocksMissingCol - blocksMissingPrevCol);
+            blocksMissingPrevCol = blocksMissingCol;
+        }
+        //Punish extreme height differences between columns
+        avg = (int)(avg * 20 / (w - 2));
+        eval -= avg;
+
+        //Reward filled rows (including those the search has already cleared)
+        eval += 30 * field.ClearedRows();
+        for (int j = field.StackTop(); j < h - 1; j++)
+            if (blocksMissingRow[j] == 0)
+                eval += 30;
+
+        //Punish by height
+        eval -= maxHeight;
+
+        //Punish a field height at which the game would be lost
+        if (h - maxHeight <= PentrisFieldKernels::PENTOMINO_WIDTH + 1)
+            eval -= 2000;
+        return eval;
+    }
+
+    /*The same valuation as EvaluateFieldKernel, computed on the row bitsets for boards of any size.
+      Only the rows between the stack top and the floor are visited, a word at a time; the cost per leaf grows with the
+      width and the height of the stack rather than with the area of the board*/
+    int EvaluateFieldBitsKernel(const PentrisField& field, PentrisAI::EvaluateScratch& scratch)
+    {
+        const int w = field.Width();
+        const int h = field.Height();
+        const int words = field.WordsPerRow();
+        const std::uint64_t* interior = field.InteriorMask();
+        std::vector<int>& columnHeight = scratch.columns;
+        columnHeight.assign(w, 0);
+        //Bits of the columns whose top block has already been passed
+        std::vector<std::uint64_t>& covered = scratch.words;
+        covered.assign(words, 0);
+        //Rows the search has already cleared count as filled rows
+        int eval = 30 * field.ClearedRows();
+        for (int j = field.StackTop(); j < h - 1; j++)
+        {
+            const std::uint64_t* row = field.RowBits(j);
+            bool filledRow = true;
+            for (int k = 0; k < words; k++)
+            {
+                const std::uint64_t cells = row[k] & interior[k];
+                if (cells != interior[k])
+                    filledRow = false;
+                //Empty cells below the top block of their column are overhangs
+                eval -= 50 * PentrisFieldKernels::PopCount(covered[k] & ~cells);
+                std::uint64_t newTops = cells & ~covered[k];
+                while (newTops != 0)
+                {
+                    columnHeight[k * PentrisFieldKernels::BITS_PER_WORD + PentrisFieldKernels::LowestBit(newTops)] = h - j - 1;
+                    newTops &= newTops - 1;
+                }
+                covered[k] |= cells;
+            }
+            //Reward filled rows
+            if (filledRow)
+                eval += 30;
+        }
+        int maxHeight = 0;
+        int avg = 0;
+        for (int i = 1; i < w - 1; i++)
+        {
+            maxHeight = std::max(maxHeight, columnHeight[i]);
+            if (i > 1)
+                avg += abs(columnHeight[i] - columnHeight[i - 1]);
+        }
+        //Punish extreme height differences between columns
+        eval -= (int)(avg * 20 / (w - 2));
+        //Punish by height
+        eval -= maxHeight;
+        //Punish a field height at which the game would be lost
+        if (h - maxHeight <= PentrisFieldKernels::PENTOMINO_WIDTH + 1)
+            eval -= 2000;
+        return eval;
+    }
+
+    /*An upper bound on the heuristic valuation of every leaf one more pentomino can lead to from field (the leaves keep the
+      rows they complete, see EvaluateFieldKernel). Its five blocks can only raise columns, so the height and the danger
+      penalty cannot shrink. They complete at most the rows whose gaps add up to five or less. They change the column
+      heights of at most five neighbouring columns, hence at most six of the height differences. And they fill at most
+      five holes - only holes next to an empty block above its column's top, since the search's pentominos drop straight
+      down from the empty spawn rows and then tuck one column sideways at most*/
+    int HeuristicChildBound(const PentrisField& field, PentrisAI::EvaluateScratch& scratch)
+    {
+        const int* blocks = field.blocks.data();
+        const int w = field.Width();
+        const int h = field.Height();
+        const int top = field.StackTop();
+        //The row of each column's top block (h - 1 for an empty column)
+        std::vector<int>& columnTop = scratch.columns;
+        columnTop.assign(w, h - 1);
+        for (int i = 1; i < w - 1; i++)
+            for (int j = top; j < h - 1; j++)
+                if (blocks[i + j * w] != 0)
+                {
+                    columnTop[i] = j;
+                    break;
+                }
+        int holes = 0, openHoles = 0, filledRows = 0;
+        //The number of rows missing 1 to PENTOMINO_WIDTH blocks
+        int rowsMissing[PentrisFieldKernels::PENTOMINO_WIDTH + 1] = {};
+        for (int j = top; j < h - 1; j++)
+        {
+            int missing = 0;
+            for (int i = 1; i < w - 1; i++)
+            {
+                if (blocks[i + j * w] != 0)
+                    continue;
+                missing++;
+                if (j > columnTop[i])
+                {
+                    holes++;
+                    if (((i > 1) && (blocks[i - 1 + j * w] == 0) && (j < columnTop[i - 1])) ||
+                        ((i < w - 2) && (blocks[i + 1 + j * w] == 0) && (j < columnTop[i + 1])))
+                        openHoles++;
+                }
+            }
+            if (missing == 0)
+                filledRows++;
+            else if (missing <= PentrisFieldKernels::PENTOMINO_WIDTH)
+                rowsMissing[missing]++;
+        }
+        //The empty rows above the stack, should the field be that narrow
+        if (w - 2 <= PentrisFieldKernels::PENTOMINO_WIDTH)
+            rowsMissing[w - 2] += top;
+        //A pentomino spawning into the stack could end up anywhere
+        const int fillableHoles = std::min(PentrisFieldKernels::PENTOMINO_WIDTH, (top < PentrisFieldKernels::PENTOMINO_WIDTH) ? holes : openHoles);
+        int completableRows = 0, blocksLeft = PentrisFieldKernels::PENTOMINO_WIDTH;
+        for (int missing = 1; missing <= PentrisFieldKernels::PENTOMINO_WIDTH; missing++)
+        {
+            const int rows = std::min(rowsMissing[missing], blocksLeft / missing);
+            completableRows += rows;
+            blocksLeft -= rows * missing;
+        }
+        //Sum of the height differences, less the largest sum that one placement can touch
+        int maxHeight = 0, differences = 0, largestWindow = 0;
+        std::vector<int>& difference = scratch.differences;
+        difference.assign(w, 0);
+        for (int i = 1; i < w - 1; i++)
+        {
+            maxHeight = std::max(maxHeight, h - 1 - columnTop[i]);
+            if (i > 1)
+            {
+                difference[i] = std::abs(columnTop[i] - columnTop[i - 1]);
+                differences += difference[i];
+            }
+        }
+        for (int a = 1; a < w - 1; a++)
+        {
+            int window = 0;
+            for (int i = a; (i <= a + PentrisFieldKernels::PENTOMINO_WIDTH) && (i < w - 1); i++)
+                window += difference[i];
+            largestWindow = std::max(largestWindow, window);
+        }
+        int bound = 30 * (field.ClearedRows() + filledRows + completableRows);
+        bound -= 50 * std::max(0, holes - fillableHoles);
+        bound -= (int)(std::max(0, differences - largestWindow) * 20 / (w - 2));
+        bound -= maxHeight;
+        if (h - maxHeight <= PentrisFieldKernels::PENTOMINO_WIDTH + 1)
+            bound -= 2000;
+        return bound;
+    }
+
+    //Field sizes with a specialised evaluation kernel (kept in line with the PentrisField kernel tables).
+    //The last entry is the fallback for all other sizes, including giant boards
+    const struct {
+        int width;
+        int height;
+        PentrisAI::EvaluateKernel kernel;
+    } EVALUATE_KERNELS[] = {
+        { 18, 35, &EvaluateFieldKernel<18, 35> },
+        { 12, 22, &EvaluateFieldKernel<12, 22> },
+        { 0, 0, &EvaluateFieldBitsKernel }
+    };
+}
 
 /*Returns the valuation for the best found move and stores the best found move sequence into the bestMoveSequence member variable.
   maxDepth can be either 0 (in which case only the terminal positions of the current falling pentomino are enumerated and evaluated),
   or maxDepth can be 1 (in which case, through recursion, the next pentomino is also accounted for - i.e. the terminal positions of the
   current followed by next pentomino are enumerated and evaluated)*/
-int PentrisAI::CalculateMoveSequence_Recursive(PentrisField field, unsigned char depth, unsigned char maxDepth)
+int PentrisAI::CalculateMoveSequence_Recursive(PentrisField& field, unsigned char depth, unsigned char maxDepth)
 {
     //Stores the currently analyzed move sequence
     std::vector<MoveData> moveSequence;
@@ -12,11 +241,11 @@ int PentrisAI::CalculateMoveSequence_Recursive(PentrisField field, unsigned char
     int eval;
     //Stores the worst-case valuation
     int maxEval = std::numeric_limits<int>::min();
-    if (interrupt)
+    if (OutOfTime())
     {
-        calculating = false;
+        stats.interrupted = true;
         return maxEval + 1;
-    } 
+    }
     
     //Look at the current or next pentomino depending on depth 0 or 1
     std::vector<int> pentomino;
@@ -27,6 +256,7 @@ int PentrisAI::CalculateMoveSequence_Recursive(PentrisField field, unsigned char
         posY = field.pentominoY;
         pentomino = field.currentPentomino;
         bestMoveSequence.clear();
+        bestPlacement = Placement();
     }
     else
     {
@@ -36,6 +266,9 @@ int PentrisAI::CalculateMoveSequence_Recursive(PentrisField field, unsigned char
         if (!field.DoesPentominoFit(pentomino, posX, posY))
             return maxEval + 1;
     }
+    //The orientation index of pentomino, kept in step with its reflections and rotations (only needed to record placements)
+    const int initialOrientation = (depth == recordDepth) ? field.PentominoOrientation(pentomino) : 0;
+    int orientation = initialOrientation;
     
     //OUTERMOST LOOP 1 to enumerate moves - reflections
     for (int reflect = 0; reflect < 2; reflect++)
@@ -48,12 +281,16 @@ int PentrisAI::CalculateMoveSequence_Recursive(PentrisField field, unsigned char
             (pentomino[field.PENTOMINO_MID_INDEX] == 6) ||
             (pentomino[field.PENTOMINO_MID_INDEX] == 8) ||
             (pentomino[field.PENTOMINO_MID_INDEX] == 9)))
+        {
+            stats.duplicatesSkipped++;
             continue;
+        }
 
         bool reflected = false;
         if ((reflect == 1) && field.DoesPentominoFit(field.ReflectPentomino(pentomino), posX, posY))
         {
             pentomino = field.ReflectPentomino((depth == 0) ? (field.currentPentomino) : (field.nextPentomino));
+            orientation = ((initialOrientation & 4) ^ 4) | ((4 - (initialOrientation & 3)) & 3);
             moveSequence.push_back(MoveData(MoveType::REFLECT, 1));
             reflected = true;
         }
@@ -63,14 +300,21 @@ int PentrisAI::CalculateMoveSequence_Recursive(PentrisField field, unsigned char
         {
             //Account for rotation symmetries: Pentomino 10 is rotation invariant, pentominos 2 and 12 are invariant to 180 degree rotation
             if ((rotate >= 1) && ((pentomino[field.PENTOMINO_MID_INDEX] == 10)))
+            {
+                stats.duplicatesSkipped++;
                 continue;
+            }
             if ((rotate >= 2) && ((pentomino[field.PENTOMINO_MID_INDEX] == 2) || 
                 (pentomino[field.PENTOMINO_MID_INDEX] == 12)))
+            {
+                stats.duplicatesSkipped++;
                 continue;
+            }
             bool rotated = false;
             if ((rotate >= 1) && field.DoesPentominoFit(field.RotatePentomino(pentomino), posX, posY))
             {
                 pentomino = field.RotatePentomino(pentomino);
+                orientation = (orientation & 4) | ((orientation + 1) & 3);
                 moveSequence.push_back(MoveData(MoveType::ROTATE, rotate));
                 rotated = true;
             }
@@ -78,24 +322,92 @@ int PentrisAI::CalculateMoveSequence_Recursive(PentrisField field, unsigned char
             int pentominoBoundRight = field.PentominoBoundRight(pentomino);
             int pentominoBoundBottom = field.PentominoBoundBottom(pentomino);
 
+            //While only placements are enumerated (see EnumeratePlacements), nothing is evaluated on the field and it is left untouched
+            const bool enumerating = (recordDepth == 0);
+
+            //Lambda function to count a generated terminal placement at the current depth
+            auto CountNode = [&]()
+            {
+                if (depth < SearchStats::MAX_DEPTH)
+                    stats.nodesPerDepth[depth]++;
+            };
+
+            //Lambda function to store a new best sequence at depth 0 (and note when the first one was found)
+            auto SetBestMoveSequence = [&](const std::vector<MoveData>& sequence, int terminalX, int terminalY)
+            {
+                if (bestMoveSequence.empty())
+                    stats.timeToFirstMoveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - searchStarted).count();
+                bestMoveSequence = sequence;
+                bestPlacement.pentominoId = field.PentominoId(pentomino);
+                bestPlacement.orientation = field.PentominoOrientation(pentomino);
+                bestPlacement.posX = terminalX;
+                bestPlacement.posY = terminalY;
+                //Enumerated placements are not valued, and may belong to another pentomino than the search's
+                if (!enumerating)
+                    PublishBest(eval, false);
+                //Keep the children of the new best placement, with the field they were enumerated on
+                if (maxDepth > 0)
+                {
+                    std::swap(bestChildren, branchChildren);
+                    bestChildren.fieldHash = branchFieldHash;
+                    bestChildren.pentominoId = field.PentominoId(field.nextPentomino);
+                }
+            };
+
+            //Lambda function to evaluate the field holding the placement at the end of moveSequence
+            auto EvaluatePlacement = [&](int terminalX, int terminalY)
+            {
+                CountNode();
+                if (depth == recordDepth)
+                {
+                    Placement child;
+                    child.pentominoId = pentomino[field.PENTOMINO_MID_INDEX];
+                    child.orientation = orientation;
+                    child.posX = terminalX;
+                    child.posY = terminalY;
+                    branchChildren.Add(child, moveSequence);
+                }
+                if (depth == maxDepth)
+                {
+                    if (enumerating)
+                        return 0;
+                    stats.leavesEvaluated++;
+                    const int leafEval = Evaluate(field);
+                    if (depth == recordDepth)
+                        branchChildren.evals.push_back(leafEval);
+                    return leafEval;
+                }
+                if (depth == 0)
+                    branchChildren.Clear();
+                //The next ply plays on the field without the rows this placement completes
+                RowClearUndo& undo = clearUndo[depth];
+                field.ClearRows(terminalY, terminalY + field.PENTOMINO_WIDTH - 1, undo);
+                const int childEval = CalculateMoveSequence_Recursive(field, depth + 1, maxDepth);
+                if (depth == 0)
+                    branchFieldHash = field.Hash();
+                else if (depth == recordDepth)
+                    branchChildren.evals.push_back(childEval);
+                field.UndoClearRows(undo);
+                return childEval;
+            };
+
             //Lambda function to encapsulate a hard drop at "offset" to posX
             auto HardDrop = [&](int offset, int terminalY)
             {
                 moveSequence.push_back(MoveData(MoveType::HARD_DROP, posX + offset));
                 //MOVE SEQUENCE ENDED - evaluate field and undo
-                field.InsertPentomino(pentomino, posX + offset, terminalY);
-                if (depth == maxDepth)
-                    eval = EvaluateField(field);
-                else
-                    eval = CalculateMoveSequence_Recursive(field, depth + 1, maxDepth);
+                if (!enumerating)
+                    field.InsertPentomino(pentomino, posX + offset, terminalY);
+                eval = EvaluatePlacement(posX + offset, terminalY);
                 //Check if new optimum found
                 if (eval > maxEval)
                 {
                     if (depth == 0)
-                        bestMoveSequence = moveSequence;
+                        SetBestMoveSequence(moveSequence, posX + offset, terminalY);
                     maxEval = eval;
                 }
-                field.RemovePentomino(pentomino, posX + offset, terminalY);
+                if (!enumerating)
+                    field.RemovePentomino(pentomino, posX + offset, terminalY);
                 moveSequence.pop_back();
             };
 
@@ -110,18 +422,17 @@ int PentrisAI::CalculateMoveSequence_Recursive(PentrisField field, unsigned char
                     moveSequence.push_back(MoveData((offset_offset < 0) ? MoveType::LEFT : MoveType::RIGHT, posX + offset + offset_offset));
                     moveSequence.push_back(MoveData(MoveType::HARD_DROP, 1));
                     //MOVE SEQUENCE ENDED - evaluate field and undo
-                    field.InsertPentomino(pentomino, posX + offset + offset_offset, terminalY);
-                    if (depth == maxDepth)
-                        eval = EvaluateField(field);
-                    else
-                        eval = CalculateMoveSequence_Recursive(field, depth + 1, maxDepth);
+                    if (!enumerating)
+                        field.InsertPentomino(pentomino, posX + offset + offset_offset, terminalY);
+                    eval = EvaluatePlacement(posX + offset + offset_offset, terminalY);
                     if (eval > maxEval)
                     {
                         if (depth == 0)
-                            bestMoveSequence = moveSequence;
+                            SetBestMoveSequence(moveSequence, posX + offset + offset_offset, terminalY);
                         maxEval = eval;
                     }
-                    field.RemovePentomino(pentomino, posX + offset + offset_offset, terminalY);
+                    if (!enumerating)
+                        field.RemovePentomino(pentomino, posX + offset + offset_offset, terminalY);
 
                     moveSequence.pop_back();
                     moveSequence.pop_back();
@@ -173,80 +484,667 @@ int PentrisAI::CalculateMoveSequence_Recursive(PentrisField field, unsigned char
         if (reflected)
             moveSequence.pop_back();
     }
-    if (depth == 0)
-        calculating = false;
     return maxEval;
 }
 
-int PentrisAI::EvaluateField(const PentrisField field)
+/*Returns true if the root placements of a search on field are the children retained from the previous search:
+  the same blocks, the same pentomino, and the pentomino still in its spawn position*/
+bool PentrisAI::CanReuseRoot(const PentrisField& field) const
+{
+    return !retainedChildren.placements.empty() &&
+        (field.pentominoX == field.Width() / 2 - field.PENTOMINO_WIDTH / 2) && (field.pentominoY == 0) &&
+        (field.PentominoId(field.currentPentomino) == retainedChildren.pentominoId) &&
+        (field.currentPentomino == field.GetPentomino(retainedChildren.pentominoId)) &&
+        (field.Hash() == retainedChildren.fieldHash);
+}
+
+/*Depth 0 of CalculateMoveSequence_Recursive, with the root placements taken from retainedChildren instead of being enumerated.
+  They are visited in the order the enumeration generates them, so the result is the same*/
+int PentrisAI::SearchRetainedRoot(PentrisField& field, unsigned char maxDepth)
 {
-    evalCalls++;
-    int eval = 0;
-    int maxHeight = 0;
-    //The number of empty blocks in each row
-    std::vector<int> blocksMissingRow;
-    blocksMissingRow.resize(field.Height() - 1, 0);
-    //The number of empty blocks above the highest block in each column
-    std::vector<int> blocksMissingCol;
-    blocksMissingCol.resize(field.Width() - 2, 0);
-    int avg = 0;
-    //The loop will detect overhangs; count empty blocks in rows; count empty blocks in columns; sum up column height differences
-    for (int i = 1; i < field.Width() - 1; i++)
+    int maxEval = std::numeric_limits<int>::min();
+    bestMoveSequence.clear();
+    bestPlacement = Placement();
+    if (OutOfTime())
+    {
+        stats.interrupted = true;
+        return maxEval + 1;
+    }
+    for (size_t i = 0; i < retainedChildren.placements.size(); i++)
     {
-        int columnHeight = 0;
-        for (int j = 0; j < field.Height() - 1; j++)
+        const Placement& placement = retainedChildren.placements[i];
+        const std::vector<int> pentomino = field.OrientPentomino(placement.pentominoId, placement.orientation);
+        field.InsertPentomino(pentomino, placement.posX, placement.posY);
+        stats.nodesPerDepth[0]++;
+        int eval;
+        if (maxDepth == 0)
         {
+            stats.leavesEvaluated++;
+            eval = Evaluate(field);
+        }
+        else
+        {
+            branchChildren.Clear();
+            field.ClearRows(placement.posY, placement.posY + field.PENTOMINO_WIDTH - 1, clearUndo[0]);
+            eval = CalculateMoveSequence_Recursive(field, 1, maxDepth);
+            branchFieldHash = field.Hash();
+            field.UndoClearRows(clearUndo[0]);
+        }
+        if (eval > maxEval)
+        {
+            if (bestMoveSequence.empty())
+                stats.timeToFirstMoveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - searchStarted).count();
+            bestMoveSequence.assign(retainedChildren.moves.begin() + retainedChildren.moveStart[i], retainedChildren.moves.begin() + retainedChildren.moveStart[i + 1]);
+            bestPlacement = placement;
+            bestPlacement.orientation = field.PentominoOrientation(pentomino);
+            PublishBest(eval, false);
+            if (maxDepth > 0)
+            {
+                std::swap(bestChildren, branchChildren);
+                bestChildren.fieldHash = branchFieldHash;
+                bestChildren.pentominoId = field.PentominoId(field.nextPentomino);
+            }
+            maxEval = eval;
+        }
+        field.RemovePentomino(pentomino, placement.posX, placement.posY);
+    }
+    return maxEval;
+}
+
+/*The two-ply search with branch and bound, for the built-in heuristic. Every root placement is evaluated on its own first
+  (at depth 0) and given an upper bound on what its subtree can reach (see HeuristicChildBound). The subtrees are then
+  searched best first, skipping those whose bound cannot beat the best move so far. Among equally valued placements the
+  one that comes first in enumeration order wins, as in the exhaustive search, so the result is the same.
+  Retained root placements are not evaluated again: they are ordered by the valuations the previous search gave them as
+  leaves. Those differ slightly from a fresh evaluation (the rows of the previous move were only cleared by the search, and
+  a leaf keeps the rows it completes), but the order only decides how early the bounds prune, not the result*/
+int PentrisAI::SearchBranchAndBound(PentrisField& field, unsigned char maxDepth)
+{
+    int maxEval = std::numeric_limits<int>::min();
+    bestMoveSequence.clear();
+    bestPlacement = Placement();
+    if (OutOfTime())
+    {
+        stats.interrupted = true;
+        return maxEval + 1;
+    }
+    if (!stats.rootReused)
+        EnumerateQuietly(field, rootCandidates);
+    const CandidateList& roots = stats.rootReused ? retainedChildren : rootCandidates;
+    const size_t count = roots.placements.size();
+    const bool valued = (roots.evals.size() == count);
+    stats.nodesPerDepth[0] += (std::uint32_t)count;
+    rootScores.resize(count);
+    rootBounds.resize(count);
+    rootOrder.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        const Placement& placement = roots.placements[i];
+        const std::vector<int> pentomino = field.OrientPentomino(placement.pentominoId, placement.orientation);
+        field.InsertPentomino(pentomino, placement.posX, placement.posY);
+        field.ClearRows(placement.posY, placement.posY + field.PENTOMINO_WIDTH - 1, clearUndo[0]);
+        if (valued)
+            rootScores[i] = roots.evals[i];
+        else
+        {
+            stats.leavesEvaluated++;
+            rootScores[i] = Evaluate(field);
+        }
+        rootBounds[i] = HeuristicChildBound(field, searchScratch);
+        field.UndoClearRows(clearUndo[0]);
+        field.RemovePentomino(pentomino, placement.posX, placement.posY);
+        rootOrder[i] = i;
+    }
+    std::sort(rootOrder.begin(), rootOrder.end(), [this](const size_t a, const size_t b)
+        { return (rootScores[a] != rootScores[b]) ? (rootScores[a] > rootScores[b]) : (a < b); });
+    size_t bestIndex = count;
+    for (const size_t i : rootOrder)
+    {
+        //A bound equal to the best can only win the tie if the placement comes first in enumeration order
+        if ((rootBounds[i] < maxEval) || ((rootBounds[i] == maxEval) && (i > bestIndex)))
+        {
+            stats.subtreesPruned++;
+            continue;
+        }
+        const Placement& placement = roots.placements[i];
+        const std::vector<int> pentomino = field.OrientPentomino(placement.pentominoId, placement.orientation);
+        field.InsertPentomino(pentomino, placement.posX, placement.posY);
+        field.ClearRows(placement.posY, placement.posY + field.PENTOMINO_WIDTH - 1, clearUndo[0]);
+        branchChildren.Clear();
+        const int eval = CalculateMoveSequence_Recursive(field, 1, maxDepth);
+        branchFieldHash = field.Hash();
+        field.UndoClearRows(clearUndo[0]);
+        if ((eval > maxEval) || ((eval == maxEval) && (i < bestIndex)))
+        {
+            if (bestMoveSequence.empty())
+                stats.timeToFirstMoveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - searchStarted).count();
+            bestMoveSequence.assign(roots.moves.begin() + roots.moveStart[i], roots.moves.begin() + roots.moveStart[i + 1]);
+            bestPlacement = placement;
+            bestPlacement.orientation = field.PentominoOrientation(pentomino);
+            PublishBest(eval, false);
+            std::swap(bestChildren, branchChildren);
+            bestChildren.fieldHash = branchFieldHash;
+            bestChildren.pentominoId = field.PentominoId(field.nextPentomino);
+            maxEval = eval;
+            bestIndex = i;
+        }
+        field.RemovePentomino(pentomino, placement.posX, placement.posY);
+        if (stats.interrupted)
+            break;
+    }
+    return maxEval;
+}
+
+/*Writes the terminal placements of the field's current pentomino (starting from its current position and orientation)
+  into candidates, in the order the search enumerates them. Overwrites bestMoveSequence, bestPlacement and the statistics,
+  but publishes nothing (CurrentBest is left as it was)*/
+void PentrisAI::EnumeratePlacements(const PentrisField& field, CandidateList& candidates)
+{
+    stats = SearchStats();
+    evaluateKernel = SelectEvaluateKernel(field);
+    PentrisField enumerationField = field;
+    branchChildren.Clear();
+    recordDepth = 0;
+    CalculateMoveSequence_Recursive(enumerationField, 0, 0);
+    recordDepth = 1;
+    std::swap(candidates, branchChildren);
+    candidates.fieldHash = field.Hash();
+    candidates.pentominoId = field.PentominoId(field.currentPentomino);
+}
+
+int PentrisAI::EvaluateField(const PentrisField& field)
+{
+    if (evaluator)
+        return evaluator->Evaluate(field);
+    return SelectEvaluateKernel(field)(field, fieldScratch);
+}
+
+/*Returns the EvaluateField kernel specialised for the field's dimensions (or the runtime-sized one)*/
+PentrisAI::EvaluateKernel PentrisAI::SelectEvaluateKernel(const PentrisField& field)
+{
+    for (const auto& entry : EVALUATE_KERNELS)
+        if (((entry.width == field.Width()) && (entry.height == field.Height())) || (entry.width == 0))
+            return entry.kernel;
+    return nullptr;
+}
+
+/*Runs the search synchronously on the calling thread and returns the valuation of the best move.
+  The best move is stored in bestMoveSequence and bestPlacement, and the search statistics are published
+  (and streamed to the log if one is open)*/
+int PentrisAI::Search(const PentrisField& field, unsigned char maxDepth)
+{
+    stats = SearchStats();
+    evaluateKernel = SelectEvaluateKernel(field);
+    searchStarted = std::chrono::steady_clock::now();
+    bestMoveSequence.clear();
+    bestPlacement = Placement();
+    PublishBest(0, false);
+    //The recursion works on a single copy of the field, inserting and removing pentominos in place
+    PentrisField searchField = field;
+    bestChildren.Clear();
+    if (PlayFromBook(field, maxDepth))
+    {
+        FinishSearch(maxDepth);
+        return stats.bestEval;
+    }
+    stats.rootReused = !mcts && CanReuseRoot(field);
+    //Under a deadline, the best depth 0 move comes first: it is played should the deeper search run out of time
+    const bool fallback = (deadlineUs > 0) && !mcts && (maxDepth > 0);
+    int fallbackEval = 0;
+    std::vector<MoveData> fallbackMoveSequence;
+    Placement fallbackPlacement;
+    if (fallback)
+    {
+        fallbackEval = CalculateMoveSequence_Recursive(searchField, 0, 0);
+        fallbackMoveSequence = bestMoveSequence;
+        fallbackPlacement = bestPlacement;
+        deadline = searchStarted + std::chrono::microseconds(deadlineUs);
+        deadlineArmed = true;
+    }
+    if (mcts)
+        stats.bestEval = SearchMCTS(field);
+    else if (pruning && !evaluator && (maxDepth == 1))
+        stats.bestEval = SearchBranchAndBound(searchField, maxDepth);
+    else if (stats.rootReused)
+        stats.bestEval = SearchRetainedRoot(searchField, maxDepth);
+    else
+        stats.bestEval = CalculateMoveSequence_Recursive(searchField, 0, maxDepth);
+    deadlineArmed = false;
+    //Cut short by the clock rather than by interrupt
+    if (fallback && stats.interrupted && !interrupt)
+    {
+        stats.interrupted = false;
+        stats.deadlineMissed = true;
+        stats.bestEval = fallbackEval;
+        bestMoveSequence = fallbackMoveSequence;
+        bestPlacement = fallbackPlacement;
+    }
+    FinishSearch(maxDepth);
+    return stats.bestEval;
+}
 
-            if ((field(i,j) != 0) && (columnHeight == 0)) 
-                columnHeight = (field.Height() - j - 1);
-            else if (field(i, j) == 0)
+void PentrisAI::FinishSearch(unsigned char maxDepth)
+{
+    //Retain the chosen placement's children for the next search (unless the search was cut short and they are incomplete)
+    if (stats.interrupted || stats.deadlineMissed || (maxDepth == 0) || (mcts && !stepped.active))
+        retainedChildren.Clear();
+    else
+        std::swap(retainedChildren, bestChildren);
+    stats.wallTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - searchStarted).count();
+    stats.searchId = ++searchCount;
+    publishedStats.Store(stats);
+    PublishBest(stats.bestEval, true);
+    if (logger != nullptr)
+        LogDecision(publishedBest.Load());
+    if (statsLog.is_open())
+        WriteStatsLog(stats);
+}
+
+/*Returns true if the book holds field's position, and may stand in for a search at maxDepth with the current settings*/
+bool PentrisAI::InBook(const PentrisField& field, unsigned char maxDepth) const
+{
+    Placement placement;
+    int eval;
+    return book && !evaluator && !mcts && (maxDepth == book->Depth()) && book->Probe(field, placement, eval);
+}
+
+/*Takes the move for field from the book, if it is in there (see InBook). The book only holds the placement; its move
+  sequence is found among the enumerated placements (the first one leading there, as in the search)*/
+bool PentrisAI::PlayFromBook(const PentrisField& field, unsigned char maxDepth)
+{
+    Placement placement;
+    int eval;
+    if (!book || evaluator || mcts || (maxDepth != book->Depth()) || !book->Probe(field, placement, eval))
+        return false;
+    EnumerateQuietly(field, bookCandidates);
+    for (size_t i = 0; i < bookCandidates.placements.size(); i++)
+    {
+        const Placement& candidate = bookCandidates.placements[i];
+        //Orientations are compared by shape: the enumeration may reach a symmetric pentomino's shape under another index
+        if ((candidate.posX == placement.posX) && (candidate.posY == placement.posY) &&
+            (field.OrientPentomino(candidate.pentominoId, candidate.orientation) == field.OrientPentomino(placement.pentominoId, placement.orientation)))
+        {
+            bestMoveSequence.assign(bookCandidates.moves.begin() + bookCandidates.moveStart[i], bookCandidates.moves.begin() + bookCandidates.moveStart[i + 1]);
+            bestPlacement = placement;
+            stats.bestEval = eval;
+            stats.bookHit = true;
+            stats.timeToFirstMoveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - searchStarted).count();
+            return true;
+        }
+    }
+    return false;
+}
+
+/*Sets up a cooperative search on field; the search itself runs in the calls of StepSearch*/
+void PentrisAI::BeginSearch(const PentrisField& field, unsigned char maxDepth)
+{
+    //A book hit is answered right away
+    if (InBook(field, maxDepth))
+    {
+        Search(field, maxDepth);
+        return;
+    }
+    stats = SearchStats();
+    evaluateKernel = SelectEvaluateKernel(field);
+    searchStarted = std::chrono::steady_clock::now();
+    bestMoveSequence.clear();
+    bestPlacement = Placement();
+    PublishBest(0, false);
+    bestChildren.Clear();
+    stepped.field = field;
+    stepped.maxDepth = maxDepth;
+    stepped.rootsEnumerated = false;
+    stepped.root = 0;
+    stepped.rootOpen = false;
+    stepped.maxEval = std::numeric_limits<int>::min();
+    stepped.active = true;
+    calculating = true;
+}
+
+/*Continues the cooperative search for up to nodeBudget nodes and about timeBudgetUs microseconds (see BeginSearch).
+  Returns true once the search is complete (also if none was begun)*/
+bool PentrisAI::StepSearch(const int nodeBudget, const int timeBudgetUs)
+{
+    if (!stepped.active)
+        return true;
+    const auto sliceStarted = std::chrono::steady_clock::now();
+    //The clock is read every few leaves only
+    const int TIME_CHECK_INTERVAL = 16;
+    int nodes = 0;
+    int sinceTimeCheck = 0;
+    auto OutOfBudget = [&]()
+    {
+        if ((nodeBudget > 0) && (nodes >= nodeBudget))
+            return true;
+        if ((timeBudgetUs > 0) && (sinceTimeCheck >= TIME_CHECK_INTERVAL))
+        {
+            sinceTimeCheck = 0;
+            return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sliceStarted).count() >= timeBudgetUs;
+        }
+        return false;
+    };
+    if (!stepped.rootsEnumerated)
+    {
+        stats.rootReused = CanReuseRoot(stepped.field);
+        if (stats.rootReused)
+            stepped.roots = retainedChildren;
+        else
+            EnumerateQuietly(stepped.field, stepped.roots);
+        stats.nodesPerDepth[0] += (std::uint32_t)stepped.roots.placements.size();
+        nodes += (int)stepped.roots.placements.size();
+        stepped.rootsEnumerated = true;
+    }
+    while (!OutOfBudget())
+    {
+        if (!stepped.rootOpen)
+        {
+            if (stepped.root >= stepped.roots.placements.size())
             {
-                //j loops from top to bottom. If columnHeight was already set in a prior loop, then an overhang must exist
-                if (columnHeight > 0)
-                    eval -= 50;
-                    
-                blocksMissingRow[j]++;
+                FinishSteppedSearch();
+                return true;
             }
+            OpenSteppedRoot();
+            nodes += (int)stepped.children.placements.size();
+            sinceTimeCheck += TIME_CHECK_INTERVAL;
+            continue;
+        }
+        if ((stepped.maxDepth > 0) && (stepped.child < stepped.children.placements.size()))
+        {
+            //One leaf below the open root placement
+            const Placement& placement = stepped.children.placements[stepped.child];
+            std::vector<int>& pentomino = stepped.childPentominos[placement.orientation];
+            if (pentomino.empty())
+                pentomino = stepped.field.OrientPentomino(placement.pentominoId, placement.orientation);
+            stepped.field.InsertPentomino(pentomino, placement.posX, placement.posY);
+            stats.leavesEvaluated++;
+            const int eval = Evaluate(stepped.field);
+            stepped.children.evals.push_back(eval);
+            stepped.field.RemovePentomino(pentomino, placement.posX, placement.posY);
+            if (eval > stepped.rootEval)
+                stepped.rootEval = eval;
+            stepped.child++;
+            nodes++;
+            sinceTimeCheck++;
+            continue;
         }
-        blocksMissingCol[i - 1] = field.Height() - columnHeight - 1;
+        CloseSteppedRoot();
+        nodes++;
+        sinceTimeCheck++;
+    }
+    return false;
+}
+
+/*Writes the placements of the field's current pentomino into candidates like EnumeratePlacements, but keeps the statistics
+  and the best move of the search in progress*/
+void PentrisAI::EnumerateQuietly(const PentrisField& field, CandidateList& candidates)
+{
+    const SearchStats saved = stats;
+    std::vector<MoveData> moveSequence;
+    std::swap(moveSequence, bestMoveSequence);
+    const Placement placement = bestPlacement;
+    EnumeratePlacements(field, candidates);
+    const std::uint32_t duplicatesSkipped = stats.duplicatesSkipped;
+    stats = saved;
+    stats.duplicatesSkipped += duplicatesSkipped;
+    std::swap(moveSequence, bestMoveSequence);
+    bestPlacement = placement;
+}
 
-        if (columnHeight > maxHeight)
-            maxHeight = columnHeight;
+/*Inserts the next root placement of the cooperative search; at depth 0 it is evaluated right away, at depth 1 the next
+  pentomino's placements below it are enumerated (from its spawn position, like the recursion does)*/
+void PentrisAI::OpenSteppedRoot()
+{
+    const Placement& placement = stepped.roots.placements[stepped.root];
+    stepped.rootPentomino = stepped.field.OrientPentomino(placement.pentominoId, placement.orientation);
+    stepped.field.InsertPentomino(stepped.rootPentomino, placement.posX, placement.posY);
+    stepped.rootOpen = true;
+    stepped.child = 0;
+    stepped.children.Clear();
+    if (stepped.maxDepth == 0)
+    {
+        stats.leavesEvaluated++;
+        stepped.rootEval = Evaluate(stepped.field);
+        return;
+    }
+    stepped.rootEval = std::numeric_limits<int>::min();
+    PentrisField& field = stepped.field;
+    //As in the recursion, the children are placed on the field without the rows the root placement completes
+    field.ClearRows(placement.posY, placement.posY + field.PENTOMINO_WIDTH - 1, stepped.clearUndo);
+    const int spawnX = field.Width() / 2 - field.PENTOMINO_WIDTH / 2;
+    if (!field.DoesPentominoFit(field.nextPentomino, spawnX, 0))
+    {
+        stepped.rootEval = std::numeric_limits<int>::min() + 1;
+        return;
+    }
+    //Enumerate with the next pentomino in the place of the current one
+    const std::vector<int> current = field.currentPentomino;
+    const int posX = field.pentominoX;
+    const int posY = field.pentominoY;
+    field.currentPentomino = field.nextPentomino;
+    field.pentominoX = spawnX;
+    field.pentominoY = 0;
+    EnumerateQuietly(field, stepped.children);
+    field.currentPentomino = current;
+    field.pentominoX = posX;
+    field.pentominoY = posY;
+    stats.nodesPerDepth[1] += (std::uint32_t)stepped.children.placements.size();
+    for (std::vector<int>& pentomino : stepped.childPentominos)
+        pentomino.clear();
+}
 
-        //Add up the height difference between subsequent columns for later averaging
-        if (i > 1)
-            avg += abs(blocksMissingCol[i - 1] - blocksMissingCol[i - 2]);
+/*Takes the open root placement's valuation (the best of its children at depth 1), keeps it if it beats the best so far,
+  and removes it (and at depth 1 puts back the rows it completed)*/
+void PentrisAI::CloseSteppedRoot()
+{
+    const size_t i = stepped.root;
+    if (stepped.rootEval > stepped.maxEval)
+    {
+        if (bestMoveSequence.empty())
+            stats.timeToFirstMoveMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - searchStarted).count();
+        bestMoveSequence.assign(stepped.roots.moves.begin() + stepped.roots.moveStart[i], stepped.roots.moves.begin() + stepped.roots.moveStart[i + 1]);
+        bestPlacement = stepped.roots.placements[i];
+        bestPlacement.orientation = stepped.field.PentominoOrientation(stepped.rootPentomino);
+        PublishBest(stepped.rootEval, false);
+        if (stepped.maxDepth > 0)
+        {
+            std::swap(bestChildren, stepped.children);
+            bestChildren.fieldHash = stepped.field.Hash();
+            bestChildren.pentominoId = stepped.field.PentominoId(stepped.field.nextPentomino);
+        }
+        stepped.maxEval = stepped.rootEval;
     }
-    //Punish extreme height differences between columns
-    avg = (int)(avg * 20 / (field.Width() - 2));
-    eval -= avg;
+    if (stepped.maxDepth > 0)
+        stepped.field.UndoClearRows(stepped.clearUndo);
+    const Placement& placement = stepped.roots.placements[i];
+    stepped.field.RemovePentomino(stepped.rootPentomino, placement.posX, placement.posY);
+    stepped.rootOpen = false;
+    stepped.root++;
+}
+
+/*Ends the cooperative search (complete, or cut short by an interrupt) and publishes its result like Search does*/
+void PentrisAI::FinishSteppedSearch()
+{
+    stats.bestEval = stepped.maxEval;
+    if (stats.interrupted)
+        stats.bestEval = std::max(stats.bestEval, std::numeric_limits<int>::min() + 1);
+    FinishSearch(stepped.maxDepth);
+    stepped.active = false;
+    calculating = false;
+}
 
-    //Reward filled rows
-    for (auto &missingRow : blocksMissingRow)
-        if (missingRow == 0)
-            eval += 30;
+void PentrisAI::LogDecision(const BestMove& best)
+{
+    logger->Log(LogEventType::AI_DECISION, { (std::int64_t)best.searchId, best.eval, best.placement.pentominoId, best.placement.orientation,
+        best.placement.posX, best.placement.posY }, MoveSequenceText(bestMoveSequence).c_str());
+}
 
-    //Punish by height
-    eval -= maxHeight;
+std::string PentrisAI::MoveSequenceText(const std::vector<MoveData>& moveSequence)
+{
+    std::string text;
+    for (const MoveData& move : moveSequence)
+    {
+        if (!text.empty())
+            text += ' ';
+        if (move.moveType == MoveType::REFLECT) text += "V";
+        else if (move.moveType == MoveType::ROTATE) text += "C" + std::to_string(move.destination);
+        else if (move.moveType == MoveType::LEFT) text += "L" + std::to_string(move.destination);
+        else if (move.moveType == MoveType::RIGHT) text += "R" + std::to_string(move.destination);
+        else if (move.moveType == MoveType::DOWN) text += "D" + std::to_string(move.destination);
+        else if (move.moveType == MoveType::HARD_DROP) text += "S";
+    }
+    return text;
+}
 
-    //Punish a field height at which the game would be lost
-    if (field.Height() - maxHeight <= field.PENTOMINO_WIDTH + 1)
-        eval -= 2000;
+/*Runs the Monte Carlo tree search in place of the exhaustive search and takes over its result*/
+int PentrisAI::SearchMCTS(const PentrisField& field)
+{
+    mcts->evaluator = evaluator;
+    mcts->interrupt = &interrupt;
+    int eval = mcts->Search(field, (std::uint32_t)searchCount + 1);
+    bestMoveSequence = mcts->bestMoveSequence;
+    bestPlacement = mcts->bestPlacement;
+    //Tree nodes stand in for the nodes at depth 0, rollouts for the leaves
+    stats.nodesPerDepth[0] = (std::uint32_t)mcts->stats.nodes;
+    stats.leavesEvaluated = (std::uint32_t)mcts->stats.iterations;
+    stats.interrupted = interrupt;
+    if (!bestMoveSequence.empty())
+        stats.timeToFirstMoveMs = mcts->stats.wallTimeMs;
     return eval;
 }
 
+/*Switches the AI to Monte Carlo tree search with the given time budget per move and number of trees (0 = one per core)*/
+void PentrisAI::EnableMCTS(const int budgetMs, const unsigned threads)
+{
+    CancelSpeculation();
+    if (!mcts)
+        mcts.reset(new PentrisMCTS());
+    mcts->budgetMs = budgetMs;
+    mcts->threads = threads;
+}
+
+/*Switches the AI back to the exhaustive search*/
+void PentrisAI::DisableMCTS()
+{
+    mcts.reset();
+}
+
+/*Publishes bestPlacement as the best move of the running search (searchCount is only incremented once it is over)*/
+void PentrisAI::PublishBest(const int eval, const bool complete)
+{
+    BestMove best;
+    best.searchId = complete ? searchCount : searchCount + 1;
+    best.placement = bestPlacement;
+    best.eval = eval;
+    best.found = !bestMoveSequence.empty();
+    best.complete = complete;
+    publishedBest.Store(best);
+}
+
+BestMove PentrisAI::CurrentBest() const
+{
+    //While a speculative search is being taken over, it is the one producing the result
+    if (adoptingSpeculation)
+        return speculation->CurrentBest();
+    return publishedBest.Load();
+}
+
+/*Body of the AI thread*/
+void PentrisAI::RunSearch(PentrisField field, unsigned char maxDepth)
+{
+    Search(field, maxDepth);
+    calculating = false;
+}
+
+void PentrisAI::WriteStatsLog(const SearchStats& record)
+{
+    double nodes = 0;
+    statsLog << "{\"search\":" << record.searchId << ",\"nodes_per_depth\":[";
+    for (int depth = 0; depth < SearchStats::MAX_DEPTH; depth++)
+    {
+        statsLog << (depth > 0 ? "," : "") << record.nodesPerDepth[depth];
+        nodes += record.nodesPerDepth[depth];
+    }
+    statsLog << "],\"leaves\":" << record.leavesEvaluated
+        << ",\"duplicates_skipped\":" << record.duplicatesSkipped
+        << ",\"wall_ms\":" << record.wallTimeMs
+        << ",\"first_move_ms\":" << record.timeToFirstMoveMs
+        << ",\"nodes_per_sec\":" << ((record.wallTimeMs > 0) ? nodes * 1000.0 / record.wallTimeMs : 0.0)
+        << ",\"interrupted\":" << (record.interrupted ? "true" : "false")
+        << ",\"root_reused\":" << (record.rootReused ? "true" : "false")
+        << ",\"book_hit\":" << (record.bookHit ? "true" : "false")
+        << ",\"subtrees_pruned\":" << record.subtreesPruned
+        << ",\"deadline_missed\":" << (record.deadlineMissed ? "true" : "false")
+        << ",\"best_eval\":" << record.bestEval << "}\n";
+}
+
+bool PentrisAI::OpenStatsLog(const std::string& path)
+{
+    while (!AIThreadJoined());
+    statsLog.close();
+    statsLog.open(path, std::ios::out | std::ios::app);
+    return statsLog.is_open();
+}
+
+void PentrisAI::CloseStatsLog()
+{
+    while (!AIThreadJoined());
+    statsLog.close();
+}
+
+/*Starts the search on its own thread. If a speculative search was started on exactly this field, its result is taken over
+  instead (immediately if it has already finished, otherwise once it does)*/
 void PentrisAI::CalculateMoveSequence(const PentrisField field, unsigned char maxDepth)
 {
-    evalCalls = 0;
-    PentrisField c_field = field;
     interrupt = false;
+    if (cooperative)
+    {
+        CancelSpeculation();
+        BeginSearch(field, maxDepth);
+        return;
+    }
+    if (speculationValid && (speculatedDepth == maxDepth) && speculatedField.SamePosition(field))
+    {
+        speculationValid = false;
+        calculating = true;
+        adoptingSpeculation = true;
+        if (speculation->AIThreadJoined())
+            AdoptSpeculation();
+        return;
+    }
+    CancelSpeculation();
+    //A book hit is answered right away, without a thread
+    if (InBook(field, maxDepth))
+    {
+        Search(field, maxDepth);
+        return;
+    }
+    //Retract the previous result right away, before the thread has started
+    bestMoveSequence.clear();
+    bestPlacement = Placement();
+    PublishBest(0, false);
+    PentrisField c_field = field;
     calculating = true;
     threadSpawned = true;
-    aiThread = std::thread(&PentrisAI::CalculateMoveSequence_Recursive, this, c_field, 0, maxDepth);
+    aiThread = std::thread(&PentrisAI::RunSearch, this, c_field, maxDepth);
 }
 
 bool PentrisAI::AIThreadJoined()
 {
+    //A cooperative search has no thread to wait for: it runs in StepSearch, and an interrupt ends it on the spot
+    if (stepped.active)
+    {
+        if (!interrupt)
+            return false;
+        stats.interrupted = true;
+        FinishSteppedSearch();
+    }
+    if (adoptingSpeculation)
+    {
+        speculation->interrupt = interrupt.load();
+        if (!speculation->AIThreadJoined())
+            return false;
+        AdoptSpeculation();
+    }
     if (!calculating) 
     {
         if (threadSpawned)
@@ -259,3 +1157,98 @@ bool PentrisAI::AIThreadJoined()
     else
         return false;
 }
+
+/*Takes over the (finished) speculative search's result as if this AI had calculated it*/
+void PentrisAI::AdoptSpeculation()
+{
+    bestMoveSequence = speculation->bestMoveSequence;
+    bestPlacement = speculation->bestPlacement;
+    std::swap(retainedChildren, speculation->retainedChildren);
+    publishedStats.Store(speculation->LastStats());
+    publishedBest.Store(speculation->CurrentBest());
+    if (logger != nullptr)
+        LogDecision(speculation->CurrentBest());
+    adoptingSpeculation = false;
+    calculating = false;
+}
+
+/*Starts searching the next pentomino's move in the background while the current one is still being executed.
+  The field after the current pentomino is placed at placement is fully known (the piece stream is part of the field),
+  so if the game reaches exactly that field, CalculateMoveSequence returns the speculative result without searching*/
+void PentrisAI::Speculate(const PentrisField& field, const Placement& placement, unsigned char maxDepth)
+{
+    CancelSpeculation();
+    //A Monte Carlo search already occupies every core, and a cooperative AI has no threads
+    if (mcts || cooperative)
+        return;
+    if (!speculation)
+        speculation.reset(new PentrisAI());
+    speculation->evaluator = evaluator;
+    speculation->book = book;
+    speculation->deadlineUs = deadlineUs;
+    //Predict the field the same way the game produces it: drop, insert (which draws the next pentomino) and mark filled rows.
+    //Filled rows are searched as cleared (see PentrisGame::StartAICalculation)
+    speculatedField = field;
+    speculatedField.currentPentomino = speculatedField.OrientPentomino(placement.pentominoId, placement.orientation);
+    if (!speculatedField.DoesPentominoFit(speculatedField.currentPentomino, placement.posX, placement.posY))
+        return;
+    speculatedField.pentominoX = placement.posX;
+    speculatedField.pentominoY = speculatedField.GetTerminalY(speculatedField.currentPentomino, placement.posX, placement.posY);
+    const int landingY = speculatedField.pentominoY;
+    speculatedField.InsertCurrentPentomino();
+    if (speculatedField.MarkFilledRows(landingY, landingY + speculatedField.PENTOMINO_WIDTH - 1) > 0)
+        speculatedField.ClearFilledRows();
+    speculatedDepth = maxDepth;
+    speculationValid = true;
+    speculation->retainedChildren = retainedChildren;
+    speculation->CalculateMoveSequence(speculatedField, maxDepth);
+}
+
+/*Stops a running speculative search (unless its result has already been taken over)*/
+void PentrisAI::CancelSpeculation()
+{
+    speculationValid = false;
+    if (!speculation || adoptingSpeculation)
+        return;
+    while (!speculation->AIThreadJoined())
+        speculation->interrupt = true;
+}
+
+PentrisAI::PentrisAI()
+{
+}
+
+PentrisAI::~PentrisAI()
+{
+    while (!AIThreadJoined())
+        interrupt = true;
+    CancelSpeculation();
+}
+
+void DecisionLatencies::Clear()
+{
+    latenciesUs.clear();
+    sortedUs.clear();
+    deadlineMisses = 0;
+}
+
+void DecisionLatencies::Record(const SearchStats& searchStats)
+{
+    latenciesUs.push_back(searchStats.wallTimeMs * 1000.0);
+    if (searchStats.deadlineMissed)
+        deadlineMisses++;
+}
+
+/*Nearest rank percentile of the latencies recorded so far*/
+double DecisionLatencies::Percentile(const double fraction) const
+{
+    if (latenciesUs.empty())
+        return 0.0;
+    if (sortedUs.size() != latenciesUs.size())
+    {
+        sortedUs = latenciesUs;
+        std::sort(sortedUs.begin(), sortedUs.end());
+    }
+    const size_t rank = (size_t)std::ceil(std::min(1.0, std::max(0.0, fraction)) * sortedUs.size());
+    return sortedUs[(rank > 0) ? rank - 1 : 0];
+}
@@ -1,8 +1,19 @@
 #pragma once
 
 #include "PentrisField.h"
+#include "PentrisSeqLock.h"
+#include "PentrisEvaluator.h"
+#include "PentrisLogger.h"
+#include "PentrisBook.h"
 #include <vector>
 #include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <cstdint>
+#include <memory>
+#include <algorithm>
 
 enum class MoveType { HARD_DROP, LEFT, RIGHT, DOWN, ROTATE, REFLECT };
 
@@ -17,20 +28,257 @@ struct MoveData {
     MoveData() {};
 };
 
+/*Telemetry of a single completed search, published by the AI thread once the search ends*/
+struct SearchStats {
+    static const int MAX_DEPTH = 4;
+    //Consecutive number of the search (starting at 1; 0 means no search has completed yet)
+    std::uint64_t searchId = 0;
+    //Number of terminal placements generated at each depth
+    std::uint32_t nodesPerDepth[MAX_DEPTH] = {};
+    //Number of calls to EvaluateField
+    std::uint32_t leavesEvaluated = 0;
+    //Number of orientations skipped because of pentomino symmetries
+    std::uint32_t duplicatesSkipped = 0;
+    double wallTimeMs = 0.0;
+    //Time until the first complete move sequence was found at depth 0
+    double timeToFirstMoveMs = 0.0;
+    //True if interrupt cut the search short
+    bool interrupted = false;
+    //Valuation of the chosen move
+    int bestEval = 0;
+    //True if the root placements were taken over from the previous search instead of being enumerated
+    bool rootReused = false;
+    //True if the move was taken from the opening book instead of being searched
+    bool bookHit = false;
+    //Root placements whose subtree was skipped because its bound could not beat the best move so far (see SetPruning)
+    std::uint32_t subtreesPruned = 0;
+    //True if the search ran out of its deadline and the best depth 0 move was played instead (see PentrisAI::SetDeadline)
+    bool deadlineMissed = false;
+};
+
+/*The decision latencies of a game: the wall time of every search whose move was played, and how many of them missed
+  their deadline (see PentrisAI::SetDeadline)*/
+class DecisionLatencies
+{
+private:
+    std::vector<double> latenciesUs;
+    int deadlineMisses = 0;
+    //latenciesUs in ascending order, brought up to date by the first Percentile after a Record
+    mutable std::vector<double> sortedUs;
+public:
+    void Clear();
+    void Record(const SearchStats& searchStats);
+    int Decisions() const { return (int)latenciesUs.size(); };
+    int DeadlineMisses() const { return deadlineMisses; };
+    //The latency in microseconds that the given fraction of the decisions stayed within (0.5 for the median, 1 for the
+    //slowest); 0 before the first decision
+    double Percentile(const double fraction) const;
+};
+
+/*The best placement found so far by a search, published while the search is still running (see PentrisAI::CurrentBest)*/
+struct BestMove {
+    //The search the placement belongs to (SearchStats::searchId once that search has completed)
+    std::uint64_t searchId = 0;
+    Placement placement;
+    int eval = 0;
+    //False until the search has found its first placement
+    bool found = false;
+    //True once the search is over (finished or interrupted)
+    bool complete = false;
+};
+
+/*The terminal placements of one pentomino on one field (identified by PentrisField::Hash) with their move sequences,
+  in the order in which the search enumerates them*/
+struct CandidateList {
+    std::uint64_t fieldHash = 0;
+    int pentominoId = 0;
+    std::vector<Placement> placements;
+    //The move sequence of placements[i] is moves[moveStart[i]] up to (excluding) moves[moveStart[i + 1]]
+    std::vector<int> moveStart{ 0 };
+    std::vector<MoveData> moves;
+    //The valuation of each placement by the search that recorded the list (empty if the placements were only enumerated)
+    std::vector<int> evals;
+
+    void Clear() { placements.clear(); moveStart.resize(1); moves.clear(); evals.clear(); };
+    void Add(const Placement& placement, const std::vector<MoveData>& moveSequence)
+    {
+        placements.push_back(placement);
+        moves.insert(moves.end(), moveSequence.begin(), moveSequence.end());
+        moveStart.push_back((int)moves.size());
+    };
+};
+
+class PentrisMCTS;
+
 class PentrisAI
 {
+public:
+    /*Working memory of the evaluation kernels that do not know the field size at compile time. Sized on the first leaf of
+      a field size and reused for every leaf after that*/
+    struct EvaluateScratch {
+        std::vector<int> rows;
+        std::vector<int> columns;
+        std::vector<int> differences;
+        std::vector<std::uint64_t> words;
+    };
+    typedef int (*EvaluateKernel)(const PentrisField& field, EvaluateScratch& scratch);
 private:
-    bool calculating = false;
+    std::atomic<bool> calculating{ false };
     bool threadSpawned = false;
-    int CalculateMoveSequence_Recursive(PentrisField field, unsigned char depth = 0, unsigned char maxDepth = 1);
+    //Statistics of the search currently running; only touched by the AI thread
+    SearchStats stats;
+    std::chrono::steady_clock::time_point searchStarted;
+    std::uint64_t searchCount = 0;
+    PentrisSeqLock<SearchStats> publishedStats;
+    PentrisSeqLock<BestMove> publishedBest;
+    void PublishBest(const int eval, const bool complete);
+    std::ofstream statsLog;
+    //The EvaluateField kernel for the field size being searched (selected once per search)
+    EvaluateKernel evaluateKernel = nullptr;
+    static EvaluateKernel SelectEvaluateKernel(const PentrisField& field);
+    //If set, replaces the built-in heuristic at the leaves of the search
+    std::shared_ptr<const PentrisEvaluator> evaluator;
+    //The kernels' working memory for the search, and for EvaluateField (which may be called while a search is running)
+    mutable EvaluateScratch searchScratch;
+    EvaluateScratch fieldScratch;
+    int Evaluate(const PentrisField& field) const { return evaluator ? evaluator->Evaluate(field) : evaluateKernel(field, searchScratch); };
+    void RunSearch(PentrisField field, unsigned char maxDepth);
+    //If set, the answers for the positions it holds are looked up instead of searched (see SetBook)
+    std::shared_ptr<const PentrisBook> book;
+    CandidateList bookCandidates;
+    bool InBook(const PentrisField& field, unsigned char maxDepth) const;
+    bool PlayFromBook(const PentrisField& field, unsigned char maxDepth);
+    //Receives an AI_DECISION event per completed (or adopted) search, if set
+    PentrisLogger* logger = nullptr;
+    void LogDecision(const BestMove& best);
+    void WriteStatsLog(const SearchStats& record);
+    //Speculative search for the next pentomino on the field predicted after the current placement (see Speculate)
+    std::unique_ptr<PentrisAI> speculation;
+    PentrisField speculatedField;
+    unsigned char speculatedDepth = 0;
+    bool speculationValid = false;
+    //True while CalculateMoveSequence has taken over a speculative search that is still running
+    std::atomic<bool> adoptingSpeculation{ false };
+    void AdoptSpeculation();
+    //The placements of the next pentomino below the chosen move, with their valuations, kept after a depth 1 search. If the
+    //following search starts on exactly that field, they become its root placements, and only the newly revealed pentomino is
+    //enumerated from scratch; the branch and bound search also orders them by their valuations instead of evaluating them again
+    CandidateList retainedChildren;
+    //The next pentomino's placements below the root placement being searched, and below the best root placement so far
+    CandidateList branchChildren;
+    CandidateList bestChildren;
+    //The field the children in branchChildren were enumerated on (after the root placement's rows were cleared)
+    std::uint64_t branchFieldHash = 0;
+    //The rows cleared between plies, per depth, to be put back once the ply below has been searched
+    RowClearUndo clearUndo[SearchStats::MAX_DEPTH];
+    //The depth whose placements are recorded into branchChildren (0 while enumerating placements)
+    unsigned char recordDepth = 1;
+    bool CanReuseRoot(const PentrisField& field) const;
+    int SearchRetainedRoot(PentrisField& field, unsigned char maxDepth);
+    //Branch and bound for the two-ply search with the built-in heuristic (see SetPruning)
+    bool pruning = true;
+    CandidateList rootCandidates;
+    std::vector<int> rootScores;
+    std::vector<int> rootBounds;
+    std::vector<size_t> rootOrder;
+    int SearchBranchAndBound(PentrisField& field, unsigned char maxDepth);
+    //Decision deadline (see SetDeadline); armed only while the search beyond the fallback move runs
+    int deadlineUs = 0;
+    bool deadlineArmed = false;
+    std::chrono::steady_clock::time_point deadline;
+    bool OutOfTime() const { return interrupt || (deadlineArmed && (std::chrono::steady_clock::now() >= deadline)); };
+    //Replaces the exhaustive search while Monte Carlo tree search is enabled
+    std::unique_ptr<PentrisMCTS> mcts;
+    int SearchMCTS(const PentrisField& field);
+    int CalculateMoveSequence_Recursive(PentrisField& field, unsigned char depth = 0, unsigned char maxDepth = 1);
+    //Publishes the result and the statistics of a search that has ended (shared by Search and the cooperative search)
+    void FinishSearch(unsigned char maxDepth);
+    /*The cooperative search (see BeginSearch): the same search as CalculateMoveSequence_Recursive, unrolled into a state
+      that survives between calls of StepSearch. The root placements are visited in enumeration order; at depth 1 each one is
+      inserted, the next pentomino's placements below it are enumerated, and they are evaluated one leaf per node*/
+    struct SteppedSearch {
+        bool active = false;
+        PentrisField field;
+        unsigned char maxDepth = 1;
+        bool rootsEnumerated = false;
+        CandidateList roots;
+        size_t root = 0;
+        //True while the current root placement is inserted into field (and, at depth 1, children holds its children)
+        bool rootOpen = false;
+        std::vector<int> rootPentomino;
+        int rootEval = 0;
+        CandidateList children;
+        size_t child = 0;
+        //The next pentomino in each of its 8 orientations (filled as needed while the children are evaluated)
+        std::vector<int> childPentominos[8];
+        //The rows the open root placement completed (removed while its children are searched)
+        RowClearUndo clearUndo;
+        int maxEval = 0;
+    };
+    SteppedSearch stepped;
+    bool cooperative = false;
+    void EnumerateQuietly(const PentrisField& field, CandidateList& candidates);
+    void OpenSteppedRoot();
+    void CloseSteppedRoot();
+    void FinishSteppedSearch();
 public:
-    int evalCalls;
-
-    bool interrupt = false;
+    std::atomic<bool> interrupt{ false };
     std::thread aiThread;
     std::vector<MoveData> bestMoveSequence;
-    int EvaluateField(const PentrisField field);
+    //The terminal position reached by bestMoveSequence
+    Placement bestPlacement;
+    int EvaluateField(const PentrisField& field);
+    //Plugs in an evaluator for the leaves of the search (nullptr restores the built-in heuristic); not while a search is running
+    void SetEvaluator(const std::shared_ptr<const PentrisEvaluator>& newEvaluator) { evaluator = newEvaluator; };
+    //Plugs in an opening book (nullptr removes it). It is consulted only while the built-in heuristic and the exhaustive search
+    //are used, by searches of the depth it was built for; a book hit takes a lookup instead of a search, and needs no thread
+    void SetBook(const std::shared_ptr<const PentrisBook>& newBook) { book = newBook; };
+    //Branch and bound (on by default): the two-ply search with the built-in heuristic visits the root placements best first
+    //and skips those whose subtree cannot beat the best move so far. The result is the same as without it
+    void SetPruning(const bool enabled) { pruning = enabled; };
+    //Gives every search microseconds to commit to a move (0, the default, for no deadline). The best depth 0 move is found
+    //first; if the deeper search has not finished by the deadline, it is cut short and that move is played instead
+    //(SearchStats::deadlineMissed). The clock is checked before each root placement's subtree, so a search overruns the
+    //deadline by at most one subtree. Not for Monte Carlo tree search (which has its own budget) nor the cooperative search.
+    //Not while a search is running
+    void SetDeadline(const int microseconds) { deadlineUs = std::max(0, microseconds); };
+    int Deadline() const { return deadlineUs; };
+    int Search(const PentrisField& field, unsigned char maxDepth = 1);
+    void EnumeratePlacements(const PentrisField& field, CandidateList& candidates);
     void CalculateMoveSequence(const PentrisField field, unsigned char maxDepth = 1);
+    //True unless a search is running (a cooperative search that has been interrupted ends right here)
     bool AIThreadJoined();
-};
+    //Cooperative search: runs on the caller's thread, a slice at a time, instead of on a thread of its own. BeginSearch sets
+    //it up (without searching), and every StepSearch continues it for up to nodeBudget nodes (enumerated or evaluated
+    //placements; 0 for no limit) and, if timeBudgetUs > 0, for about that many microseconds. StepSearch returns true once
+    //the search is complete; the result (bestMoveSequence, bestPlacement, LastStats) is then the same as Search's.
+    //Always the exhaustive search, also while Monte Carlo tree search is enabled
+    void BeginSearch(const PentrisField& field, unsigned char maxDepth = 1);
+    bool StepSearch(const int nodeBudget, const int timeBudgetUs = 0);
+    //While cooperative, CalculateMoveSequence begins a cooperative search instead of starting a thread, and nothing is
+    //searched speculatively; the caller has to keep calling StepSearch. Not while a search is running
+    void SetCooperative(const bool enabled) { cooperative = enabled; };
+    bool Cooperative() const { return cooperative; };
+    void Speculate(const PentrisField& field, const Placement& placement, unsigned char maxDepth = 1);
+    void CancelSpeculation();
+    //Monte Carlo tree search mode (see PentrisMCTS); not while a search is running
+    void EnableMCTS(const int budgetMs, const unsigned threads = 0);
+    void DisableMCTS();
+    bool MCTSEnabled() const { return (bool)mcts; };
+    PentrisAI();
+    ~PentrisAI();
 
+    //Returns the best placement of the running search found so far (or the result of the last search once it is complete).
+    //Lock-free and never waits for the search, so the game can act on it before the search has finished
+    BestMove CurrentBest() const;
+    //Returns the statistics of the most recently completed search. Lock-free; safe to call from any thread
+    SearchStats LastStats() const { return publishedStats.Load(); };
+    //Logs every decision into logger (which has to outlive the AI); nullptr stops logging
+    void SetLogger(PentrisLogger* newLogger) { logger = newLogger; };
+    //The move sequence in compact form, one token per move named after the player's keys: V (reflect), C<n> (rotate n times),
+    //L<x> / R<x> (move left / right to x), D<y> (move down to y) and S (hard drop)
+    static std::string MoveSequenceText(const std::vector<MoveData>& moveSequence);
+    //Streams every completed search's statistics as one JSON object per line into the file at path
+    bool OpenStatsLog(const std::string& path);
+    void CloseStatsLog();
+};
@@ -0,0 +1,95 @@
+#include "PentrisAdvisor.h"
+#include <chrono>
+
+/*Identifies a position by its blocks and its pentominos, but not by where the current pentomino is*/
+std::uint64_t PentrisAdvisor::PositionKey(const PentrisField& field)
+{
+    return (field.Hash() ^ (std::uint64_t)(field.PentominoId(field.currentPentomino) | (field.PentominoId(field.nextPentomino) << 4)))
+        * 0x9E3779B97F4A7C15ull;
+}
+
+/*True if the recommendation is among the placements of field's pentomino the search enumerates from where it is.
+  Orientations are compared by shape, since a symmetric pentomino's shape may be reached under another index*/
+bool PentrisAdvisor::Reachable(const PentrisField& field)
+{
+    ai.EnumeratePlacements(field, reachable);
+    const std::vector<int> shape = field.OrientPentomino(advice.pentominoId, advice.orientation);
+    for (const Placement& placement : reachable.placements)
+        if ((placement.posX == advice.posX) && (placement.posY == advice.posY) && (placement.pentominoId == advice.pentominoId) &&
+            (field.OrientPentomino(placement.pentominoId, placement.orientation) == shape))
+            return true;
+    return false;
+}
+
+void PentrisAdvisor::CancelSearch()
+{
+    if (!searching)
+        return;
+    ai.interrupt = true;
+    ai.AIThreadJoined();
+    ai.interrupt = false;
+    searching = false;
+}
+
+void PentrisAdvisor::Reset()
+{
+    CancelSearch();
+    adviceValid = false;
+    adviceKey = 0;
+}
+
+void PentrisAdvisor::SetEvaluator(const std::shared_ptr<const PentrisEvaluator>& evaluator)
+{
+    //The recommendation was valued by the previous evaluator
+    Reset();
+    ai.SetEvaluator(evaluator);
+}
+
+/*Keeps the recommendation while it is reachable, takes over the result of a search once it completes, and otherwise
+  begins a search on field's position or continues the running one for a slice*/
+void PentrisAdvisor::Update(const PentrisField& field)
+{
+    const auto started = std::chrono::steady_clock::now();
+    const std::uint64_t key = PositionKey(field);
+    const int orientation = field.PentominoOrientation(field.currentPentomino);
+    if (adviceValid && (adviceKey != key))
+        adviceValid = false;
+    //The pentomino has moved since the recommendation was last checked: it stands if it can still be reached
+    if (adviceValid && ((field.pentominoX != checkedX) || (field.pentominoY != checkedY) || (orientation != checkedOrientation)))
+    {
+        adviceValid = Reachable(field);
+        if (adviceValid)
+            reuses++;
+    }
+    if (!adviceValid)
+    {
+        if (searching && (searchKey != key))
+            CancelSearch();
+        if (!searching)
+        {
+            ai.BeginSearch(field, searchDepth);
+            searchKey = key;
+            searchX = field.pentominoX;
+            searchY = field.pentominoY;
+            searchOrientation = orientation;
+            searching = true;
+            searches++;
+        }
+        if (ai.StepSearch(0, sliceMicroseconds))
+        {
+            searching = false;
+            advice = ai.bestPlacement;
+            adviceKey = key;
+            //The search may have begun before the pentomino's latest moves
+            adviceValid = !ai.bestMoveSequence.empty() && (((searchX == field.pentominoX) && (searchY == field.pentominoY) &&
+                (searchOrientation == orientation)) || Reachable(field));
+        }
+    }
+    if (adviceValid)
+    {
+        checkedX = field.pentominoX;
+        checkedY = field.pentominoY;
+        checkedOrientation = orientation;
+    }
+    lastUpdateUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count();
+}
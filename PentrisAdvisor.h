@@ -0,0 +1,66 @@
+#pragma once
+
+#include "PentrisField.h"
+#include "PentrisAI.h"
+#include <memory>
+#include <cstdint>
+
+/*Recommends a placement for the pentomino a human is playing, without ever holding up the game: Update is called once
+  per frame and spends at most about sliceMicroseconds on a cooperative search (see PentrisAI::BeginSearch), so a new
+  recommendation appears a few frames after the position has changed.
+  The search is only repeated when it has to be. Moving, rotating or reflecting the pentomino (or gravity) keeps the
+  blocks and the pentominos of the position, and the placements that remain reachable are essentially a subset of those
+  the search chose from, so its recommendation stands for as long as it is still among the placements the search
+  enumerates from where the pentomino is now (an enumeration costs a small fraction of a search, and unlike a
+  PentrisPlanner search it is bounded by the number of placements). A search still running when the pentomino moves is
+  finished rather than restarted; only a change of blocks or pentominos (a placement, a clear, a new game) cancels it*/
+class PentrisAdvisor
+{
+private:
+    PentrisAI ai;
+    //The placements reachable from where the pentomino is (see Reachable)
+    CandidateList reachable;
+    //The position (blocks, current and next pentomino) of the recommendation and of the running search
+    std::uint64_t adviceKey = 0;
+    std::uint64_t searchKey = 0;
+    bool searching = false;
+    //Where the pentomino was when the running search began
+    int searchX = 0;
+    int searchY = 0;
+    int searchOrientation = -1;
+    Placement advice;
+    bool adviceValid = false;
+    //Where the pentomino was when the recommendation was last found reachable
+    int checkedX = 0;
+    int checkedY = 0;
+    int checkedOrientation = -1;
+    double lastUpdateUs = 0;
+    std::uint64_t searches = 0;
+    std::uint64_t reuses = 0;
+    static std::uint64_t PositionKey(const PentrisField& field);
+    bool Reachable(const PentrisField& field);
+    void CancelSearch();
+public:
+    //Search depth of the recommendations (see PentrisAI::Search)
+    unsigned char searchDepth = 1;
+    //Game thread time a single Update may spend searching
+    int sliceMicroseconds = 250;
+
+    PentrisAdvisor() {};
+    PentrisAdvisor(const PentrisAdvisor&) = delete;
+    PentrisAdvisor& operator=(const PentrisAdvisor&) = delete;
+    //Brings the recommendation up to date with field (to be called once per frame)
+    void Update(const PentrisField& field);
+    //Drops the recommendation and cancels the search
+    void Reset();
+    //True if there is a recommendation for the position last passed to Update, reachable from where its pentomino is
+    bool HasAdvice() const { return adviceValid; };
+    const Placement& Advice() const { return advice; };
+    //The evaluator and the opening book of the recommendations (see PentrisAI::SetEvaluator, PentrisAI::SetBook)
+    void SetEvaluator(const std::shared_ptr<const PentrisEvaluator>& evaluator);
+    void SetBook(const std::shared_ptr<const PentrisBook>& book) { ai.SetBook(book); };
+    //Wall time of the most recent Update, searches begun, and position changes answered without a search
+    double LastUpdateMicroseconds() const { return lastUpdateUs; };
+    std::uint64_t Searches() const { return searches; };
+    std::uint64_t Reuses() const { return reuses; };
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+/*A bump allocator for objects that are all discarded at once (e.g. the nodes of a search tree, once per move).
+  Allocate hands out value-initialised objects from chunks of CHUNK_SIZE; Reset makes the chunks available again
+  without returning their memory, so after the first few moves no more allocations take place*/
+template<typename T, std::size_t CHUNK_SIZE = 4096>
+class PentrisArena
+{
+private:
+    std::vector<std::unique_ptr<T[]>> chunks;
+    //The chunk currently handed out from, and how many of its objects are in use
+    std::size_t chunkIndex = 0;
+    std::size_t used = 0;
+    std::size_t allocated = 0;
+public:
+    T* Allocate()
+    {
+        if (chunks.empty() || (used == CHUNK_SIZE))
+        {
+            if (!chunks.empty())
+                chunkIndex++;
+            if (chunkIndex == chunks.size())
+                chunks.emplace_back(new T[CHUNK_SIZE]);
+            used = 0;
+        }
+        T* object = &chunks[chunkIndex][used++];
+        *object = T();
+        allocated++;
+        return object;
+    };
+    void Reset()
+    {
+        chunkIndex = 0;
+        used = 0;
+        allocated = 0;
+    };
+    //Number of objects handed out since the last Reset
+    std::size_t Allocated() const { return allocated; };
+};
@@ -0,0 +1,162 @@
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include "PentrisAI.h"
+#include "PentrisCorpus.h"
+#include "PentrisReplay.h"
+
+/*Offline position analysis.
+  Usage:
+    PentrisBatchTool analyze <corpus file> <result file> [threads] [depth]
+        Runs the AI's search on every record of the corpus, spread over all cores, and writes the best placement and eval per record.
+        Records with invalid pentominos are skipped and counted; their result is an empty placement (pentomino id 0) with eval 0
+    PentrisBatchTool extract <replay file> <corpus file>
+        Builds a corpus from every position (right before each placement) of every game in a replay file*/
+
+namespace
+{
+    //Records are handed out to the worker threads in chunks of this size
+    const std::uint64_t CHUNK_SIZE = 1024;
+
+    int Analyze(const std::string& corpusPath, const std::string& resultPath, unsigned threads, unsigned char depth)
+    {
+        PentrisCorpusReader corpus;
+        if (!corpus.Open(corpusPath))
+        {
+            std::cout << "Could not open corpus " << corpusPath << std::endl;
+            return 1;
+        }
+        std::ofstream results(resultPath, std::ios::binary | std::ios::out | std::ios::trunc);
+        if (!results.is_open())
+        {
+            std::cout << "Could not open result file " << resultPath << std::endl;
+            return 1;
+        }
+        std::uint8_t header[PentrisCorpusFormat::HEADER_SIZE] = {};
+        std::memcpy(header, PentrisCorpusFormat::RESULT_MAGIC, sizeof(PentrisCorpusFormat::RESULT_MAGIC));
+        header[4] = (std::uint8_t)PentrisCorpusFormat::VERSION;
+        header[6] = (std::uint8_t)PentrisCorpusFormat::RESULT_SIZE;
+        for (int i = 0; i < 8; i++)
+            header[8 + i] = (std::uint8_t)(corpus.Count() >> (8 * i));
+        results.write((const char*)header, sizeof(header));
+
+        std::atomic<std::uint64_t> nextChunk{ 0 };
+        std::atomic<std::uint64_t> leaves{ 0 };
+        std::atomic<std::uint64_t> invalid{ 0 };
+        std::mutex resultsMutex;
+        auto started = std::chrono::steady_clock::now();
+
+        auto Worker = [&]()
+        {
+            PentrisAI ai;
+            PentrisField field(corpus.Width(), corpus.Height());
+            std::vector<std::uint8_t> buffer(CHUNK_SIZE * PentrisCorpusFormat::RESULT_SIZE);
+            std::uint64_t workerLeaves = 0;
+            std::uint64_t workerInvalid = 0;
+            while (true)
+            {
+                std::uint64_t first = nextChunk.fetch_add(CHUNK_SIZE);
+                if (first >= corpus.Count())
+                    break;
+                std::uint64_t last = std::min(first + CHUNK_SIZE, corpus.Count());
+                for (std::uint64_t index = first; index < last; index++)
+                {
+                    if (!corpus.Load(index, field))
+                    {
+                        workerInvalid++;
+                        PentrisCorpusFormat::EncodeResult(&buffer[(index - first) * PentrisCorpusFormat::RESULT_SIZE], Placement(), 0);
+                        continue;
+                    }
+                    int eval = ai.Search(field, depth);
+                    workerLeaves += ai.LastStats().leavesEvaluated;
+                    PentrisCorpusFormat::EncodeResult(&buffer[(index - first) * PentrisCorpusFormat::RESULT_SIZE], ai.bestPlacement, eval);
+                }
+                //Chunks finish out of order, hence each one is written at its own offset
+                std::lock_guard<std::mutex> lock(resultsMutex);
+                results.seekp(PentrisCorpusFormat::HEADER_SIZE + first * PentrisCorpusFormat::RESULT_SIZE);
+                results.write((const char*)buffer.data(), (last - first) * PentrisCorpusFormat::RESULT_SIZE);
+            }
+            leaves += workerLeaves;
+            invalid += workerInvalid;
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < threads; i++)
+            workers.emplace_back(Worker);
+        for (auto& worker : workers)
+            worker.join();
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        std::cout << corpus.Count() << " positions on " << threads << " threads in " << seconds << " s ("
+            << ((seconds > 0) ? corpus.Count() / seconds : 0) << " positions/s, " << ((seconds > 0) ? leaves / seconds : 0) << " leaves/s)" << std::endl;
+        if (invalid > 0)
+            std::cout << invalid << " records skipped: invalid pentomino id or orientation" << std::endl;
+        return results ? 0 : 1;
+    }
+
+    int Extract(const std::string& replayPath, const std::string& corpusPath)
+    {
+        PentrisReplayer replayer;
+        if (!replayer.Open(replayPath))
+        {
+            std::cout << "Could not open replay file " << replayPath << std::endl;
+            return 1;
+        }
+        //The corpus takes the field size of the first game; games recorded on other field sizes are skipped
+        PentrisCorpusWriter corpus;
+        bool corpusOpen = false;
+        int corpusWidth = 0, corpusHeight = 0;
+        replayer.onPosition = [&](const PentrisField& field)
+        {
+            if (!corpusOpen)
+            {
+                corpusOpen = corpus.Open(corpusPath, field.Width(), field.Height());
+                corpusWidth = field.Width();
+                corpusHeight = field.Height();
+            }
+            if ((field.Width() == corpusWidth) && (field.Height() == corpusHeight))
+                corpus.Append(field);
+        };
+        PentrisField field;
+        ReplayResult result;
+        int games = 0, skippedGames = 0;
+        long long skippedPositions = 0;
+        while (replayer.NextGame(result, field))
+        {
+            games++;
+            if (corpusOpen && ((result.width != corpusWidth) || (result.height != corpusHeight)))
+            {
+                skippedGames++;
+                skippedPositions += result.pieces;
+            }
+        }
+        corpus.Close();
+        std::cout << games << " games, " << corpus.Count() << " positions written" << std::endl;
+        if (skippedGames > 0)
+            std::cout << skippedGames << " games (" << skippedPositions << " positions) skipped: recorded on another field size than "
+                << corpusWidth << "x" << corpusHeight << std::endl;
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if ((argc >= 4) && (std::strcmp(argv[1], "analyze") == 0))
+    {
+        unsigned threads = (argc >= 5) ? std::atoi(argv[4]) : std::thread::hardware_concurrency();
+        unsigned char depth = (argc >= 6) ? (unsigned char)std::atoi(argv[5]) : 1;
+        return Analyze(argv[2], argv[3], std::max(1u, threads), depth);
+    }
+    if ((argc >= 4) && (std::strcmp(argv[1], "extract") == 0))
+        return Extract(argv[2], argv[3]);
+    std::cout << "Usage: " << argv[0] << " analyze <corpus file> <result file> [threads] [depth]" << std::endl;
+    std::cout << "       " << argv[0] << " extract <replay file> <corpus file>" << std::endl;
+    return 1;
+}
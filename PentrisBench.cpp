@@ -0,0 +1,501 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <algorithm>
+#include "PentrisAI.h"
+#include "PentrisSimulation.h"
+#include "PentrisMCTS.h"
+#include "PentrisReplay.h"
+
+/*Headless benchmarks.
+  Usage: PentrisBench boards [stack rows]
+    Times one AI move on boards of increasing size, each with the same number of occupied rows at the bottom,
+    and reports the cost per move next to the board area
+  Usage: PentrisBench evaluators [games] [weights file]
+    Compares the built-in heuristic with the linear evaluator (with the heuristic's weights, and with trained weights if given)
+    and with the feature evaluator:
+    the cost of one evaluation on positions from real games, and the lines per game the AI clears with each of them
+  Usage: PentrisBench mcts [positions] [budget ms]
+    Runs the Monte Carlo tree search on positions from real games with 1, 2, 4, ... threads and a quarter, half and all of the
+    budget, and reports nodes/s and the decision quality: how often the chosen placement agrees with a reference search
+    on all threads with four times the budget (the exhaustive two-ply search is shown for comparison)
+  Usage: PentrisBench pruning [positions]
+    Runs the two-ply search with and without branch and bound on positions from real games, and reports the leaves
+    evaluated, the subtrees pruned, the time per move and whether both chose the same moves
+  Usage: PentrisBench deadline [games] [deadline us]
+    Plays two-ply games with no deadline and with a quarter, half and all of the given deadline per decision (see
+    PentrisAI::SetDeadline), and reports the lines per game, the share of decisions that missed the deadline and fell back
+    to the depth 0 move, and the decision latency percentiles
+  Usage: PentrisBench retention [positions]
+    Plays two-ply self-play games, in which each search can take its root placements over from the previous one (see
+    PentrisAI::CanReuseRoot), and searches every position again on a fresh AI. Reports how many searches reused their root
+    placements, the leaves evaluated per search by the fresh and the retaining AI, and whether both chose the same moves
+  Usage: PentrisBench stepped [positions]
+    Runs the cooperative two-ply search a few nodes at a time on positions from real games, polls CurrentBest after every
+    slice, and reports the polls that returned a placement the current pentomino cannot reach, and whether the completed
+    searches chose the same moves as Search
+  Usage: PentrisBench replay [games]
+    Records self-play games into a scratch replay file, abandoning every other game halfway (by starting the next one) and
+    leaving the last one unfinished when the file is closed, then replays the file. Reports the replay speed and whether
+    exactly the finished games came back, each verified*/
+
+namespace
+{
+    /*Fills the bottom stackRows rows of the field with a random, holey stack that has no complete rows*/
+    void BuildStack(PentrisField& field, const int stackRows, std::mt19937& rng)
+    {
+        for (int j = field.Height() - 1 - stackRows; j < field.Height() - 1; j++)
+        {
+            for (int i = 1; i < field.Width() - 1; i++)
+                if (rng() % 100 < 75)
+                    field.SetBlock(i, j, 1 + rng() % 12);
+            field.SetBlock(1 + rng() % (field.Width() - 2), j, 0);
+        }
+    }
+
+    int BenchBoards(const int stackRows)
+    {
+        const int sizes[][2] = { { 18, 35 }, { 34, 70 }, { 66, 140 }, { 130, 280 }, { 258, 1024 } };
+        const int repetitions = 5;
+        std::cout << std::setw(10) << "board" << std::setw(8) << "depth" << std::setw(12) << "leaves" << std::setw(14) << "ms/move"
+            << std::setw(12) << "ns/leaf" << std::setw(18) << "ns/move/cell" << std::endl;
+        for (const auto& size : sizes)
+            for (unsigned char depth = 0; depth <= 1; depth++)
+            {
+                //The two-ply search is quadratic in the board width, hence only run it on the smaller boards
+                if ((depth == 1) && (size[0] > 66))
+                    continue;
+                std::mt19937 rng(size[0] * 7919 + size[1]);
+                PentrisField field(size[0], size[1]);
+                BuildStack(field, stackRows, rng);
+                PentrisAI ai;
+                double totalMs = 0;
+                std::uint64_t leaves = 0;
+                for (int r = 0; r < repetitions; r++)
+                {
+                    ai.Search(field, depth);
+                    totalMs += ai.LastStats().wallTimeMs;
+                    leaves += ai.LastStats().leavesEvaluated;
+                }
+                double msPerMove = totalMs / repetitions;
+                double cells = (double)size[0] * size[1];
+                std::cout << std::setw(10) << (std::to_string(size[0]) + "x" + std::to_string(size[1])) << std::setw(8) << (int)depth
+                    << std::setw(12) << leaves / repetitions << std::setw(14) << std::fixed << std::setprecision(3) << msPerMove
+                    << std::setw(12) << std::setprecision(1) << ((leaves > 0) ? totalMs * 1e6 / leaves : 0.0)
+                    << std::setw(18) << std::setprecision(3) << msPerMove * 1e6 / cells << std::endl;
+            }
+        return 0;
+    }
+
+    int BenchEvaluators(const int games, const std::string& weightsPath)
+    {
+        const int width = 18, height = 35, maxPieces = 2000, evaluationRounds = 20;
+        struct Contender {
+            std::string name;
+            std::shared_ptr<const PentrisEvaluator> evaluator;
+        };
+        std::vector<Contender> contenders;
+        contenders.push_back({ "heuristic", nullptr });
+        contenders.push_back({ "linear (heuristic weights)", std::make_shared<PentrisLinearEvaluator>(width, height) });
+        contenders.push_back({ "features (default weights)", std::make_shared<PentrisFeatureEvaluator>() });
+        if (!weightsPath.empty())
+        {
+            auto trained = std::make_shared<PentrisLinearEvaluator>(width, height);
+            if (!trained->Load(weightsPath))
+            {
+                std::cout << "Could not load weights " << weightsPath << std::endl;
+                return 1;
+            }
+            contenders.push_back({ "linear (" + weightsPath + ")", trained });
+        }
+
+        //Positions from real games (the field after each placement)
+        std::vector<PentrisField> positions;
+        PentrisSimulation simulation(width, height);
+        simulation.maxPieces = 200;
+        for (std::uint32_t seed = 1; positions.size() < 4000; seed++)
+        {
+            simulation.Reset(seed);
+            while (simulation.Step())
+                positions.push_back(simulation.Field());
+        }
+
+        std::cout << std::setw(40) << "evaluator" << std::setw(12) << "ns/eval" << std::setw(14) << "lines/game" << std::setw(14) << "pieces/game" << std::endl;
+        for (const Contender& contender : contenders)
+        {
+            PentrisAI ai;
+            ai.SetEvaluator(contender.evaluator);
+            //Keeps the evaluations from being optimised away
+            volatile int sink = 0;
+            auto started = std::chrono::steady_clock::now();
+            for (int round = 0; round < evaluationRounds; round++)
+                for (const PentrisField& position : positions)
+                    sink = ai.EvaluateField(position);
+            (void)sink;
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count() / (evaluationRounds * positions.size());
+
+            long long lines = 0, pieces = 0;
+            simulation.maxPieces = maxPieces;
+            simulation.SetEvaluator(contender.evaluator);
+            for (int game = 0; game < games; game++)
+            {
+                simulation.PlayGame(1000003u * (game + 1));
+                lines += simulation.Lines();
+                pieces += simulation.Pieces();
+            }
+            std::cout << std::setw(40) << contender.name << std::setw(12) << std::fixed << std::setprecision(1) << ns
+                << std::setw(14) << (double)lines / games << std::setw(14) << (double)pieces / games << std::endl;
+        }
+        return 0;
+    }
+
+    int BenchMCTS(const int positionCount, const int budgetMs)
+    {
+        const int width = 18, height = 35;
+        //Every 10th position of heuristic self-play games
+        std::vector<PentrisField> positions;
+        PentrisSimulation simulation(width, height);
+        simulation.maxPieces = 300;
+        for (std::uint32_t seed = 1; (int)positions.size() < positionCount; seed++)
+        {
+            simulation.Reset(seed);
+            while (((int)positions.size() < positionCount) && simulation.Step())
+                if (simulation.Pieces() % 10 == 0)
+                    positions.push_back(simulation.Field());
+        }
+        auto SamePlacement = [](const Placement& a, const Placement& b)
+        {
+            return (a.pentominoId == b.pentominoId) && (a.orientation == b.orientation) && (a.posX == b.posX) && (a.posY == b.posY);
+        };
+
+        const unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        PentrisMCTS reference;
+        reference.threads = maxThreads;
+        reference.budgetMs = 4 * budgetMs;
+        std::vector<Placement> referencePlacements;
+        for (const PentrisField& position : positions)
+        {
+            reference.Search(position);
+            referencePlacements.push_back(reference.bestPlacement);
+        }
+
+        std::cout << std::setw(8) << "threads" << std::setw(12) << "budget ms" << std::setw(14) << "iterations/s" << std::setw(12) << "nodes/s"
+            << std::setw(12) << "agreement" << std::setw(14) << "chosen share" << std::endl;
+        PentrisAI exhaustive;
+        int exhaustiveAgreement = 0;
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            exhaustive.Search(positions[i], 1);
+            exhaustiveAgreement += SamePlacement(exhaustive.bestPlacement, referencePlacements[i]);
+        }
+        std::cout << std::setw(8) << "-" << std::setw(12) << "two-ply" << std::setw(14) << "-" << std::setw(12) << "-"
+            << std::setw(11) << std::fixed << std::setprecision(1) << 100.0 * exhaustiveAgreement / positions.size() << "%" << std::setw(14) << "-" << std::endl;
+        for (unsigned threads = 1; threads <= maxThreads; threads *= 2)
+            for (int budget = budgetMs / 4; budget <= budgetMs; budget *= 2)
+            {
+                PentrisMCTS mcts;
+                mcts.threads = threads;
+                mcts.budgetMs = budget;
+                std::uint64_t iterations = 0, nodes = 0;
+                double ms = 0, share = 0;
+                int agreement = 0;
+                for (size_t i = 0; i < positions.size(); i++)
+                {
+                    mcts.Search(positions[i], (std::uint32_t)i + 1);
+                    iterations += mcts.stats.iterations;
+                    nodes += mcts.stats.nodes;
+                    ms += mcts.stats.wallTimeMs;
+                    share += mcts.stats.chosenShare;
+                    agreement += SamePlacement(mcts.bestPlacement, referencePlacements[i]);
+                }
+                std::cout << std::setw(8) << threads << std::setw(12) << budget << std::setw(14) << std::setprecision(0) << iterations * 1000.0 / ms
+                    << std::setw(12) << nodes * 1000.0 / ms << std::setw(11) << std::setprecision(1) << 100.0 * agreement / positions.size() << "%"
+                    << std::setw(14) << std::setprecision(2) << share / positions.size() << std::endl;
+            }
+        return 0;
+    }
+
+    int BenchPruning(const int positionCount)
+    {
+        const int sizes[][2] = { { 18, 35 }, { 12, 22 } };
+        std::cout << std::setw(10) << "board" << std::setw(10) << "pruning" << std::setw(14) << "leaves/move" << std::setw(12) << "pruned"
+            << std::setw(12) << "ms/move" << std::setw(12) << "identical" << std::endl;
+        for (const auto& size : sizes)
+        {
+            //Every 3rd position of heuristic self-play games
+            std::vector<PentrisField> positions;
+            PentrisSimulation simulation(size[0], size[1]);
+            simulation.searchDepth = 0;
+            simulation.maxPieces = 400;
+            for (std::uint32_t seed = 1; (int)positions.size() < positionCount; seed++)
+            {
+                simulation.Reset(seed);
+                while (((int)positions.size() < positionCount) && simulation.Step())
+                    if (simulation.Pieces() % 3 == 0)
+                        positions.push_back(simulation.Field());
+            }
+            PentrisAI exhaustive, pruned;
+            exhaustive.SetPruning(false);
+            std::uint64_t leaves[2] = {}, subtrees[2] = {};
+            double ms[2] = {};
+            int identical = 0;
+            for (const PentrisField& position : positions)
+            {
+                const int exhaustiveEval = exhaustive.Search(position, 1);
+                const int prunedEval = pruned.Search(position, 1);
+                PentrisAI* ais[2] = { &exhaustive, &pruned };
+                for (int k = 0; k < 2; k++)
+                {
+                    leaves[k] += ais[k]->LastStats().leavesEvaluated;
+                    subtrees[k] += ais[k]->LastStats().subtreesPruned;
+                    ms[k] += ais[k]->LastStats().wallTimeMs;
+                }
+                const Placement& a = exhaustive.bestPlacement;
+                const Placement& b = pruned.bestPlacement;
+                identical += (exhaustiveEval == prunedEval) && (a.pentominoId == b.pentominoId) && (a.orientation == b.orientation)
+                    && (a.posX == b.posX) && (a.posY == b.posY) && (exhaustive.bestMoveSequence.size() == pruned.bestMoveSequence.size());
+            }
+            for (int k = 0; k < 2; k++)
+                std::cout << std::setw(10) << (std::to_string(size[0]) + "x" + std::to_string(size[1])) << std::setw(10) << (k ? "on" : "off")
+                    << std::setw(14) << leaves[k] / positions.size() << std::setw(12) << subtrees[k] << std::setw(12) << std::fixed
+                    << std::setprecision(3) << ms[k] / positions.size() << std::setw(11) << std::setprecision(1)
+                    << (k ? 100.0 * identical / positions.size() : 100.0) << "%" << std::endl;
+        }
+        return 0;
+    }
+
+    int BenchDeadline(const int games, const int deadlineUs)
+    {
+        const int width = 18, height = 35, maxPieces = 1000;
+        std::cout << std::setw(14) << "deadline us" << std::setw(14) << "lines/game" << std::setw(12) << "misses" << std::setw(10) << "p50 us"
+            << std::setw(10) << "p99 us" << std::setw(10) << "max us" << std::endl;
+        for (const int deadline : { 0, deadlineUs / 4, deadlineUs / 2, deadlineUs })
+        {
+            PentrisSimulation simulation(width, height);
+            simulation.searchDepth = 1;
+            simulation.maxPieces = maxPieces;
+            simulation.SetDeadline(deadline);
+            //The latencies of all games together
+            DecisionLatencies latencies;
+            long long lines = 0;
+            for (int game = 0; game < games; game++)
+            {
+                simulation.Reset(1000003u * (game + 1));
+                while (simulation.Step())
+                    latencies.Record(simulation.AI().LastStats());
+                lines += simulation.Lines();
+            }
+            std::cout << std::setw(14) << ((deadline > 0) ? std::to_string(deadline) : std::string("none")) << std::setw(14) << std::fixed
+                << std::setprecision(1) << (double)lines / games << std::setw(11) << 100.0 * latencies.DeadlineMisses() / std::max(1, latencies.Decisions())
+                << "%" << std::setw(10) << std::setprecision(0) << latencies.Percentile(0.5) << std::setw(10) << latencies.Percentile(0.99)
+                << std::setw(10) << latencies.Percentile(1.0) << std::endl;
+        }
+        return 0;
+    }
+
+    int BenchRetention(const int positionCount)
+    {
+        const int sizes[][2] = { { 18, 35 }, { 12, 22 } };
+        std::cout << std::setw(10) << "board" << std::setw(12) << "positions" << std::setw(12) << "reused" << std::setw(14) << "fresh leaves"
+            << std::setw(14) << "kept leaves" << std::setw(12) << "identical" << std::endl;
+        bool allIdentical = true;
+        for (const auto& size : sizes)
+        {
+            PentrisSimulation simulation(size[0], size[1]);
+            simulation.searchDepth = 1;
+            simulation.maxPieces = 300;
+            int positions = 0, reused = 0, identical = 0;
+            double freshLeaves = 0, retainedLeaves = 0;
+            for (std::uint32_t seed = 1; positions < positionCount; seed++)
+            {
+                simulation.Reset(seed);
+                while (positions < positionCount)
+                {
+                    PentrisAI fresh;
+                    const int freshEval = fresh.Search(simulation.Field(), 1);
+                    if (!simulation.Step())
+                        break;
+                    const PentrisAI& retaining = simulation.AI();
+                    const Placement& a = fresh.bestPlacement;
+                    const Placement& b = retaining.bestPlacement;
+                    positions++;
+                    reused += retaining.LastStats().rootReused;
+                    freshLeaves += fresh.LastStats().leavesEvaluated;
+                    retainedLeaves += retaining.LastStats().leavesEvaluated;
+                    identical += (freshEval == retaining.LastStats().bestEval) && (a.pentominoId == b.pentominoId) && (a.orientation == b.orientation)
+                        && (a.posX == b.posX) && (a.posY == b.posY) && (fresh.bestMoveSequence.size() == retaining.bestMoveSequence.size());
+                }
+            }
+            allIdentical = allIdentical && (identical == positions);
+            std::cout << std::setw(10) << (std::to_string(size[0]) + "x" + std::to_string(size[1])) << std::setw(12) << positions << std::setw(12)
+                << reused << std::setw(14) << std::fixed << std::setprecision(1) << freshLeaves / positions << std::setw(14) << retainedLeaves / positions
+                << std::setw(11) << 100.0 * identical / positions << "%" << std::endl;
+        }
+        return allIdentical ? 0 : 1;
+    }
+
+    int BenchStepped(const int positionCount)
+    {
+        const int width = 18, height = 35, nodesPerSlice = 3;
+        //Every 3rd position of heuristic self-play games
+        std::vector<PentrisField> positions;
+        PentrisSimulation simulation(width, height);
+        simulation.searchDepth = 0;
+        simulation.maxPieces = 400;
+        for (std::uint32_t seed = 1; (int)positions.size() < positionCount; seed++)
+        {
+            simulation.Reset(seed);
+            while (((int)positions.size() < positionCount) && simulation.Step())
+                if (simulation.Pieces() % 3 == 0)
+                    positions.push_back(simulation.Field());
+        }
+        PentrisAI reference, stepped, enumeration;
+        CandidateList reachable;
+        std::uint64_t polls = 0, found = 0, unreachable = 0;
+        int identical = 0;
+        for (const PentrisField& position : positions)
+        {
+            const int referenceEval = reference.Search(position, 1);
+            enumeration.EnumeratePlacements(position, reachable);
+            auto Reachable = [&](const Placement& placement)
+            {
+                const std::vector<int> shape = position.OrientPentomino(placement.pentominoId, placement.orientation);
+                for (const Placement& candidate : reachable.placements)
+                    if ((candidate.pentominoId == placement.pentominoId) && (candidate.posX == placement.posX) && (candidate.posY == placement.posY)
+                        && (position.OrientPentomino(candidate.pentominoId, candidate.orientation) == shape))
+                        return true;
+                return false;
+            };
+            stepped.BeginSearch(position, 1);
+            bool complete = false;
+            while (!complete)
+            {
+                complete = stepped.StepSearch(nodesPerSlice);
+                const BestMove best = stepped.CurrentBest();
+                polls++;
+                if (!best.found)
+                    continue;
+                found++;
+                unreachable += !Reachable(best.placement);
+            }
+            const Placement& a = reference.bestPlacement;
+            const Placement& b = stepped.bestPlacement;
+            identical += (referenceEval == stepped.LastStats().bestEval) && (a.pentominoId == b.pentominoId) && (a.orientation == b.orientation)
+                && (a.posX == b.posX) && (a.posY == b.posY) && (reference.bestMoveSequence.size() == stepped.bestMoveSequence.size());
+        }
+        std::cout << std::setw(12) << "positions" << std::setw(12) << "polls" << std::setw(12) << "found" << std::setw(14) << "unreachable"
+            << std::setw(12) << "identical" << std::endl;
+        std::cout << std::setw(12) << positions.size() << std::setw(12) << polls << std::setw(12) << found << std::setw(14) << unreachable
+            << std::setw(11) << std::fixed << std::setprecision(1) << 100.0 * identical / positions.size() << "%" << std::endl;
+        return ((unreachable == 0) && (identical == (int)positions.size())) ? 0 : 1;
+    }
+
+    int BenchReplay(const int games)
+    {
+        const char* path = "pentris_bench_replay.bin";
+        const int width = 18, height = 35, maxPieces = 300;
+        std::remove(path);
+        PentrisRecorder recorder;
+        if (!recorder.Open(path))
+        {
+            std::cout << "Could not open " << path << std::endl;
+            return 1;
+        }
+        //The finished games, as they were played
+        struct FinishedGame {
+            std::uint32_t seed;
+            int pieces, lines, score;
+            std::uint64_t fieldHash;
+        };
+        std::vector<FinishedGame> finished;
+        PentrisSimulation simulation(width, height);
+        simulation.maxPieces = maxPieces;
+        simulation.SetRecorder(&recorder);
+        for (int game = 0; game < games; game++)
+        {
+            simulation.Reset(1000003u * (game + 1));
+            if (game % 2 == 1)
+            {
+                //Abandoned halfway; the next Reset begins a new game over it
+                while ((simulation.Pieces() < maxPieces / 2) && simulation.Step());
+                continue;
+            }
+            while (simulation.Step());
+            finished.push_back({ simulation.Seed(), simulation.Pieces(), simulation.Lines(), simulation.Score(), simulation.Field().Hash() });
+        }
+        //Left unfinished when the file is closed
+        simulation.Reset(1);
+        for (int piece = 0; piece < 10; piece++)
+            simulation.Step();
+        simulation.SetRecorder(nullptr);
+        recorder.Close();
+
+        PentrisReplayer replayer;
+        if (!replayer.Open(path))
+        {
+            std::cout << "Could not read back " << path << std::endl;
+            return 1;
+        }
+        PentrisField field;
+        ReplayResult result;
+        size_t replayed = 0;
+        int matching = 0;
+        long long pieces = 0;
+        auto started = std::chrono::steady_clock::now();
+        while (replayer.NextGame(result, field))
+        {
+            if (replayed < finished.size())
+            {
+                const FinishedGame& played = finished[replayed];
+                matching += result.verified && (result.seed == played.seed) && (result.pieces == played.pieces)
+                    && (result.lines == played.lines) && (result.score == played.score) && (field.Hash() == played.fieldHash);
+            }
+            replayed++;
+            pieces += result.pieces;
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        std::remove(path);
+        std::cout << std::setw(10) << "finished" << std::setw(10) << "replayed" << std::setw(10) << "matching" << std::setw(12) << "pieces"
+            << std::setw(14) << "pieces/s" << std::endl;
+        std::cout << std::setw(10) << finished.size() << std::setw(10) << replayed << std::setw(10) << matching << std::setw(12) << pieces
+            << std::setw(14) << std::fixed << std::setprecision(0) << ((seconds > 0) ? pieces / seconds : 0.0) << std::endl;
+        return ((replayed == finished.size()) && (matching == (int)finished.size())) ? 0 : 1;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if ((argc >= 2) && (std::strcmp(argv[1], "boards") == 0))
+        return BenchBoards((argc >= 3) ? std::atoi(argv[2]) : 16);
+    if ((argc >= 2) && (std::strcmp(argv[1], "evaluators") == 0))
+        return BenchEvaluators((argc >= 3) ? std::atoi(argv[2]) : 50, (argc >= 4) ? argv[3] : "");
+    if ((argc >= 2) && (std::strcmp(argv[1], "mcts") == 0))
+        return BenchMCTS((argc >= 3) ? std::atoi(argv[2]) : 20, (argc >= 4) ? std::max(4, std::atoi(argv[3])) : 100);
+    if ((argc >= 2) && (std::strcmp(argv[1], "pruning") == 0))
+        return BenchPruning((argc >= 3) ? std::max(1, std::atoi(argv[2])) : 200);
+    if ((argc >= 2) && (std::strcmp(argv[1], "deadline") == 0))
+        return BenchDeadline((argc >= 3) ? std::max(1, std::atoi(argv[2])) : 10, (argc >= 4) ? std::max(4, std::atoi(argv[3])) : 2000);
+    if ((argc >= 2) && (std::strcmp(argv[1], "retention") == 0))
+        return BenchRetention((argc >= 3) ? std::max(1, std::atoi(argv[2])) : 800);
+    if ((argc >= 2) && (std::strcmp(argv[1], "stepped") == 0))
+        return BenchStepped((argc >= 3) ? std::max(1, std::atoi(argv[2])) : 200);
+    if ((argc >= 2) && (std::strcmp(argv[1], "replay") == 0))
+        return BenchReplay((argc >= 3) ? std::max(1, std::atoi(argv[2])) : 20);
+    std::cout << "Usage: " << argv[0] << " boards [stack rows]" << std::endl;
+    std::cout << "       " << argv[0] << " evaluators [games] [weights file]" << std::endl;
+    std::cout << "       " << argv[0] << " mcts [positions] [budget ms]" << std::endl;
+    std::cout << "       " << argv[0] << " pruning [positions]" << std::endl;
+    std::cout << "       " << argv[0] << " deadline [games] [deadline us]" << std::endl;
+    std::cout << "       " << argv[0] << " retention [positions]" << std::endl;
+    std::cout << "       " << argv[0] << " stepped [positions]" << std::endl;
+    std::cout << "       " << argv[0] << " replay [games]" << std::endl;
+    return 1;
+}
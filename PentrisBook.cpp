@@ -0,0 +1,179 @@
+#include "PentrisBook.h"
+#include "PentrisCorpus.h"
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    std::uint16_t GetU16(const std::uint8_t* in)
+    {
+        return (std::uint16_t)(in[0] | (in[1] << 8));
+    }
+
+    std::uint64_t GetU64(const std::uint8_t* in)
+    {
+        std::uint64_t value = 0;
+        for (int i = 7; i >= 0; i--)
+            value = (value << 8) | in[i];
+        return value;
+    }
+}
+
+bool PentrisBookFormat::Key(const PentrisField& field, std::uint64_t& key)
+{
+    const int currentId = field.PentominoId(field.currentPentomino);
+    if ((field.pentominoX != field.Width() / 2 - field.PENTOMINO_WIDTH / 2) || (field.pentominoY != 0) ||
+        (field.currentPentomino != field.GetPentomino(currentId)))
+        return false;
+    key = (field.Hash() ^ (std::uint64_t)(currentId | (field.PentominoId(field.nextPentomino) << 4))) * 0xBF58476D1CE4E5B9ull;
+    key ^= key >> 31;
+    return true;
+}
+
+PentrisBook::~PentrisBook()
+{
+    Close();
+}
+
+bool PentrisBook::Open(const std::string& path)
+{
+    Close();
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+    fileHandle = handle;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(handle, &fileSize) || (fileSize.QuadPart < (LONGLONG)PentrisBookFormat::HEADER_SIZE))
+    {
+        Close();
+        return false;
+    }
+    size = (size_t)fileSize.QuadPart;
+    mappingHandle = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mappingHandle == NULL)
+    {
+        Close();
+        return false;
+    }
+    data = (const std::uint8_t*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+    fileDescriptor = open(path.c_str(), O_RDONLY);
+    if (fileDescriptor < 0)
+        return false;
+    struct stat fileStat;
+    if ((fstat(fileDescriptor, &fileStat) != 0) || (fileStat.st_size < (off_t)PentrisBookFormat::HEADER_SIZE))
+    {
+        Close();
+        return false;
+    }
+    size = (size_t)fileStat.st_size;
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+    if (mapping != MAP_FAILED)
+    {
+        data = (const std::uint8_t*)mapping;
+        //Probes jump around the file, read-ahead would only fetch pages nobody asked for
+        madvise(mapping, size, MADV_RANDOM);
+    }
+#endif
+    if ((data == nullptr) || (std::memcmp(data, PentrisBookFormat::MAGIC, sizeof(PentrisBookFormat::MAGIC)) != 0)
+        || (GetU16(data + 4) != PentrisBookFormat::VERSION))
+    {
+        Close();
+        return false;
+    }
+    fieldWidth = GetU16(data + 6);
+    fieldHeight = GetU16(data + 8);
+    depth = data[10];
+    entries = (size - PentrisBookFormat::HEADER_SIZE) / PentrisBookFormat::ENTRY_SIZE;
+    return true;
+}
+
+void PentrisBook::Close()
+{
+#ifdef _WIN32
+    if (data != nullptr)
+        UnmapViewOfFile(data);
+    if (mappingHandle != nullptr)
+        CloseHandle(mappingHandle);
+    if (fileHandle != nullptr)
+        CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (data != nullptr)
+        munmap((void*)data, size);
+    if (fileDescriptor >= 0)
+        close(fileDescriptor);
+    fileDescriptor = -1;
+#endif
+    data = nullptr;
+    size = 0;
+    entries = 0;
+}
+
+bool PentrisBook::Probe(const PentrisField& field, Placement& placement, int& eval) const
+{
+    std::uint64_t key;
+    if ((data == nullptr) || (field.Width() != fieldWidth) || (field.Height() != fieldHeight) || !PentrisBookFormat::Key(field, key))
+        return false;
+    const std::uint8_t* first = data + PentrisBookFormat::HEADER_SIZE;
+    std::uint64_t low = 0, high = entries;
+    while (low < high)
+    {
+        const std::uint64_t middle = low + (high - low) / 2;
+        if (GetU64(first + middle * PentrisBookFormat::ENTRY_SIZE) < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if ((low == entries) || (GetU64(first + low * PentrisBookFormat::ENTRY_SIZE) != key))
+        return false;
+    const std::uint8_t* result = first + low * PentrisBookFormat::ENTRY_SIZE + 8;
+    placement.pentominoId = result[0] & 0x0F;
+    placement.orientation = (result[0] >> 4) & 0x07;
+    placement.posX = (std::int16_t)GetU16(result + 1);
+    placement.posY = (std::int16_t)GetU16(result + 3);
+    eval = (int)((std::uint32_t)result[5] | ((std::uint32_t)result[6] << 8) | ((std::uint32_t)result[7] << 16) | ((std::uint32_t)result[8] << 24));
+    return true;
+}
+
+bool PentrisBook::Write(const std::string& path, const int width, const int height, const int searchDepth, std::vector<BookEntry>& entries)
+{
+    std::sort(entries.begin(), entries.end(), [](const BookEntry& a, const BookEntry& b) { return a.key < b.key; });
+    entries.erase(std::unique(entries.begin(), entries.end(), [](const BookEntry& a, const BookEntry& b) { return a.key == b.key; }), entries.end());
+    std::ofstream file(path, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+    std::uint8_t header[PentrisBookFormat::HEADER_SIZE] = {};
+    std::memcpy(header, PentrisBookFormat::MAGIC, sizeof(PentrisBookFormat::MAGIC));
+    header[4] = (std::uint8_t)PentrisBookFormat::VERSION;
+    header[5] = (std::uint8_t)(PentrisBookFormat::VERSION >> 8);
+    header[6] = (std::uint8_t)width;
+    header[7] = (std::uint8_t)(width >> 8);
+    header[8] = (std::uint8_t)height;
+    header[9] = (std::uint8_t)(height >> 8);
+    header[10] = (std::uint8_t)searchDepth;
+    file.write((const char*)header, sizeof(header));
+    std::uint8_t entry[PentrisBookFormat::ENTRY_SIZE];
+    for (const BookEntry& bookEntry : entries)
+    {
+        for (int i = 0; i < 8; i++)
+            entry[i] = (std::uint8_t)(bookEntry.key >> (8 * i));
+        PentrisCorpusFormat::EncodeResult(entry + 8, bookEntry.placement, bookEntry.eval);
+        file.write((const char*)entry, sizeof(entry));
+    }
+    return (bool)file;
+}
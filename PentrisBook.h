@@ -0,0 +1,70 @@
+#pragma once
+
+#include "PentrisField.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*Opening book format. A book holds the search's answers for positions that come up at the start of every game, keyed by
+  the field's occupancy (PentrisField::Hash) together with the current and the next pentomino:
+    Header (16 bytes):  "PTBK", version (u16), field width (u16), field height (u16), search depth (u8), reserved (5 bytes)
+    Entry:              key (u64), then the chosen placement like a corpus result: pentomino (id | orientation << 4),
+                        posX (i16), posY (i16), eval (i32)
+  Entries are sorted by key, so a lookup is a binary search in the mapped file. All integers are little endian*/
+namespace PentrisBookFormat
+{
+    const char MAGIC[4] = { 'P', 'T', 'B', 'K' };
+    //Also identifies the search (and built-in heuristic) the answers come from, since a book only stands in for the search
+    //that built it: raised whenever the search chooses differently, so that older books are rejected.
+    //Version 2: rows completed by a placement are cleared before the ply below it is searched
+    const std::uint16_t VERSION = 2;
+    const size_t HEADER_SIZE = 16;
+    const size_t ENTRY_SIZE = 17;
+
+    //The key of the field's position; only positions whose current pentomino is unrotated in its spawn position have one
+    bool Key(const PentrisField& field, std::uint64_t& key);
+}
+
+/*A book entry as built in memory (see PentrisBook::Write)*/
+struct BookEntry {
+    std::uint64_t key = 0;
+    Placement placement;
+    int eval = 0;
+};
+
+/*Read-only view of an opening book through a memory mapping: opening it costs no more than mapping the file, and a probe
+  touches only the pages its binary search lands on*/
+class PentrisBook
+{
+private:
+    const std::uint8_t* data = nullptr;
+    size_t size = 0;
+    int fieldWidth = 0;
+    int fieldHeight = 0;
+    int depth = 0;
+    std::uint64_t entries = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fileDescriptor = -1;
+#endif
+public:
+    PentrisBook() {};
+    PentrisBook(const PentrisBook&) = delete;
+    PentrisBook& operator=(const PentrisBook&) = delete;
+    ~PentrisBook();
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return data != nullptr; };
+    std::uint64_t Count() const { return entries; };
+    int Width() const { return fieldWidth; };
+    int Height() const { return fieldHeight; };
+    //The search depth the answers were computed at
+    int Depth() const { return depth; };
+    //Looks up the field's position; true if the book holds it, with the placement the search chose and its valuation
+    bool Probe(const PentrisField& field, Placement& placement, int& eval) const;
+    //Sorts entries by key and writes them as a book for width x height fields searched at searchDepth
+    static bool Write(const std::string& path, const int width, const int height, const int searchDepth, std::vector<BookEntry>& entries);
+};
@@ -0,0 +1,138 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <unordered_set>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include "PentrisBook.h"
+#include "PentrisAI.h"
+
+/*Opening book builder: searches every position of the first plies of a game and writes the answers as a book (see
+  PentrisBook.h). A game starts on the empty field, and each ply places the current pentomino where the search puts it,
+  so the positions of ply n + 1 are the fields reached in ply n with the next pentomino as the current one, paired with
+  each of the 12 pentominos as the new next one: 144 positions in ply 0, 1728 in ply 1, 20736 in ply 2 and so on (fewer
+  once different moves lead to the same field).
+  Usage: PentrisBookTool <book> [options]
+    Options:
+        --plies <n>         number of plies to cover (default 3)
+        --depth <d>         search depth, which has to match the game's (default 1)
+        --width <w> --height <h> field size including walls and floor (default: the game's field)
+        --threads <n>       default: one per core*/
+
+namespace
+{
+    //A field reached by the book's moves, with the pentomino that is to be placed on it next
+    struct Node {
+        PentrisField field;
+        int currentId = 0;
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " <book> [--plies n] [--depth d] [--width w] [--height h] [--threads n]" << std::endl;
+        return 1;
+    }
+    PentrisField defaultField;
+    int plies = 3, depth = 1, width = defaultField.Width(), height = defaultField.Height();
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--plies") == 0)
+            plies = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--depth") == 0)
+            depth = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--width") == 0)
+            width = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--height") == 0)
+            height = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--threads") == 0)
+            threads = std::max(1, std::atoi(argv[i + 1]));
+        else
+        {
+            std::cout << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    const auto started = std::chrono::steady_clock::now();
+    std::vector<BookEntry> entries;
+    std::vector<Node> frontier;
+    PentrisField empty(width, height);
+    empty.Reset();
+    for (int id = 1; id <= 12; id++)
+        frontier.push_back({ empty, id });
+    for (int ply = 0; ply < plies; ply++)
+    {
+        //Every node of the frontier with every next pentomino
+        const size_t positions = frontier.size() * 12;
+        std::vector<BookEntry> plyEntries(positions);
+        std::vector<Node> children(positions);
+        std::vector<char> found(positions, 0);
+        std::atomic<size_t> nextPosition{ 0 };
+        auto Work = [&]()
+        {
+            PentrisAI ai;
+            for (size_t index = nextPosition++; index < positions; index = nextPosition++)
+            {
+                PentrisField field = frontier[index / 12].field;
+                field.currentPentomino = field.GetPentomino(frontier[index / 12].currentId);
+                field.nextPentomino = field.GetPentomino((int)(index % 12) + 1);
+                field.pentominoX = field.Width() / 2 - field.PENTOMINO_WIDTH / 2;
+                field.pentominoY = 0;
+                BookEntry& entry = plyEntries[index];
+                if (!PentrisBookFormat::Key(field, entry.key))
+                    continue;
+                entry.eval = ai.Search(field, (unsigned char)depth);
+                if (ai.bestMoveSequence.empty())
+                    continue;
+                entry.placement = ai.bestPlacement;
+                found[index] = 1;
+                //Play the move to reach the field of the next ply
+                const Placement& placement = entry.placement;
+                field.currentPentomino = field.OrientPentomino(placement.pentominoId, placement.orientation);
+                field.pentominoX = placement.posX;
+                field.pentominoY = placement.posY;
+                field.InsertCurrentPentomino();
+                if (field.MarkFilledRows(placement.posY, placement.posY + field.PENTOMINO_WIDTH - 1) > 0)
+                    field.ClearFilledRows();
+                children[index].field = field;
+                children[index].currentId = (int)(index % 12) + 1;
+            }
+        };
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++)
+            workers.emplace_back(Work);
+        Work();
+        for (std::thread& worker : workers)
+            worker.join();
+
+        std::vector<Node> nextFrontier;
+        std::unordered_set<std::uint64_t> seen;
+        for (size_t index = 0; index < positions; index++)
+        {
+            if (!found[index])
+                continue;
+            entries.push_back(plyEntries[index]);
+            if (seen.insert(children[index].field.Hash() * 13 + children[index].currentId).second)
+                nextFrontier.push_back(std::move(children[index]));
+        }
+        std::cout << "Ply " << ply << ": " << positions << " positions, " << nextFrontier.size() << " distinct fields reached, "
+            << std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count() << " s" << std::endl;
+        std::swap(frontier, nextFrontier);
+    }
+    if (!PentrisBook::Write(argv[1], width, height, depth, entries))
+    {
+        std::cout << "Could not write " << argv[1] << std::endl;
+        return 1;
+    }
+    std::cout << entries.size() << " entries written to " << argv[1] << " (" << PentrisBookFormat::HEADER_SIZE + entries.size() * PentrisBookFormat::ENTRY_SIZE
+        << " bytes)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include "PentrisCorpus.h"
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    void PutU16(std::uint8_t* out, const std::uint16_t value)
+    {
+        out[0] = (std::uint8_t)value;
+        out[1] = (std::uint8_t)(value >> 8);
+    }
+
+    std::uint16_t GetU16(const std::uint8_t* in)
+    {
+        return (std::uint16_t)(in[0] | (in[1] << 8));
+    }
+}
+
+void PentrisCorpusFormat::EncodeResult(std::uint8_t* out, const Placement& placement, const int eval)
+{
+    out[0] = (std::uint8_t)(placement.pentominoId | (placement.orientation << 4));
+    PutU16(out + 1, (std::uint16_t)placement.posX);
+    PutU16(out + 3, (std::uint16_t)placement.posY);
+    for (int i = 0; i < 4; i++)
+        out[5 + i] = (std::uint8_t)((std::uint32_t)eval >> (8 * i));
+}
+
+bool PentrisCorpusWriter::Open(const std::string& path, const int width, const int height)
+{
+    Close();
+    fieldWidth = width;
+    fieldHeight = height;
+    records = 0;
+    record.assign(PentrisCorpusFormat::RecordSize(width, height), 0);
+    file.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+    std::uint8_t header[PentrisCorpusFormat::HEADER_SIZE] = {};
+    std::memcpy(header, PentrisCorpusFormat::MAGIC, sizeof(PentrisCorpusFormat::MAGIC));
+    PutU16(header + 4, PentrisCorpusFormat::VERSION);
+    PutU16(header + 6, (std::uint16_t)width);
+    PutU16(header + 8, (std::uint16_t)height);
+    PutU16(header + 10, (std::uint16_t)record.size());
+    file.write((const char*)header, sizeof(header));
+    return true;
+}
+
+/*Appends a snapshot of the field's occupancy, current pentomino (with orientation and position) and next pentomino*/
+bool PentrisCorpusWriter::Append(const PentrisField& field)
+{
+    if (!file.is_open() || (field.Width() != fieldWidth) || (field.Height() != fieldHeight))
+        return false;
+    std::fill(record.begin(), record.end(), 0);
+    record[0] = (std::uint8_t)(field.PentominoId(field.currentPentomino) | (field.PentominoOrientation(field.currentPentomino) << 4));
+    record[1] = (std::uint8_t)field.PentominoId(field.nextPentomino);
+    PutU16(&record[2], (std::uint16_t)field.pentominoX);
+    PutU16(&record[4], (std::uint16_t)field.pentominoY);
+    const size_t rowBytes = PentrisCorpusFormat::RowBytes(fieldWidth);
+    std::uint8_t* markedRows = &record[6 + rowBytes * fieldHeight];
+    for (int j = 0; j < fieldHeight; j++)
+    {
+        for (int i = 0; i < fieldWidth; i++)
+            if (field(i, j) != 0)
+                record[6 + j * rowBytes + i / 8] |= (std::uint8_t)(1 << (i % 8));
+        //MarkFilledRows marks whole rows (walls excluded)
+        if (field(1, j) == field.FILLEDROW)
+            markedRows[j / 8] |= (std::uint8_t)(1 << (j % 8));
+    }
+    file.write((const char*)record.data(), record.size());
+    records++;
+    return (bool)file;
+}
+
+void PentrisCorpusWriter::Close()
+{
+    if (file.is_open())
+        file.close();
+}
+
+PentrisCorpusReader::~PentrisCorpusReader()
+{
+    Close();
+}
+
+bool PentrisCorpusReader::Open(const std::string& path)
+{
+    Close();
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+    fileHandle = handle;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(handle, &fileSize) || (fileSize.QuadPart < (LONGLONG)PentrisCorpusFormat::HEADER_SIZE))
+    {
+        Close();
+        return false;
+    }
+    size = (size_t)fileSize.QuadPart;
+    mappingHandle = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mappingHandle == NULL)
+    {
+        Close();
+        return false;
+    }
+    data = (const std::uint8_t*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+    fileDescriptor = open(path.c_str(), O_RDONLY);
+    if (fileDescriptor < 0)
+        return false;
+    struct stat fileStat;
+    if ((fstat(fileDescriptor, &fileStat) != 0) || (fileStat.st_size < (off_t)PentrisCorpusFormat::HEADER_SIZE))
+    {
+        Close();
+        return false;
+    }
+    size = (size_t)fileStat.st_size;
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+    if (mapping != MAP_FAILED)
+    {
+        data = (const std::uint8_t*)mapping;
+        //Records are visited front to back, so let the kernel read ahead and drop pages behind us
+        madvise(mapping, size, MADV_SEQUENTIAL);
+    }
+#endif
+    if ((data == nullptr) || (std::memcmp(data, PentrisCorpusFormat::MAGIC, sizeof(PentrisCorpusFormat::MAGIC)) != 0)
+        || (GetU16(data + 4) != PentrisCorpusFormat::VERSION))
+    {
+        Close();
+        return false;
+    }
+    fieldWidth = GetU16(data + 6);
+    fieldHeight = GetU16(data + 8);
+    recordSize = GetU16(data + 10);
+    if ((fieldWidth < PentrisField::MIN_WIDTH) || (fieldHeight < PentrisField::MIN_HEIGHT) ||
+        (fieldWidth > PentrisField::MAX_WIDTH) || (fieldHeight > PentrisField::MAX_HEIGHT) ||
+        (recordSize != PentrisCorpusFormat::RecordSize(fieldWidth, fieldHeight)))
+    {
+        Close();
+        return false;
+    }
+    records = (size - PentrisCorpusFormat::HEADER_SIZE) / recordSize;
+    return true;
+}
+
+void PentrisCorpusReader::Close()
+{
+#ifdef _WIN32
+    if (data != nullptr)
+        UnmapViewOfFile(data);
+    if (mappingHandle != nullptr)
+        CloseHandle(mappingHandle);
+    if (fileHandle != nullptr)
+        CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (data != nullptr)
+        munmap((void*)data, size);
+    if (fileDescriptor >= 0)
+        close(fileDescriptor);
+    fileDescriptor = -1;
+#endif
+    data = nullptr;
+    size = 0;
+    records = 0;
+}
+
+bool PentrisCorpusReader::Load(const std::uint64_t index, PentrisField& field) const
+{
+    const std::uint8_t* record = Record(index);
+    //An id outside 1-12 would give an empty pentomino, which the search cannot handle
+    const int currentId = record[0] & 0x0F;
+    const int orientation = record[0] >> 4;
+    if ((currentId < 1) || (currentId > 12) || (orientation > 7) || (record[1] < 1) || (record[1] > 12))
+        return false;
+    const size_t rowBytes = PentrisCorpusFormat::RowBytes(fieldWidth);
+    const std::uint8_t* rows = record + 6;
+    const std::uint8_t* markedRows = rows + rowBytes * fieldHeight;
+    for (int j = 0; j < fieldHeight; j++)
+    {
+        const bool marked = (markedRows[j / 8] >> (j % 8)) & 1;
+        for (int i = 0; i < fieldWidth; i++)
+        {
+            bool occupied = (rows[j * rowBytes + i / 8] >> (i % 8)) & 1;
+            //The colour of stored blocks is not kept; occupied cells are restored as wall blocks (which no pentomino removal can clear),
+            //except in marked rows, which keep FILLEDROW so that ClearFilledRows still removes them
+            const bool wall = (i == 0) || (i == fieldWidth - 1) || (j == fieldHeight - 1);
+            field.SetBlock(i, j, !occupied ? 0 : (marked && !wall) ? field.FILLEDROW : field.WALL);
+        }
+    }
+    field.currentPentomino = field.OrientPentomino(currentId, orientation);
+    field.nextPentomino = field.GetPentomino(record[1]);
+    field.pentominoX = (std::int16_t)GetU16(record + 2);
+    field.pentominoY = (std::int16_t)GetU16(record + 4);
+    return true;
+}
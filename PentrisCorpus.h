@@ -0,0 +1,84 @@
+#pragma once
+
+#include "PentrisField.h"
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*Flat position corpus format. Every record has the same size so that record i lives at
+  HEADER_SIZE + i * recordSize and can be read straight out of a memory mapping:
+    Header (16 bytes):  "PTPC", version (u16), field width (u16), field height (u16), record size (u16), reserved (u32)
+    Record:             current pentomino (id | orientation << 4), next pentomino id,
+                        pentominoX (i16), pentominoY (i16), occupancy bitmask (height rows of ceil(width / 8) bytes, walls included),
+                        marked row bitmask (ceil(height / 8) bytes; the rows filled with FILLEDROW, waiting to be cleared)
+  The result file written by the batch analyzer has one fixed-size record per position:
+    Header (16 bytes):  "PTPR", version (u16), result size (u16), record count (u64)
+    Result:             best pentomino (id | orientation << 4), posX (i16), posY (i16), eval (i32)
+  All integers are little endian*/
+namespace PentrisCorpusFormat
+{
+    const char MAGIC[4] = { 'P', 'T', 'P', 'C' };
+    const char RESULT_MAGIC[4] = { 'P', 'T', 'P', 'R' };
+    //Version 2: the marked row bitmask
+    const std::uint16_t VERSION = 2;
+    const size_t HEADER_SIZE = 16;
+    const size_t RESULT_SIZE = 9;
+
+    inline size_t RowBytes(const int width) { return (width + 7) / 8; }
+    inline size_t MarkedRowBytes(const int height) { return (height + 7) / 8; }
+    inline size_t RecordSize(const int width, const int height) { return 6 + RowBytes(width) * height + MarkedRowBytes(height); }
+    void EncodeResult(std::uint8_t* out, const Placement& placement, const int eval);
+}
+
+/*Appends field snapshots to a corpus file*/
+class PentrisCorpusWriter
+{
+private:
+    std::ofstream file;
+    std::vector<std::uint8_t> record;
+    int fieldWidth = 0;
+    int fieldHeight = 0;
+    std::uint64_t records = 0;
+public:
+    bool Open(const std::string& path, const int width, const int height);
+    bool Append(const PentrisField& field);
+    void Close();
+    std::uint64_t Count() const { return records; };
+};
+
+/*Read-only view of a corpus file through a memory mapping. Records are decoded straight from the mapped pages,
+  so a corpus far larger than physical memory can be streamed through*/
+class PentrisCorpusReader
+{
+private:
+    const std::uint8_t* data = nullptr;
+    size_t size = 0;
+    int fieldWidth = 0;
+    int fieldHeight = 0;
+    size_t recordSize = 0;
+    std::uint64_t records = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fileDescriptor = -1;
+#endif
+public:
+    PentrisCorpusReader() {};
+    PentrisCorpusReader(const PentrisCorpusReader&) = delete;
+    PentrisCorpusReader& operator=(const PentrisCorpusReader&) = delete;
+    ~PentrisCorpusReader();
+    bool Open(const std::string& path);
+    void Close();
+    std::uint64_t Count() const { return records; };
+    int Width() const { return fieldWidth; };
+    int Height() const { return fieldHeight; };
+    //Raw (zero-copy) access to the bytes of record index
+    const std::uint8_t* Record(const std::uint64_t index) const { return data + PentrisCorpusFormat::HEADER_SIZE + index * recordSize; };
+    //Decodes record index into field, which must have the corpus' width and height. Blocks come back as WALL (their colours
+    //are not stored), and marked rows as FILLEDROW. Returns false (leaving field as it was) if the record's pentomino
+    //ids or orientation are out of range
+    bool Load(const std::uint64_t index, PentrisField& field) const;
+};
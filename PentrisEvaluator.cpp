@@ -0,0 +1,454 @@
+#include "PentrisEvaluator.h"
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define PENTRIS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    const char WEIGHTS_MAGIC[] = "pentris-linear";
+    const int WEIGHTS_VERSION = 1;
+    //Feature vectors up to this length live on the stack during Evaluate
+    const int MAX_STACK_FEATURES = 1024;
+    const int MAX_STACK_WORDS = 32;
+
+    /*Dot product of two int16 vectors whose length is a multiple of PentrisLinearEvaluator::LANES, accumulated in 32 bits*/
+    std::int32_t DotProduct(const std::int16_t* a, const std::int16_t* b, const int count)
+    {
+#ifdef PENTRIS_SSE2
+        __m128i sum = _mm_setzero_si128();
+        for (int i = 0; i < count; i += PentrisLinearEvaluator::LANES)
+        {
+            const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+            const __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+            //Multiplies the 8 lanes pairwise and adds neighbouring products into 4 32 bit sums
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(va, vb));
+        }
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(sum);
+#else
+        std::int32_t sum = 0;
+        for (int i = 0; i < count; i++)
+            sum += (std::int32_t)a[i] * b[i];
+        return sum;
+#endif
+    }
+}
+
+PentrisLinearEvaluator::PentrisLinearEvaluator(const int width, const int height)
+{
+    fieldWidth = width;
+    fieldHeight = height;
+    weights.assign(PaddedFeatureCount(width), 0);
+    SetHeuristicWeights();
+}
+
+/*Writes the features of field into features (PaddedFeatureCount(field.Width()) values, see the class comment).
+  Like the AI's bitset evaluation, only the rows between the stack top and the floor are visited, a word at a time*/
+void PentrisLinearEvaluator::ExtractFeatures(const PentrisField& field, std::int16_t* features)
+{
+    const int w = field.Width();
+    const int h = field.Height();
+    const int n = w - 2;
+    const int words = field.WordsPerRow();
+    const std::uint64_t* interior = field.InteriorMask();
+    std::fill(features, features + PaddedFeatureCount(w), (std::int16_t)0);
+    //Column i (1 to w - 2) is at index i - 1 of each group
+    std::int16_t* heights = features;
+    std::int16_t* differences = features + n;
+    std::int16_t* holes = features + 2 * n - 1;
+    std::int16_t* totals = features + 3 * n - 1;
+
+    //Bits of the columns whose top block has already been passed
+    std::uint64_t coveredBuffer[MAX_STACK_WORDS] = {};
+    std::vector<std::uint64_t> coveredVector;
+    if (words > MAX_STACK_WORDS)
+        coveredVector.resize(words, 0);
+    std::uint64_t* covered = (words > MAX_STACK_WORDS) ? coveredVector.data() : coveredBuffer;
+    int filledRows = 0;
+    for (int j = field.StackTop(); j < h - 1; j++)
+    {
+        const std::uint64_t* row = field.RowBits(j);
+        bool filledRow = true;
+        for (int k = 0; k < words; k++)
+        {
+            const std::uint64_t cells = row[k] & interior[k];
+            if (cells != interior[k])
+                filledRow = false;
+            std::uint64_t newHoles = covered[k] & ~cells;
+            while (newHoles != 0)
+            {
+                holes[k * PentrisFieldKernels::BITS_PER_WORD + PentrisFieldKernels::LowestBit(newHoles) - 1]++;
+                newHoles &= newHoles - 1;
+            }
+            std::uint64_t newTops = cells & ~covered[k];
+            while (newTops != 0)
+            {
+                heights[k * PentrisFieldKernels::BITS_PER_WORD + PentrisFieldKernels::LowestBit(newTops) - 1] = (std::int16_t)(h - j - 1);
+                newTops &= newTops - 1;
+            }
+            covered[k] |= cells;
+        }
+        if (filledRow)
+            filledRows++;
+    }
+    int maxHeight = 0;
+    for (int i = 0; i < n; i++)
+    {
+        maxHeight = std::max(maxHeight, (int)heights[i]);
+        if (i > 0)
+            differences[i - 1] = (std::int16_t)std::abs(heights[i] - heights[i - 1]);
+    }
+    //Rows the search has already cleared count as filled rows
+    totals[0] = (std::int16_t)(filledRows + field.ClearedRows());
+    totals[1] = (std::int16_t)maxHeight;
+    totals[2] = (h - maxHeight <= PentrisFieldKernels::PENTOMINO_WIDTH + 1) ? 1 : 0;
+    totals[3] = 1;
+}
+
+int PentrisLinearEvaluator::Evaluate(const PentrisField& field) const
+{
+    //ExtractFeatures writes as many features as field's width calls for, the buffer holds as many as the model's
+    if ((field.Width() != fieldWidth) || (field.Height() != fieldHeight))
+        return std::numeric_limits<int>::min() + 1;
+    const int count = (int)weights.size();
+    alignas(16) std::int16_t featureBuffer[MAX_STACK_FEATURES];
+    std::vector<std::int16_t> featureVector;
+    if (count > MAX_STACK_FEATURES)
+        featureVector.resize(count);
+    std::int16_t* features = (count > MAX_STACK_FEATURES) ? featureVector.data() : featureBuffer;
+    ExtractFeatures(field, features);
+    return DotProduct(features, weights.data(), count) >> shift;
+}
+
+/*Quantises real valued weights (in units of the evaluation, one per feature) to 16 bit fixed point.
+  The shift is chosen as large as possible while every weight fits into 16 bits and the dot product cannot overflow 32 bits.
+  Weights too large for that even without a shift are all scaled down by the same factor (which keeps their ratios, and
+  hence the choices of the search, but scales the evaluation down with them)*/
+void PentrisLinearEvaluator::SetWeights(const std::vector<double>& realWeights)
+{
+    double maxWeight = 0;
+    double sumWeights = 0;
+    for (int i = 0; i < FeatureCount(fieldWidth); i++)
+    {
+        maxWeight = std::max(maxWeight, std::fabs(realWeights[i]));
+        sumWeights += std::fabs(realWeights[i]);
+    }
+    //No feature exceeds the field height
+    double scale = 1.0;
+    if ((maxWeight > 32767.0) || (sumWeights * fieldHeight > 2147483647.0))
+        scale = std::min(32767.0 / maxWeight, 2147483647.0 / (sumWeights * fieldHeight));
+    shift = 0;
+    while ((shift < 16) && (maxWeight * (1 << (shift + 1)) < 32767.0) && (sumWeights * fieldHeight * (1 << (shift + 1)) < 2147483647.0))
+        shift++;
+    std::fill(weights.begin(), weights.end(), (std::int16_t)0);
+    for (int i = 0; i < FeatureCount(fieldWidth); i++)
+        weights[i] = (std::int16_t)std::max(-32767L, std::min(32767L, std::lround(realWeights[i] * scale * (1 << shift))));
+}
+
+/*Returns the weights in units of the evaluation*/
+std::vector<double> PentrisLinearEvaluator::RealWeights() const
+{
+    std::vector<double> realWeights(FeatureCount(fieldWidth));
+    for (size_t i = 0; i < realWeights.size(); i++)
+        realWeights[i] = (double)weights[i] / (1 << shift);
+    return realWeights;
+}
+
+/*Sets the weights that reproduce PentrisAI's built-in heuristic (up to the rounding of its average height difference)*/
+void PentrisLinearEvaluator::SetHeuristicWeights()
+{
+    const int n = fieldWidth - 2;
+    std::vector<double> realWeights(FeatureCount(fieldWidth), 0.0);
+    for (int i = 0; i < n - 1; i++)
+        realWeights[n + i] = -20.0 / n;
+    for (int i = 0; i < n; i++)
+        realWeights[2 * n - 1 + i] = -50.0;
+    realWeights[3 * n - 1] = 30.0;
+    realWeights[3 * n] = -1.0;
+    realWeights[3 * n + 1] = -2000.0;
+    SetWeights(realWeights);
+}
+
+/*Loads the weights from a text file: a "pentris-linear <version>" line, the field width, height and shift,
+  followed by one integer weight per feature. Fails (leaving the weights unchanged) if the file is not for this field size,
+  or if its weights do not fit into 16 bits or could overflow the 32 bit dot product (see SetWeights)*/
+bool PentrisLinearEvaluator::Load(const std::string& path)
+{
+    std::ifstream file(path);
+    std::string magic;
+    int version, width, height, fileShift;
+    if (!(file >> magic >> version >> width >> height >> fileShift))
+        return false;
+    if ((magic != WEIGHTS_MAGIC) || (version != WEIGHTS_VERSION) || (width != fieldWidth) || (height != fieldHeight) || (fileShift < 0) || (fileShift > 16))
+        return false;
+    std::vector<std::int16_t> fileWeights(weights.size(), 0);
+    long long sumWeights = 0;
+    for (int i = 0; i < FeatureCount(fieldWidth); i++)
+    {
+        int weight;
+        if (!(file >> weight) || (weight < -32768) || (weight > 32767))
+            return false;
+        fileWeights[i] = (std::int16_t)weight;
+        sumWeights += std::abs(weight);
+    }
+    if (sumWeights * fieldHeight > 2147483647LL)
+        return false;
+    weights = fileWeights;
+    shift = fileShift;
+    return true;
+}
+
+bool PentrisLinearEvaluator::Save(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+    file << WEIGHTS_MAGIC << " " << WEIGHTS_VERSION << "\n" << fieldWidth << " " << fieldHeight << " " << shift << "\n";
+    //One line per feature group: heights, height differences, holes, and the four totals
+    const int n = fieldWidth - 2;
+    const int groupEnds[] = { n, 2 * n - 1, 3 * n - 1, 3 * n + 3 };
+    int group = 0;
+    for (int i = 0; i < FeatureCount(fieldWidth); i++)
+    {
+        const bool lastInGroup = (i + 1 == groupEnds[group]);
+        file << weights[i] << (lastInGroup ? "\n" : " ");
+        if (lastInGroup)
+            group++;
+    }
+    return file.good();
+}
+
+namespace
+{
+    const char FEATURES_MAGIC[] = "pentris-features";
+    const int FEATURES_VERSION = 1;
+    const char* const FEATURE_NAMES[PentrisFeatureEvaluator::FEATURE_COUNT] = { "landing_height", "eroded_blocks", "row_transitions",
+        "column_transitions", "holes", "hole_depth", "rows_with_holes", "well_depth", "max_height", "danger" };
+    //Planes of the bit-sliced column counters: enough for fields up to 65535 rows
+    const int MAX_PLANES = 16;
+}
+
+PentrisFeatureEvaluator::PentrisFeatureEvaluator()
+{
+    SetDefaultWeights();
+}
+
+/*BCTS's weights (rounded, and halved for the landing height, which is counted in half rows), plus the danger penalty of
+  the built-in heuristic*/
+void PentrisFeatureEvaluator::SetDefaultWeights()
+{
+    weights[LANDING_HEIGHT] = -6;
+    weights[ERODED_BLOCKS] = 7;
+    weights[ROW_TRANSITIONS] = -9;
+    weights[COLUMN_TRANSITIONS] = -20;
+    weights[HOLES] = -13;
+    weights[HOLE_DEPTH] = -2;
+    weights[ROWS_WITH_HOLES] = -24;
+    weights[WELL_DEPTH] = -10;
+    weights[MAX_HEIGHT] = 0;
+    weights[DANGER] = -2000;
+}
+
+const char* PentrisFeatureEvaluator::FeatureName(const Feature feature)
+{
+    return ((feature >= 0) && (feature < FEATURE_COUNT)) ? FEATURE_NAMES[feature] : "unknown";
+}
+
+namespace
+{
+    /*The feature extraction behind PentrisFeatureEvaluator::ExtractFeatures, templated over the number of words per row
+      (WORDS = 0 uses the field's runtime count): with one word, the usual case, all the per column state stays in registers.
+      Only the rows between the stack top and the floor are visited; the rows above contribute two row transitions each*/
+    template<int WORDS>
+    void ExtractFeaturesKernel(const PentrisField& field, int* features)
+    {
+        typedef PentrisFeatureEvaluator F;
+        const int h = field.Height();
+        const int words = (WORDS > 0) ? WORDS : field.WordsPerRow();
+        const std::uint64_t* interior = field.InteriorMask();
+        int planes = 1;
+        while ((planes < MAX_PLANES) && ((1 << planes) < h))
+            planes++;
+
+        //Per word: the columns whose top block has been passed, the previous row's blocks, the columns whose well run goes on,
+        //and the bit-sliced counters of the occupied blocks above (for the hole depth) and of the length of the well runs
+        const int perWord = 3 + 2 * MAX_PLANES;
+        std::uint64_t stackBuffer[((WORDS > 0) ? WORDS : MAX_STACK_WORDS) * perWord];
+        std::vector<std::uint64_t> vectorBuffer;
+        if (words > MAX_STACK_WORDS)
+            vectorBuffer.resize((size_t)words * perWord);
+        std::uint64_t* covered = (words > MAX_STACK_WORDS) ? vectorBuffer.data() : stackBuffer;
+        std::uint64_t* above = covered + words;
+        std::uint64_t* inWell = above + words;
+        std::uint64_t* depthPlanes = inWell + words;
+        std::uint64_t* wellPlanes = depthPlanes + words * MAX_PLANES;
+        std::fill(covered, depthPlanes, 0);
+        for (int k = 0; k < words; k++)
+            for (int p = 0; p < planes; p++)
+            {
+                depthPlanes[k * MAX_PLANES + p] = 0;
+                wellPlanes[k * MAX_PLANES + p] = 0;
+            }
+
+        const int insertY = field.LastInsertY();
+        int erodedRows = 0, erodedBlocks = 0;
+        int rowTransitions = 2 * field.StackTop();
+        int columnTransitions = 0, holes = 0, holeDepth = 0, rowsWithHoles = 0, wellDepth = 0;
+        for (int j = field.StackTop(); j < h - 1; j++)
+        {
+            const std::uint64_t* row = field.RowBits(j);
+            bool filledRow = true;
+            std::uint64_t rowHoles = 0;
+            for (int k = 0; k < words; k++)
+            {
+                const std::uint64_t blocks = row[k];
+                const std::uint64_t cells = blocks & interior[k];
+                if (cells != interior[k])
+                    filledRow = false;
+                //Bit i of right is block i + 1, bit i of left is block i - 1 (carried across the words)
+                const std::uint64_t right = (blocks >> 1) | ((k + 1 < words) ? row[k + 1] << 63 : 0);
+                const std::uint64_t left = (blocks << 1) | ((k > 0) ? row[k - 1] >> 63 : 0);
+                //Neighbouring pairs (i, i + 1) from the left wall to the last interior column
+                rowTransitions += PentrisFieldKernels::PopCount((blocks ^ right) & (interior[k] | ((k == 0) ? 1 : 0)));
+                columnTransitions += PentrisFieldKernels::PopCount(cells ^ above[k]);
+                above[k] = cells;
+
+                const std::uint64_t newHoles = covered[k] & ~cells;
+                std::uint64_t* depth = depthPlanes + k * MAX_PLANES;
+                if (newHoles != 0)
+                {
+                    rowHoles |= newHoles;
+                    holes += PentrisFieldKernels::PopCount(newHoles);
+                    for (int p = 0; p < planes; p++)
+                        holeDepth += PentrisFieldKernels::PopCount(depth[p] & newHoles) << p;
+                }
+                //Add this row's blocks to the counters (a ripple carry through the planes)
+                std::uint64_t carry = cells;
+                for (int p = 0; (p < planes) && (carry != 0); p++)
+                {
+                    const std::uint64_t next = depth[p] & carry;
+                    depth[p] ^= carry;
+                    carry = next;
+                }
+
+                //Open blocks with both neighbours occupied extend their well run, all other columns start over.
+                //Most rows have no well, and then there is nothing to count
+                const std::uint64_t wells = ~blocks & left & right & interior[k] & ~covered[k];
+                if ((wells | inWell[k]) != 0)
+                {
+                    std::uint64_t* run = wellPlanes + k * MAX_PLANES;
+                    carry = wells;
+                    for (int p = 0; p < planes; p++)
+                    {
+                        run[p] &= wells;
+                        const std::uint64_t next = run[p] & carry;
+                        run[p] ^= carry;
+                        carry = next;
+                        wellDepth += PentrisFieldKernels::PopCount(run[p]) << p;
+                    }
+                    inWell[k] = wells;
+                }
+                covered[k] |= cells;
+            }
+            if (rowHoles != 0)
+                rowsWithHoles++;
+            if (filledRow && (insertY >= 0) && (j >= insertY) && (j < insertY + PentrisFieldKernels::PENTOMINO_WIDTH))
+            {
+                erodedRows++;
+                erodedBlocks += field.LastInsertRowBlocks()[j - insertY];
+            }
+        }
+        //The bottom row meets the floor
+        for (int k = 0; k < words; k++)
+            columnTransitions += PentrisFieldKernels::PopCount(~above[k] & interior[k]);
+
+        int landingHeight = 0;
+        if (insertY >= 0)
+        {
+            int top = PentrisFieldKernels::PENTOMINO_WIDTH, bottom = -1;
+            for (int r = 0; r < PentrisFieldKernels::PENTOMINO_WIDTH; r++)
+                if (field.LastInsertRowBlocks()[r] > 0)
+                {
+                    top = std::min(top, r);
+                    bottom = r;
+                }
+            if (bottom >= 0)
+                landingHeight = 2 * (h - 1) - (insertY + top) - (insertY + bottom);
+        }
+        const int maxHeight = h - 1 - field.StackTop();
+        features[F::LANDING_HEIGHT] = landingHeight;
+        //Plus the rows cleared by earlier placements of the search
+        features[F::ERODED_BLOCKS] = erodedRows * erodedBlocks + field.ClearedErodedBlocks();
+        features[F::ROW_TRANSITIONS] = rowTransitions;
+        features[F::COLUMN_TRANSITIONS] = columnTransitions;
+        features[F::HOLES] = holes;
+        features[F::HOLE_DEPTH] = holeDepth;
+        features[F::ROWS_WITH_HOLES] = rowsWithHoles;
+        features[F::WELL_DEPTH] = wellDepth;
+        features[F::MAX_HEIGHT] = maxHeight;
+        features[F::DANGER] = (h - maxHeight <= PentrisFieldKernels::PENTOMINO_WIDTH + 1) ? 1 : 0;
+    }
+}
+
+/*Writes the FEATURE_COUNT features of field into features (see the class comment)*/
+void PentrisFeatureEvaluator::ExtractFeatures(const PentrisField& field, int* features)
+{
+    if (field.WordsPerRow() == 1)
+        ExtractFeaturesKernel<1>(field, features);
+    else
+        ExtractFeaturesKernel<0>(field, features);
+}
+
+int PentrisFeatureEvaluator::Evaluate(const PentrisField& field) const
+{
+    int features[FEATURE_COUNT];
+    ExtractFeatures(field, features);
+    int eval = 0;
+    for (int i = 0; i < FEATURE_COUNT; i++)
+        eval += weights[i] * features[i];
+    return eval;
+}
+
+/*Loads the weights from a text file: a "pentris-features <version>" line followed by "<feature name> <weight>" lines.
+  Features the file does not mention keep their weight. Fails (leaving the weights unchanged) on an unknown name*/
+bool PentrisFeatureEvaluator::Load(const std::string& path)
+{
+    std::ifstream file(path);
+    std::string magic;
+    int version;
+    if (!(file >> magic >> version) || (magic != FEATURES_MAGIC) || (version != FEATURES_VERSION))
+        return false;
+    int fileWeights[FEATURE_COUNT];
+    std::copy(weights, weights + FEATURE_COUNT, fileWeights);
+    std::string name;
+    int weight;
+    while (file >> name >> weight)
+    {
+        const int feature = (int)(std::find(FEATURE_NAMES, FEATURE_NAMES + FEATURE_COUNT, name) - FEATURE_NAMES);
+        if (feature == FEATURE_COUNT)
+            return false;
+        fileWeights[feature] = weight;
+    }
+    if (!file.eof())
+        return false;
+    std::copy(fileWeights, fileWeights + FEATURE_COUNT, weights);
+    return true;
+}
+
+bool PentrisFeatureEvaluator::Save(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+    file << FEATURES_MAGIC << " " << FEATURES_VERSION << "\n";
+    for (int i = 0; i < FEATURE_COUNT; i++)
+        file << FEATURE_NAMES[i] << " " << weights[i] << "\n";
+    return file.good();
+}
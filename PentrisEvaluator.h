@@ -0,0 +1,91 @@
+#pragma once
+
+#include "PentrisField.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*A valuation of the field at a leaf of the AI's search: the higher, the better.
+  The AI uses its built-in heuristic unless an evaluator is plugged in (see PentrisAI::SetEvaluator).
+  Evaluate may be called from several search threads at once*/
+class PentrisEvaluator
+{
+public:
+    virtual ~PentrisEvaluator() {};
+    virtual int Evaluate(const PentrisField& field) const = 0;
+};
+
+/*A linear model over features of the field, evaluated in 16 bit fixed point:
+      eval = (sum over i of weight[i] * feature[i]) >> shift
+  For a field with n = width - 2 columns between the walls, the features are (in this order)
+      n column heights, n - 1 absolute height differences of neighbouring columns, n hole counts (empty blocks below
+      the top of their column), the number of filled rows, the maximum column height, a flag that is 1 at a height at
+      which the game is about to be lost, and the constant 1.
+  A model only fits fields of the width and height it was created for: Evaluate refuses any other field (its features
+  would not line up with the weights, and may not fit the feature buffer) by valuing it at the lowest value a search still
+  chooses, std::numeric_limits<int>::min() + 1.
+  Its weights are trained offline from self-play records (see PentrisTrainTool) and stored in a small text file*/
+class PentrisLinearEvaluator : public PentrisEvaluator
+{
+private:
+    int fieldWidth = 0;
+    int fieldHeight = 0;
+    int shift = 0;
+    //One weight per feature, padded with zeros to a multiple of LANES
+    std::vector<std::int16_t> weights;
+public:
+    //Number of 16 bit lanes processed at once by the dot product
+    static const int LANES = 8;
+    static int FeatureCount(const int width) { return 3 * (width - 2) + 3; };
+    static int PaddedFeatureCount(const int width) { return (FeatureCount(width) + LANES - 1) / LANES * LANES; };
+
+    PentrisLinearEvaluator(const int width, const int height);
+    bool Load(const std::string& path);
+    bool Save(const std::string& path) const;
+    void SetWeights(const std::vector<double>& realWeights);
+    std::vector<double> RealWeights() const;
+    void SetHeuristicWeights();
+    static void ExtractFeatures(const PentrisField& field, std::int16_t* features);
+    int Evaluate(const PentrisField& field) const override;
+
+    int Width() const { return fieldWidth; };
+    int Height() const { return fieldHeight; };
+};
+
+/*The Dellacherie / El-Tetris style features of a field, weighted:
+      eval = sum over i of weight[i] * feature[i]
+  The features (in this order):
+      LANDING_HEIGHT      height of the middle of the most recently inserted pentomino above the floor, in half rows
+      ERODED_BLOCKS       rows completed by that pentomino times the number of its blocks in them
+      ROW_TRANSITIONS     changes between empty and occupied along the rows (the walls count as occupied)
+      COLUMN_TRANSITIONS  the same along the columns (the floor counts as occupied, the space above the field as empty)
+      HOLES               empty blocks below the top of their column
+      HOLE_DEPTH          the occupied blocks above each hole, summed over the holes
+      ROWS_WITH_HOLES     rows holding at least one hole
+      WELL_DEPTH          cumulative well depth: a run of d open blocks whose neighbours are both occupied adds 1 + 2 + ... + d
+      MAX_HEIGHT          the height of the stack
+      DANGER              1 at a height at which the game is about to be lost
+  They are computed a word of columns at a time on the row bitsets: transitions are popcounts of a row XORed with itself
+  shifted by one column (or with the row above), and the per column counts behind the hole and well depths are kept as
+  bit-sliced counters (bit p of every column in one word), so a leaf costs a handful of word operations per stack row.
+  The last placement is read from the field (PentrisField::LastInsertY), so it is only known until rows are cleared; rows
+  the search clears between plies add their eroded blocks through PentrisField::ClearedErodedBlocks.
+  The weights default to values adapted from Thiery and Scherrer's BCTS player and can be loaded from a text file*/
+class PentrisFeatureEvaluator : public PentrisEvaluator
+{
+public:
+    enum Feature { LANDING_HEIGHT, ERODED_BLOCKS, ROW_TRANSITIONS, COLUMN_TRANSITIONS, HOLES, HOLE_DEPTH, ROWS_WITH_HOLES,
+        WELL_DEPTH, MAX_HEIGHT, DANGER, FEATURE_COUNT };
+private:
+    int weights[FEATURE_COUNT] = {};
+public:
+    PentrisFeatureEvaluator();
+    void SetDefaultWeights();
+    void SetWeight(const Feature feature, const int weight) { weights[feature] = weight; };
+    int Weight(const Feature feature) const { return weights[feature]; };
+    static const char* FeatureName(const Feature feature);
+    bool Load(const std::string& path);
+    bool Save(const std::string& path) const;
+    static void ExtractFeatures(const PentrisField& field, int* features);
+    int Evaluate(const PentrisField& field) const override;
+};
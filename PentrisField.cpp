@@ -1,15 +1,30 @@
 #include "PentrisField.h"
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+    //Field sizes with compile-time specialised kernels. Any other size uses the runtime-sized fallback (the last entry)
+    const PentrisFieldKernelTable KERNEL_TABLES[] = {
+        { 18, 35, &PentrisFieldKernels::DoesPentominoFit<18, 35>, &PentrisFieldKernels::MarkFilledRows<18, 35> },
+        { 12, 22, &PentrisFieldKernels::DoesPentominoFit<12, 22>, &PentrisFieldKernels::MarkFilledRows<12, 22> },
+        { 0, 0, &PentrisFieldKernels::DoesPentominoFit<0, 0>, &PentrisFieldKernels::MarkFilledRows<0, 0> }
+    };
+}
 
 PentrisField::PentrisField(const unsigned width, const unsigned height)
 {
 	fieldWidth = width;
 	fieldHeight = height;
+    Seed(std::rand());
     Reset();
 }
 
 /*Construct field at default width and height*/
 PentrisField::PentrisField()
 {
+    Seed(std::rand());
     Reset();
 }
 
@@ -23,11 +38,45 @@ PentrisField::PentrisField(const PentrisField& rhs)
     currentPentomino = rhs.currentPentomino;
     nextPentomino = rhs.nextPentomino;
     blocks = rhs.blocks;
+    rngState = rhs.rngState;
+    kernels = rhs.kernels;
+    wordsPerRow = rhs.wordsPerRow;
+    rowBits = rhs.rowBits;
+    interiorMask = rhs.interiorMask;
+    stackTop = rhs.stackTop;
+    lastInsertY = rhs.lastInsertY;
+    std::copy(rhs.lastInsertRowBlocks, rhs.lastInsertRowBlocks + PentrisFieldKernels::PENTOMINO_WIDTH, lastInsertRowBlocks);
+    clearedRows = rhs.clearedRows;
+    clearedErodedBlocks = rhs.clearedErodedBlocks;
+}
+
+/*Copy assignment (the pentomino constants are left untouched)*/
+PentrisField& PentrisField::operator=(const PentrisField& rhs)
+{
+    fieldWidth = rhs.Width();
+    fieldHeight = rhs.Height();
+    pentominoX = rhs.pentominoX;
+    pentominoY = rhs.pentominoY;
+    currentPentomino = rhs.currentPentomino;
+    nextPentomino = rhs.nextPentomino;
+    blocks = rhs.blocks;
+    rngState = rhs.rngState;
+    kernels = rhs.kernels;
+    wordsPerRow = rhs.wordsPerRow;
+    rowBits = rhs.rowBits;
+    interiorMask = rhs.interiorMask;
+    stackTop = rhs.stackTop;
+    lastInsertY = rhs.lastInsertY;
+    std::copy(rhs.lastInsertRowBlocks, rhs.lastInsertRowBlocks + PentrisFieldKernels::PENTOMINO_WIDTH, lastInsertRowBlocks);
+    clearedRows = rhs.clearedRows;
+    clearedErodedBlocks = rhs.clearedErodedBlocks;
+    return *this;
 }
 
 /*Resets the field to an empty state and generates a random next and current pentomino*/
 void PentrisField::Reset()
 {
+    kernels = SelectKernels(fieldWidth, fieldHeight);
     blocks.resize(fieldWidth * fieldHeight, 0);
     std::fill(blocks.begin(), blocks.end(), 0);
     for (int j = 0; j < fieldHeight; j++)
@@ -37,132 +86,303 @@ void PentrisField::Reset()
     }
     for (int i = 0; i < fieldWidth; i++)
         blocks[(fieldHeight - 1) * fieldWidth + i] = 13;
+    wordsPerRow = (fieldWidth + PentrisFieldKernels::BITS_PER_WORD - 1) / PentrisFieldKernels::BITS_PER_WORD;
+    rowBits.assign(wordsPerRow * fieldHeight, 0);
+    interiorMask.assign(wordsPerRow, 0);
+    for (int j = 0; j < fieldHeight; j++)
+        for (int i = 0; i < fieldWidth; i++)
+            if (blocks[i + j * fieldWidth] != 0)
+                SetRowBit(i, j, true);
+    for (int i = 1; i < fieldWidth - 1; i++)
+        interiorMask[i / PentrisFieldKernels::BITS_PER_WORD] |= std::uint64_t(1) << (i % PentrisFieldKernels::BITS_PER_WORD);
+    stackTop = fieldHeight - 1;
+    lastInsertY = -1;
+    std::fill(lastInsertRowBlocks, lastInsertRowBlocks + PentrisFieldKernels::PENTOMINO_WIDTH, 0);
+    clearedRows = 0;
+    clearedErodedBlocks = 0;
     currentPentomino = GetRandomPentomino();
     nextPentomino = GetRandomPentomino();
     pentominoX = fieldWidth / 2 - PENTOMINO_WIDTH / 2;
     pentominoY = 0;
 }
 
+/*Returns true if both fields hold the same blocks and the same current (with position) and next pentomino*/
+bool PentrisField::SamePosition(const PentrisField& rhs) const
+{
+    return (fieldWidth == rhs.fieldWidth) && (fieldHeight == rhs.fieldHeight) && (pentominoX == rhs.pentominoX) && (pentominoY == rhs.pentominoY)
+        && (currentPentomino == rhs.currentPentomino) && (nextPentomino == rhs.nextPentomino) && (rowBits == rhs.rowBits) && (blocks == rhs.blocks);
+}
+
+/*Returns a 64 bit hash of which blocks are occupied (the pentominos are not part of it)*/
+std::uint64_t PentrisField::Hash() const
+{
+    std::uint64_t hash = (std::uint64_t)fieldWidth << 32 | (std::uint64_t)fieldHeight;
+    for (const std::uint64_t word : rowBits)
+    {
+        hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+/*Returns the kernels specialised for width x height, or the runtime-sized ones if there is no specialisation*/
+const PentrisFieldKernelTable* PentrisField::SelectKernels(const int width, const int height)
+{
+    for (const auto& table : KERNEL_TABLES)
+        if (((table.width == width) && (table.height == height)) || (table.width == 0))
+            return &table;
+    return nullptr;
+}
+
+/*Reseeds the piece stream and resets the field - the same seed always yields the same sequence of pentominos*/
+void PentrisField::Reset(const std::uint32_t seed)
+{
+    Seed(seed);
+    Reset();
+}
+
+void PentrisField::Seed(const std::uint32_t seed)
+{
+    //xorshift has a fixed point at 0, hence avoid it
+    rngState = (seed != 0) ? seed : 0x9E3779B9u;
+}
+
 /*Sets each block to FILLEDROW if its corresponding row has no gaps
   This will only affect all rows from and including to the passed parameters
   The function returns the number of marked rows (that were not marked before!)*/
 int PentrisField::MarkFilledRows(const int fromRow, const int toRow)
 {
-    int lines = 0;
-    int from = std::max(fromRow, 0);
-    int to = std::min(toRow, fieldHeight -  2);
-    for (int j = from; j <= to; j++)
-    {
-        bool line = true;
-        for (int i = 0; i < fieldWidth; i++)
-        {
-            if ((blocks[i + j * fieldWidth] == 0) || (blocks[i + j * fieldWidth] == FILLEDROW))
-            {
-                line = false;
-                break;
-            }
-        }
-        if (line)
-        {
-            lines++;
-            for (int i = 1; i < fieldWidth - 1; i++) 
-                blocks[i + j * fieldWidth] = FILLEDROW;
-        }
-    }
-    return lines;
+    return kernels->markFilledRows(blocks.data(), fieldWidth, fieldHeight, fromRow, toRow, FILLEDROW);
 }
 
+/*Removes all rows marked as FILLEDROW, moving everything above them down. Only the rows between the stack top and
+  the removed row are moved (a whole row at a time), since everything above the stack top is empty*/
 int PentrisField::ClearFilledRows()
 {
     int filledRows = 0;
-    for (int i = 0; i < fieldHeight - 1; i++)
+    for (int i = stackTop; i < fieldHeight - 1; i++)
         if (blocks[1 + i * fieldWidth] == FILLEDROW)
         {
-            //Move everything above row i one row down
-            //REMARK: Potential for efficiency gains using STL
+            //Move the rows from the stack top to row i - 1 one row down (the walls are identical in every row)
             filledRows++;
-            for (int k = 1; k < fieldWidth - 1; k++) {
-                for (int j = i; j > 0; j--) {
-                    blocks[k + j * fieldWidth] = blocks[k + (j - 1) * fieldWidth];
-                    blocks[k + (j - 1) * fieldWidth] = 0;
-                }
-            }
+            std::memmove(&blocks[(stackTop + 1) * fieldWidth], &blocks[stackTop * fieldWidth], (i - stackTop) * fieldWidth * sizeof(int));
+            std::memmove(&rowBits[(stackTop + 1) * wordsPerRow], &rowBits[stackTop * wordsPerRow], (i - stackTop) * wordsPerRow * sizeof(std::uint64_t));
+            //The old stack top row is now empty
+            std::fill(blocks.begin() + stackTop * fieldWidth + 1, blocks.begin() + (stackTop + 1) * fieldWidth - 1, 0);
+            for (int k = 0; k < wordsPerRow; k++)
+                rowBits[stackTop * wordsPerRow + k] &= ~interiorMask[k];
+            stackTop++;
         }
+    UpdateStackTop();
     return filledRows;
 }
 
-std::vector<int> PentrisField::GetRandomPentomino() const
-{
-    int rnd = std::rand() % 12;
-    if (rnd == 0)
-        return PENTOMINO1;
-    else if (rnd == 1)
-        return PENTOMINO2;
-    else if (rnd == 2)
-        return PENTOMINO3;
-    else if (rnd == 3)
-        return PENTOMINO4;
-    else if (rnd == 4)
-        return PENTOMINO5;
-    else if (rnd == 5)
-        return PENTOMINO6;
-    else if (rnd == 6)
-        return PENTOMINO7;
-    else if (rnd == 7)
-        return PENTOMINO8;
-    else if (rnd == 8)
-        return PENTOMINO9;
-    else if (rnd == 9)
-        return PENTOMINO10;
-    else if (rnd == 10)
-        return PENTOMINO11;
+/*Removes the filled rows between fromRow and toRow right away (without marking them first), keeping them in undo.
+  Filled rows are found on the row bitsets, and the rows above each one are moved down a whole row at a time, like
+  ClearFilledRows does. The search uses this between plies, with UndoClearRows to restore the field afterwards.
+  Returns the number of removed rows*/
+int PentrisField::ClearRows(const int fromRow, const int toRow, RowClearUndo& undo)
+{
+    undo.count = 0;
+    undo.stackTop = stackTop;
+    undo.erodedBlocks = 0;
+    int lastInsertBlocks = 0;
+    for (int j = std::max(fromRow, stackTop); j <= std::min(toRow, fieldHeight - 2); j++)
+    {
+        bool filled = true;
+        for (int k = 0; filled && (k < wordsPerRow); k++)
+            filled = (rowBits[j * wordsPerRow + k] & interiorMask[k]) == interiorMask[k];
+        if (!filled)
+            continue;
+        if (undo.count == 0)
+        {
+            undo.blocks.resize(PentrisFieldKernels::PENTOMINO_WIDTH * fieldWidth);
+            undo.rowBits.resize(PentrisFieldKernels::PENTOMINO_WIDTH * wordsPerRow);
+        }
+        std::copy(blocks.begin() + j * fieldWidth, blocks.begin() + (j + 1) * fieldWidth, undo.blocks.begin() + undo.count * fieldWidth);
+        std::copy(rowBits.begin() + j * wordsPerRow, rowBits.begin() + (j + 1) * wordsPerRow, undo.rowBits.begin() + undo.count * wordsPerRow);
+        if ((lastInsertY >= 0) && (j >= lastInsertY) && (j < lastInsertY + PentrisFieldKernels::PENTOMINO_WIDTH))
+            lastInsertBlocks += lastInsertRowBlocks[j - lastInsertY];
+        //The same move as in ClearFilledRows
+        std::memmove(&blocks[(stackTop + 1) * fieldWidth], &blocks[stackTop * fieldWidth], (j - stackTop) * fieldWidth * sizeof(int));
+        std::memmove(&rowBits[(stackTop + 1) * wordsPerRow], &rowBits[stackTop * wordsPerRow], (j - stackTop) * wordsPerRow * sizeof(std::uint64_t));
+        std::fill(blocks.begin() + stackTop * fieldWidth + 1, blocks.begin() + (stackTop + 1) * fieldWidth - 1, 0);
+        for (int k = 0; k < wordsPerRow; k++)
+            rowBits[stackTop * wordsPerRow + k] &= ~interiorMask[k];
+        stackTop++;
+        undo.rows[undo.count++] = j;
+    }
+    if (undo.count == 0)
+        return 0;
+    UpdateStackTop();
+    undo.erodedBlocks = undo.count * lastInsertBlocks;
+    clearedRows += undo.count;
+    clearedErodedBlocks += undo.erodedBlocks;
+    return undo.count;
+}
+
+/*Puts back the rows removed by the matching ClearRows call (the field must not have changed in between)*/
+void PentrisField::UndoClearRows(const RowClearUndo& undo)
+{
+    if (undo.count == 0)
+        return;
+    //The removals are taken back in reverse: the i-th one had moved the rows from undo.stackTop + i to its row down by one
+    for (int i = undo.count - 1; i >= 0; i--)
+    {
+        const int top = undo.stackTop + i;
+        const int j = undo.rows[i];
+        std::memmove(&blocks[top * fieldWidth], &blocks[(top + 1) * fieldWidth], (j - top) * fieldWidth * sizeof(int));
+        std::memmove(&rowBits[top * wordsPerRow], &rowBits[(top + 1) * wordsPerRow], (j - top) * wordsPerRow * sizeof(std::uint64_t));
+        std::copy(undo.blocks.begin() + i * fieldWidth, undo.blocks.begin() + (i + 1) * fieldWidth, blocks.begin() + j * fieldWidth);
+        std::copy(undo.rowBits.begin() + i * wordsPerRow, undo.rowBits.begin() + (i + 1) * wordsPerRow, rowBits.begin() + j * wordsPerRow);
+    }
+    stackTop = undo.stackTop;
+    clearedRows -= undo.count;
+    clearedErodedBlocks -= undo.erodedBlocks;
+}
+
+void PentrisField::SetRowBit(const int posX, const int posY, const bool occupied)
+{
+    std::uint64_t& word = rowBits[posY * wordsPerRow + posX / PentrisFieldKernels::BITS_PER_WORD];
+    const std::uint64_t bit = std::uint64_t(1) << (posX % PentrisFieldKernels::BITS_PER_WORD);
+    if (occupied)
+        word |= bit;
     else
-        return PENTOMINO12;
+        word &= ~bit;
+}
+
+/*Returns true if row posY has no blocks between the walls*/
+bool PentrisField::IsRowEmpty(const int posY) const
+{
+    const std::uint64_t* row = RowBits(posY);
+    for (int k = 0; k < wordsPerRow; k++)
+        if (row[k] & interiorMask[k])
+            return false;
+    return true;
+}
+
+/*Moves the stack top down past rows that have become empty*/
+void PentrisField::UpdateStackTop()
+{
+    while ((stackTop < fieldHeight - 1) && IsRowEmpty(stackTop))
+        stackTop++;
+}
+
+/*Draws the next pentomino from the field's own (seedable) piece stream*/
+std::vector<int> PentrisField::GetRandomPentomino()
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return GetPentomino(rngState % 12 + 1);
+}
+
+/*Returns the pentomino identified by pentominoId (1-12) in its default orientation, or an empty vector if the id is invalid*/
+std::vector<int> PentrisField::GetPentomino(const int pentominoId) const
+{
+    switch (pentominoId)
+    {
+    case 1: return PENTOMINO1;
+    case 2: return PENTOMINO2;
+    case 3: return PENTOMINO3;
+    case 4: return PENTOMINO4;
+    case 5: return PENTOMINO5;
+    case 6: return PENTOMINO6;
+    case 7: return PENTOMINO7;
+    case 8: return PENTOMINO8;
+    case 9: return PENTOMINO9;
+    case 10: return PENTOMINO10;
+    case 11: return PENTOMINO11;
+    case 12: return PENTOMINO12;
+    default: return std::vector<int>();
+    }
+}
+
+/*Returns the pentomino identified by pentominoId in the given orientation (see Placement): reflected first if bit 2 is set,
+  then rotated clockwise (orientation & 3) times*/
+std::vector<int> PentrisField::OrientPentomino(const int pentominoId, const int orientation) const
+{
+    std::vector<int> pentomino = GetPentomino(pentominoId);
+    if (orientation & 4)
+        pentomino = ReflectPentomino(pentomino);
+    for (int rotate = 0; rotate < (orientation & 3); rotate++)
+        pentomino = RotatePentomino(pentomino);
+    return pentomino;
+}
+
+/*The centre block of each pentomino is invariant under rotations and reflections, hence it identifies the pentomino*/
+int PentrisField::PentominoId(const std::vector<int>& pentomino) const
+{
+    if (pentomino.size() < PENTOMINO_WIDTH * PENTOMINO_WIDTH)
+        return 0;
+    return pentomino[PENTOMINO_MID_INDEX];
+}
+
+/*Returns the smallest orientation index (0-7) under which the pentomino's default orientation equals the passed pentomino, or -1 if there is none*/
+int PentrisField::PentominoOrientation(const std::vector<int>& pentomino) const
+{
+    int pentominoId = PentominoId(pentomino);
+    for (int orientation = 0; orientation < 8; orientation++)
+        if (OrientPentomino(pentominoId, orientation) == pentomino)
+            return orientation;
+    return -1;
+}
+
+Placement PentrisField::CurrentPlacement() const
+{
+    Placement placement;
+    placement.pentominoId = PentominoId(currentPentomino);
+    placement.orientation = PentominoOrientation(currentPentomino);
+    placement.posX = pentominoX;
+    placement.posY = pentominoY;
+    return placement;
 }
 
 /*Inserts a given pentomino into the game field at the top left position posX and posY
   This will only insert into spaces that are empty, i.e. it will only overwrite the field where it is set to 0*/
-void PentrisField::InsertPentomino(const std::vector<int> pentomino, const int posX, const int posY)
+void PentrisField::InsertPentomino(const std::vector<int>& pentomino, const int posX, const int posY)
 {
     if (pentomino.size() < PENTOMINO_WIDTH * PENTOMINO_WIDTH)
         return;
+    lastInsertY = posY;
+    std::fill(lastInsertRowBlocks, lastInsertRowBlocks + PentrisFieldKernels::PENTOMINO_WIDTH, 0);
     for (int i = 0; i < PENTOMINO_WIDTH; i++)
         for (int j = 0; j < PENTOMINO_WIDTH; j++)
             if ((posX + i > 0) && (posX + i < fieldWidth - 1) && (posY + j >= 0) && (posY + j < fieldHeight - 1) && (pentomino[i + j * PENTOMINO_WIDTH] != 0))
+            {
                 blocks[posX + i + (posY + j) * fieldWidth] = pentomino[i + j * PENTOMINO_WIDTH];
+                SetRowBit(posX + i, posY + j, true);
+                stackTop = std::min(stackTop, posY + j);
+                lastInsertRowBlocks[j]++;
+            }
 }
 
 /*Removes a given pentomino from the game field at the top left position posX and posY
   This will only set blocks to zero whose number coincide with the passed pentomino*/
-void PentrisField::RemovePentomino(const std::vector<int> pentomino, const int posX, const int posY)
+void PentrisField::RemovePentomino(const std::vector<int>& pentomino, const int posX, const int posY)
 {
     if ((pentomino.size() < PENTOMINO_WIDTH * PENTOMINO_WIDTH))
         return;
     for (int i = 0; i < PENTOMINO_WIDTH; i++)
         for (int j = 0; j < PENTOMINO_WIDTH; j++)
             if ((posX + i > 0) && (posX + i < fieldWidth - 1) && (posY + j >= 0) && (posY + j < fieldHeight - 1) && (pentomino[i + j * PENTOMINO_WIDTH] == blocks[posX + i + (posY + j) * fieldWidth]))
+            {
                 blocks[posX + i + (posY + j) * fieldWidth] = 0;
+                SetRowBit(posX + i, posY + j, false);
+            }
+    UpdateStackTop();
 }
 
 /*Checks if the given pentomino fits into the game field at the top left position posX and posY*/
-bool PentrisField::DoesPentominoFit(const std::vector<int> pentomino, const int posX, const int posY) const
+bool PentrisField::DoesPentominoFit(const std::vector<int>& pentomino, const int posX, const int posY) const
 {
-    if ((pentomino.size() < PENTOMINO_WIDTH * PENTOMINO_WIDTH) || (posY > fieldHeight))
+    if (pentomino.size() < PENTOMINO_WIDTH * PENTOMINO_WIDTH)
         return false;
-    //i loops through the pentomino columns, j through rows
-    for (int i = 0; i < PENTOMINO_WIDTH; i++)
-        for (int j = 0; j < PENTOMINO_WIDTH; j++)
-        {
-            //Check if blocks at posX+i, posY+j is nonempty (if coordinates are in range) - if so, there is a collision and hence return false
-            if (((posX + i >= 0) && (posX + i < fieldWidth) && (posY + j >= 0) && (posY + j < fieldHeight) && (pentomino[i + j * PENTOMINO_WIDTH] != 0) && (blocks[posX + i + (posY + j) * fieldWidth] != 0))
-                || ((pentomino[i + j * PENTOMINO_WIDTH] != 0) && ((posX + i < 0) || (posX + i >= fieldWidth))))
-                return false;
-        }
-    return true;
+    return kernels->doesPentominoFit(blocks.data(), fieldWidth, fieldHeight, pentomino.data(), posX, posY);
 }
 
 /*Returns the leftmost column index for which there is a nonzero block in pentomino (between 0 and PENTOMINO_WIDTH; returns -1 if the pentomino is incorrectly sized or empty)*/
-int PentrisField::PentominoBoundLeft(const std::vector<int> pentomino) const
+int PentrisField::PentominoBoundLeft(const std::vector<int>& pentomino) const
 {
     if (pentomino.size() < PENTOMINO_WIDTH * PENTOMINO_WIDTH)
         return -1;
@@ -174,7 +394,7 @@ int PentrisField::PentominoBoundLeft(const std::vector<int> pentomino) const
 }
 
 /*Returns the rightmost column index for which there is a nonzero block in pentomino (between 0 and PENTOMINO_WIDTH; returns -1 if the pentomino is incorrectly sized or empty)*/
-int PentrisField::PentominoBoundRight(const std::vector<int> pentomino) const
+int PentrisField::PentominoBoundRight(const std::vector<int>& pentomino) const
 {
     if (pentomino.size() < PENTOMINO_WIDTH * PENTOMINO_WIDTH)
         return -1;
@@ -186,7 +406,7 @@ int PentrisField::PentominoBoundRight(const std::vector<int> pentomino) const
 }
 
 /*Returns the bottommost row index for which there is a nonzero block in pentomino (between 0 and PENTOMINO_WIDTH; returns -1 if the pentomino is incorrectly sized or empty)*/
-int PentrisField::PentominoBoundBottom(const std::vector<int> pentomino) const
+int PentrisField::PentominoBoundBottom(const std::vector<int>& pentomino) const
 {
     if (pentomino.size() < PENTOMINO_WIDTH * PENTOMINO_WIDTH)
         return -1;
@@ -198,7 +418,7 @@ int PentrisField::PentominoBoundBottom(const std::vector<int> pentomino) const
 }
 
 /*Rotates the given pentomino clockwise by 90 degrees, or returns the given pentomino if it is of insufficient size*/
-std::vector<int> PentrisField::RotatePentomino(const std::vector<int> pentomino) const
+std::vector<int> PentrisField::RotatePentomino(const std::vector<int>& pentomino) const
 {
     if (pentomino.size() < PENTOMINO_WIDTH * PENTOMINO_WIDTH)
         return pentomino;
@@ -211,7 +431,7 @@ std::vector<int> PentrisField::RotatePentomino(const std::vector<int> pentomino)
 }
 
 /*Reflects the given pentomino on its central vertical axis, or returns the given pentomino if it is of insufficient size*/
-std::vector<int> PentrisField::ReflectPentomino(const std::vector<int> pentomino) const
+std::vector<int> PentrisField::ReflectPentomino(const std::vector<int>& pentomino) const
 {
     if (pentomino.size() < PENTOMINO_WIDTH * PENTOMINO_WIDTH)
         return pentomino;
@@ -317,9 +537,14 @@ void PentrisField::InsertCurrentPentomino()
     pentominoY = 0;
 }
 
-int PentrisField::GetTerminalY(std::vector<int> pentomino, int posX, int posY) const
+int PentrisField::GetTerminalY(const std::vector<int>& pentomino, int posX, int posY) const
 {
     int terminalY = posY;
+    //Rows above the stack top hold nothing but the walls: if the pentomino fits with its bottom row just above the stack top,
+    //it fits at every height in between too, so it can skip straight there instead of stepping through the empty rows
+    int aboveStack = stackTop - 1 - PentominoBoundBottom(pentomino);
+    if ((aboveStack > terminalY) && DoesPentominoFit(pentomino, posX, aboveStack))
+        terminalY = aboveStack;
     while (DoesPentominoFit(pentomino, posX, terminalY + 1))
         terminalY++;
     return terminalY;
@@ -335,8 +560,13 @@ bool PentrisField::IsEmptyAbove(const int posX, const int posY) const
     if ((posX > fieldWidth - 1) || (posX < 1))
         return false;
     for (int j = std::min(fieldHeight - 1, posY) - 1; j > 0; j--)
+    {
+        //Rows above the stack top are empty apart from the walls
+        if ((j < stackTop) && (posX < fieldWidth - 1))
+            return true;
         if (blocks[posX + j * fieldWidth] != 0)
             return false;
+    }
     return true;
 }
 
@@ -371,8 +601,15 @@ const int& PentrisField::operator()(const unsigned posX, const unsigned posY) co
     return blocks[posX + posY * fieldWidth];
 }
 
-//Elementwise accessor
-int& PentrisField::operator()(const unsigned posX, const unsigned posY)
+/*Sets a single block, keeping the row bitsets and the stack top in sync*/
+void PentrisField::SetBlock(const unsigned posX, const unsigned posY, const int value)
 {
-    return blocks[posX + posY * fieldWidth];
+    blocks[posX + posY * fieldWidth] = value;
+    SetRowBit(posX, posY, value != 0);
+    if ((posX <= 0) || ((int)posX >= fieldWidth - 1) || ((int)posY >= fieldHeight - 1))
+        return;
+    if (value != 0)
+        stackTop = std::min(stackTop, (int)posY);
+    else if ((int)posY == stackTop)
+        UpdateStackTop();
 }
@@ -1,6 +1,27 @@
 #pragma once
 
 #include <vector>
+#include <cstdint>
+#include "PentrisFieldKernels.h"
+
+/*A terminal position of a pentomino: which pentomino (1-12), in which of its 8 orientations, and where (top left coordinates).
+  Orientation bit 2 denotes a reflection, bits 0-1 the number of clockwise rotations applied after the reflection*/
+struct Placement {
+    int pentominoId = 0;
+    int orientation = 0;
+    int posX = 0;
+    int posY = 0;
+};
+
+/*The rows removed by PentrisField::ClearRows, kept so that UndoClearRows can put them back*/
+struct RowClearUndo {
+    int count = 0;
+    int rows[PentrisFieldKernels::PENTOMINO_WIDTH] = {};
+    int stackTop = 0;
+    int erodedBlocks = 0;
+    std::vector<int> blocks;
+    std::vector<std::uint64_t> rowBits;
+};
 
 /*Encapsulates the width*height sized game field and each of the 12 possible pentominos.
 Contains method for game field and pentomino manipulation
@@ -12,8 +33,34 @@ private:
     int fieldWidth = 18;
     int fieldHeight = 35;
     //The field is stored as a vector of size field width * field height, accessed in 1d via field[x + y * FIELD_WIDTH]
+    //State of the xorshift generator for the piece stream. Seeding it makes the sequence of pentominos reproducible
+    std::uint32_t rngState = 0;
+    //Each row is mirrored as a bitset of wordsPerRow 64 bit words (bit i of a row is set iff block i is nonzero, walls included)
+    //so that whole rows can be tested, moved and scanned a word at a time
+    int wordsPerRow = 1;
+    std::vector<std::uint64_t> rowBits;
+    //The bits of the columns between the walls, per word
+    std::vector<std::uint64_t> interiorMask;
+    //High-water mark: the topmost row holding a block other than a wall (fieldHeight - 1 if the field is empty).
+    //Every row above it is known to be empty and is never scanned
+    int stackTop = 0;
+    //The most recently inserted pentomino: the row of its top left corner, and how many of its blocks landed in each of its rows.
+    //Lets an evaluation judge the placement that led to the field (landing height, eroded blocks) without being told which it was
+    int lastInsertY = -1;
+    int lastInsertRowBlocks[PentrisFieldKernels::PENTOMINO_WIDTH] = {};
+    //Rows removed by ClearRows that have not been put back, and the eroded blocks of the placements that completed them.
+    //Evaluations credit them, so that a search clearing rows between plies does not lose sight of the rows it cleared
+    int clearedRows = 0;
+    int clearedErodedBlocks = 0;
+    void SetRowBit(const int posX, const int posY, const bool occupied);
+    bool IsRowEmpty(const int posY) const;
+    void UpdateStackTop();
+    //The loop kernels specialised for this field's width and height (selected on Reset, i.e. once per game)
+    const PentrisFieldKernelTable* kernels = nullptr;
 
 public:
+    //Block values (pentomino ids, WALL, FILLEDROW). Read-only outside the class - writes have to go through the
+    //member functions (or SetBlock) so that the row bitsets and the stack top stay in sync
     std::vector<int> blocks;
 
     const int PENTOMINO_WIDTH = 5;
@@ -109,6 +156,13 @@ public:
 
     const int PENTOMINO_MID_INDEX = 12;
 
+    //The range of field sizes (walls and floor included) that fields read from files and streams may have. The smallest
+    //leaves a pentomino room between the walls and above the floor
+    static const int MIN_WIDTH = PentrisFieldKernels::PENTOMINO_WIDTH + 3;
+    static const int MIN_HEIGHT = PentrisFieldKernels::PENTOMINO_WIDTH + 2;
+    static const int MAX_WIDTH = 1024;
+    static const int MAX_HEIGHT = 4096;
+
     //The top left coordinates of the current pentomino
     int pentominoX = fieldWidth / 2 - PENTOMINO_WIDTH / 2;
     int pentominoY = 0;
@@ -120,18 +174,30 @@ public:
     PentrisField(const unsigned width, const unsigned height);
     PentrisField();
     PentrisField(const PentrisField& rhs);
+    PentrisField& operator=(const PentrisField& rhs);
     void Reset();
+    void Reset(const std::uint32_t seed);
+    void Seed(const std::uint32_t seed);
+    bool SamePosition(const PentrisField& rhs) const;
+    std::uint64_t Hash() const;
     int MarkFilledRows(const int fromRow, const int toRow);
     int ClearFilledRows();
-    void InsertPentomino(const std::vector<int> pentomino, const int posX, const int posY);
-    void RemovePentomino(const std::vector<int> pentomino, const int posX, const int posY);
-    bool DoesPentominoFit(const std::vector<int> pentomino, const int posX, const int posY) const;
-    int PentominoBoundLeft(const std::vector<int> pentomino) const;
-    int PentominoBoundRight(const std::vector<int> pentomino) const;
-    int PentominoBoundBottom(const std::vector<int> pentomino) const;
-    std::vector<int> GetRandomPentomino() const;
-    std::vector<int> RotatePentomino(const std::vector<int> pentomino) const;
-    std::vector<int> ReflectPentomino(const std::vector<int> pentomino) const;
+    int ClearRows(const int fromRow, const int toRow, RowClearUndo& undo);
+    void UndoClearRows(const RowClearUndo& undo);
+    void InsertPentomino(const std::vector<int>& pentomino, const int posX, const int posY);
+    void RemovePentomino(const std::vector<int>& pentomino, const int posX, const int posY);
+    bool DoesPentominoFit(const std::vector<int>& pentomino, const int posX, const int posY) const;
+    int PentominoBoundLeft(const std::vector<int>& pentomino) const;
+    int PentominoBoundRight(const std::vector<int>& pentomino) const;
+    int PentominoBoundBottom(const std::vector<int>& pentomino) const;
+    std::vector<int> GetRandomPentomino();
+    std::vector<int> GetPentomino(const int pentominoId) const;
+    std::vector<int> OrientPentomino(const int pentominoId, const int orientation) const;
+    int PentominoId(const std::vector<int>& pentomino) const;
+    int PentominoOrientation(const std::vector<int>& pentomino) const;
+    Placement CurrentPlacement() const;
+    std::vector<int> RotatePentomino(const std::vector<int>& pentomino) const;
+    std::vector<int> ReflectPentomino(const std::vector<int>& pentomino) const;
     bool RotateCurrentPentomino();
     bool ReflectCurrentPentomino();
     bool MoveLeftCurrentPentomino();
@@ -139,14 +205,26 @@ public:
     bool MoveDownCurrentPentomino();
     void InsertCurrentPentomino();
 
-    int GetTerminalY(std::vector<int> pentomino, int posX, int posY) const;
+    int GetTerminalY(const std::vector<int>& pentomino, int posX, int posY) const;
     int GetTerminalY() const;
     bool IsEmptyAbove(const int posX, const int posY) const;
     bool MinOverhangClearance(const int posX, const int posY, const int clearance) const;
 
+    static const PentrisFieldKernelTable* SelectKernels(const int width, const int height);
+
     int Width() const { return fieldWidth; };
     int Height() const { return fieldHeight; };
+    int WordsPerRow() const { return wordsPerRow; };
+    int StackTop() const { return stackTop; };
+    const std::uint64_t* RowBits(const int posY) const { return &rowBits[posY * wordsPerRow]; };
+    const std::uint64_t* InteriorMask() const { return interiorMask.data(); };
+    //See lastInsertY (-1 before the first insert)
+    int LastInsertY() const { return lastInsertY; };
+    const int* LastInsertRowBlocks() const { return lastInsertRowBlocks; };
+    //See clearedRows (0 unless a search is in progress on the field)
+    int ClearedRows() const { return clearedRows; };
+    int ClearedErodedBlocks() const { return clearedErodedBlocks; };
     const int& operator()(const unsigned posX, const unsigned posY) const;
-    int& operator()(const unsigned posX, const unsigned posY);
+    void SetBlock(const unsigned posX, const unsigned posY, const int value);
 };
 
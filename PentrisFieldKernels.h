@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/*The hot loops of PentrisField, written once as templates over the field dimensions.
+  Instantiated with W, H > 0 the bounds are compile-time constants, so the compiler can unroll the loops and fold the
+  index multiplies; instantiated with W = H = 0 the runtime width and height are used instead (for unusual sizes).
+  PentrisField picks the matching instantiation once, when the field is constructed*/
+namespace PentrisFieldKernels
+{
+    const int PENTOMINO_WIDTH = 5;
+    //Field rows are also kept as bitsets of this many bits per word
+    const int BITS_PER_WORD = 64;
+
+    inline int PopCount(const std::uint64_t word)
+    {
+#ifdef _MSC_VER
+        return (int)__popcnt64(word);
+#elif defined(__POPCNT__)
+        return __builtin_popcountll(word);
+#else
+        //Without the popcnt instruction the builtin is a library call; counting in parallel within the word is faster inline
+        std::uint64_t x = word - ((word >> 1) & 0x5555555555555555ull);
+        x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+        x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+        return (int)((x * 0x0101010101010101ull) >> 56);
+#endif
+    }
+
+    //Index of the lowest set bit; word must be nonzero
+    inline int LowestBit(const std::uint64_t word)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, word);
+        return (int)index;
+#else
+        return __builtin_ctzll(word);
+#endif
+    }
+
+    /*See PentrisField::DoesPentominoFit*/
+    template<int W, int H>
+    bool DoesPentominoFit(const int* blocks, const int width, const int height, const int* pentomino, const int posX, const int posY)
+    {
+        const int w = (W > 0) ? W : width;
+        const int h = (H > 0) ? H : height;
+        if (posY > h)
+            return false;
+        for (int j = 0; j < PENTOMINO_WIDTH; j++)
+            for (int i = 0; i < PENTOMINO_WIDTH; i++)
+            {
+                if (pentomino[i + j * PENTOMINO_WIDTH] == 0)
+                    continue;
+                const int x = posX + i;
+                const int y = posY + j;
+                if ((x < 0) || (x >= w))
+                    return false;
+                if ((y >= 0) && (y < h) && (blocks[x + y * w] != 0))
+                    return false;
+            }
+        return true;
+    }
+
+    /*See PentrisField::MarkFilledRows*/
+    template<int W, int H>
+    int MarkFilledRows(int* blocks, const int width, const int height, const int fromRow, const int toRow, const int filledRow)
+    {
+        const int w = (W > 0) ? W : width;
+        const int h = (H > 0) ? H : height;
+        int lines = 0;
+        const int from = (fromRow > 0) ? fromRow : 0;
+        const int to = (toRow < h - 2) ? toRow : h - 2;
+        for (int j = from; j <= to; j++)
+        {
+            int* row = blocks + j * w;
+            bool line = true;
+            for (int i = 0; i < w; i++)
+                if ((row[i] == 0) || (row[i] == filledRow))
+                {
+                    line = false;
+                    break;
+                }
+            if (line)
+            {
+                lines++;
+                for (int i = 1; i < w - 1; i++)
+                    row[i] = filledRow;
+            }
+        }
+        return lines;
+    }
+}
+
+/*The kernels matching one field size*/
+struct PentrisFieldKernelTable {
+    //0 for the runtime-sized fallback
+    int width;
+    int height;
+    bool (*doesPentominoFit)(const int* blocks, const int width, const int height, const int* pentomino, const int posX, const int posY);
+    int (*markFilledRows)(int* blocks, const int width, const int height, const int fromRow, const int toRow, const int filledRow);
+};
@@ -57,21 +57,68 @@ void PentrisGame::UserInputHandling(float fElapsedTime)
     }
     if (GetKey(olc::Key::ENTER).bPressed)
         NewGame();
+    if (GetKey(olc::Key::L).bPressed)
+        ToggleLinearEvaluator();
+    if (GetKey(olc::Key::M).bPressed)
+        ToggleMCTS();
+    if (GetKey(olc::Key::R).bPressed)
+    {
+        //Toggle replay recording; the current game is only recorded from the next new game onwards
+        if (recorder.IsOpen())
+            recorder.Close();
+        else
+            recorder.Open(REPLAY_PATH);
+    }
+    if (GetKey(olc::Key::G).bPressed)
+    {
+        //Toggle the event log
+        if (logger.IsOpen())
+            logger.Close();
+        else
+            logger.Open(LOG_PATH);
+    }
+    if (GetKey(olc::Key::N).bPressed)
+    {
+        //Toggle the spectator stream
+        if (stream.IsOpen())
+            stream.Close();
+        else if (!stream.ListenTCP(STREAM_PORT))
+            std::cout << "Could not open the spectator stream on port " << STREAM_PORT << std::endl;
+    }
+    if (GetKey(olc::Key::X).bPressed)
+        ToggleGrid();
+    if (GetKey(olc::Key::Y).bPressed)
+        ToggleCooperativeAI();
+    if (GetKey(olc::Key::F).bPressed)
+        ToggleMaxGravity();
+    if (GetKey(olc::Key::H).bPressed)
+    {
+        advisorOn = !advisorOn;
+        advisor.Reset();
+    }
+    if (GetKey(olc::Key::S).bPressed)
+    {
+        //Cycle the number of background stars: 500, 5000, ... up to 500000, then none
+        SetStarCount((starCount == 0) ? 500 : (starCount >= 500000) ? 0 : starCount * 10);
+    }
+    if (GetKey(olc::Key::T).bPressed)
+    {
+        //Cycle the time scale: 1x, 10x, 100x, uncapped
+        timeScale = (timeScale == 0) ? 1 : (timeScale == 100) ? 0 : timeScale * 10;
+        tickAccumulator = 0.0f;
+    }
     if (GetKey(olc::Key::E).bPressed)
-        std::cout << pentrisAI.EvaluateField(pentrisField);
+        logger.Log(LogEventType::DIAGNOSTIC, { pentrisAI.EvaluateField(pentrisField) }, "eval");
     if (GetKey(olc::Key::A).bPressed)
     {
         aiLoop = !aiLoop;
-        if (aiLoop) {
-            pentrisAI.CalculateMoveSequence(pentrisField, 0);
-            aiCalcStarted = timeElapsed;
-            pentrisAI.bestMoveSequence = pentrisAI.bestMoveSequence;
-        }
+        if (aiLoop)
+            StartAICalculation(0);
     }
     if (GetKey(olc::Key::P).bPressed)
     {
         //Speed up AI
-        aiMoveAfterSeconds = std::min(0.0f, aiMoveAfterSeconds - 0.01f);
+        aiMoveAfterSeconds = std::max(0.0f, aiMoveAfterSeconds - 0.01f);
     }
     if (GetKey(olc::Key::O).bPressed)
     {
@@ -80,28 +127,25 @@ void PentrisGame::UserInputHandling(float fElapsedTime)
     }
     if (GetKey(olc::Key::D).bPressed)
     {
-        pentrisAI.CalculateMoveSequence(pentrisField, 0);
-        while (!pentrisAI.AIThreadJoined());
-        for (auto &move : pentrisAI.bestMoveSequence) {
-            if (move.moveType == MoveType::REFLECT) std::cout << "Reflect, ";
-            else if (move.moveType == MoveType::ROTATE) std::cout << "Rotate " << move.destination << ", ";
-            else if (move.moveType == MoveType::LEFT) std::cout << "Left " << move.destination << ", ";
-            else if (move.moveType == MoveType::RIGHT) std::cout << "Right " << move.destination << ", ";
-            else if (move.moveType == MoveType::DOWN) std::cout << "Down " << move.destination << ", ";
-            else if (move.moveType == MoveType::HARD_DROP) std::cout << "Drop!";
-            std::cout << std::endl;
-        }
-        std::cout << pentrisAI.evalCalls << std::endl;
+        StartAICalculation(0);
+        while (!pentrisAI.AIThreadJoined())
+            pentrisAI.StepSearch(0);
+        logger.Log(LogEventType::DIAGNOSTIC, {}, ("moves " + PentrisAI::MoveSequenceText(pentrisAI.bestMoveSequence)).c_str());
+        SearchStats stats = pentrisAI.LastStats();
+        logger.Log(LogEventType::DIAGNOSTIC, { stats.nodesPerDepth[0], stats.nodesPerDepth[1], stats.leavesEvaluated, stats.duplicatesSkipped,
+            (std::int64_t)(stats.wallTimeMs * 1000), stats.bestEval }, stats.interrupted ? "nodes leaves dups us eval (interrupted)" : "nodes leaves dups us eval");
     }
     if (GetKey(olc::Key::B).bPressed)
-        std::cout << pentrisField.PentominoBoundLeft(pentrisField.currentPentomino) << ", " << pentrisField.PentominoBoundRight(pentrisField.currentPentomino) << ", " << pentrisField.PentominoBoundBottom(pentrisField.currentPentomino) << std::endl;
+        logger.Log(LogEventType::DIAGNOSTIC, { pentrisField.PentominoBoundLeft(pentrisField.currentPentomino), pentrisField.PentominoBoundRight(pentrisField.currentPentomino),
+            pentrisField.PentominoBoundBottom(pentrisField.currentPentomino) }, "bounds");
 }
 
 /*Handles the execution "input" supplied by the Pentris AI.
   Three main branches:
-  - The AI is still calculating; hence only check if the threshhold is reached and force an interrupt
-  - The AI is supposed to play and has finished calculating; hence execute the current move within
-    the best found move sequence and then pop it out of the bestMoveSequence vector
+  - The AI is still calculating; hence check if the threshhold is reached and force an interrupt. If gravity is about to
+    lock the pentomino in the meantime, steer it towards the best placement the search has published so far
+  - The AI is supposed to play and has finished calculating; hence plan the inputs for its chosen placement (once)
+    and execute the step at the plan cursor
   - The AI is supposed to play but the game is over, hence restart a new game*/
 void PentrisGame::AIInputHandling(float fElapsedTime)
 {
@@ -112,69 +156,146 @@ void PentrisGame::AIInputHandling(float fElapsedTime)
         //If so, force interrupt if time threshold is reached
         if (timeElapsed - aiCalcStarted > aiCalcCutoff)
             pentrisAI.interrupt = true;
+        //The pentomino will lock within a row: act on the best placement so far instead of waiting for the search.
+        //The plan stays pending, so the final result is still planned once the search completes
+        else if (aiLoop && !aiSearchAhead && (terminalY - pentrisField.pentominoY <= 1))
+        {
+            BestMove best = pentrisAI.CurrentBest();
+            if (best.found && ((best.placement.posX != aiTarget.posX) || (best.placement.posY != aiTarget.posY) ||
+                (best.placement.pentominoId != aiTarget.pentominoId) || (best.placement.orientation != aiTarget.orientation)))
+            {
+                aiTarget = best.placement;
+                PlanToAITarget();
+            }
+            if ((aiPlanCursor < aiPlanLength) && (aiMoveTimer <= 0))
+            {
+                ExecuteAIPlanStep();
+                aiMoveTimer = std::min(aiMoveAfterSeconds, FallSeconds() - 0.02f);
+            }
+        }
+    }
+    else if ((aiLoop) && (gameOver))
+    {
+        NewGame();
+        StartAICalculation();
     }
-    else if ((aiLoop) && (!pentrisAI.bestMoveSequence.empty()) && pentrisField.DoesPentominoFit(pentrisField.currentPentomino, pentrisField.pentominoX, pentrisField.pentominoY) && (aiMoveTimer <= 0))
+    else if ((aiLoop) && pentrisField.DoesPentominoFit(pentrisField.currentPentomino, pentrisField.pentominoX, pentrisField.pentominoY))
     {
-        //If the thread is not calculating, the AI is supposed to play (aiLoop == true), the current pentomino fits and there are moves to execute -
-        //then execute the move currently in line. This can only occur if aiMoveTimer <= 0, ie. every aiMoveAfterSeconds
-        MoveData move = *pentrisAI.bestMoveSequence.begin();
-        if (move.moveType == MoveType::HARD_DROP)
+        if (aiPlanPending && !aiSearchAhead)
+            PlanAIMove();
+        //Execute the step currently in line. This can only occur if aiMoveTimer <= 0, ie. every aiMoveAfterSeconds
+        if ((aiPlanCursor < aiPlanLength) && (aiMoveTimer <= 0))
         {
-            //Force the current piece down
-            pentrisField.pentominoY = terminalY;
-            fallTimer = 0;
-            pentrisAI.bestMoveSequence.erase(pentrisAI.bestMoveSequence.begin());
+            ExecuteAIPlanStep();
+            aiMoveTimer = std::min(aiMoveAfterSeconds, FallSeconds() - 0.02f);
         }
+    }
+}
+
+/*Starts the AI's search on the current field; its result is turned into a plan once the search has finished (and once filled rows have been cleared)*/
+void PentrisGame::StartAICalculation(unsigned char maxDepth)
+{
+    aiPlanLength = 0;
+    aiPlanCursor = 0;
+    aiPlanPending = true;
+    aiTarget = Placement();
+    //While filled rows are flashing, search the field they leave behind rather than searching again once they are gone
+    aiSearchAhead = (clearTimer != std::numeric_limits<float>::max());
+    if (aiSearchAhead)
+    {
+        PentrisField clearedField = pentrisField;
+        clearedField.ClearFilledRows();
+        pentrisAI.CalculateMoveSequence(clearedField, maxDepth);
+    }
+    else
+        pentrisAI.CalculateMoveSequence(pentrisField, maxDepth);
+    aiCalcStarted = timeElapsed;
+}
+
+/*Plans the shortest input sequence from the pentomino's current position to the AI's chosen placement*/
+void PentrisGame::PlanAIMove()
+{
+    aiPlanPending = false;
+    if (maxGravity)
+        aiLatencies.Record(pentrisAI.LastStats());
+    aiTarget = pentrisAI.CurrentBest().placement;
+    //While the plan is being executed, let the AI already search the next pentomino's move on the predicted field
+    if (PlanToAITarget())
+        pentrisAI.Speculate(pentrisField, aiTarget);
+}
+
+/*Plans the inputs from the pentomino's current position to aiTarget. If the planner cannot reach it (gravity has already
+  taken the pentomino below the target row, or past the way to it), the plan falls back to a hard drop where the pentomino
+  is, so that the AI never waits for a plan that will not come. Returns false if it had to fall back*/
+bool PentrisGame::PlanToAITarget()
+{
+    aiPlanLength = planner.Plan(pentrisField, aiTarget, aiPlan.data());
+    aiPlanCursor = 0;
+    if (aiPlanLength > 0)
+        return true;
+    aiPlan[0] = MoveData(MoveType::HARD_DROP, pentrisField.pentominoX);
+    aiPlanLength = 1;
+    return false;
+}
+
+/*Executes the step at the plan cursor. Steps whose destination has already been reached are skipped, so that each call
+  performs an input. If an input is blocked (e.g. gravity moved the pentomino next to an obstacle), the rest of the plan
+  is recomputed from the current position*/
+void PentrisGame::ExecuteAIPlanStep()
+{
+    while (aiPlanCursor < aiPlanLength)
+    {
+        const MoveData& move = aiPlan[aiPlanCursor];
+        bool blocked = false;
         if (move.moveType == MoveType::LEFT)
         {
-            if (pentrisField.pentominoX <= move.destination) //No move to execute, the pentomino is at or ahead of destination
-                pentrisAI.bestMoveSequence.erase(pentrisAI.bestMoveSequence.begin());
-            else {
-                if (!pentrisField.MoveLeftCurrentPentomino()) //Move pentomino left; if impossible,
-                    pentrisAI.bestMoveSequence.begin()->destination++; //increase the destination of the current move
+            if (pentrisField.pentominoX <= move.destination)
+            {
+                aiPlanCursor++;
+                continue;
             }
+            blocked = !pentrisField.MoveLeftCurrentPentomino();
         }
-        if (move.moveType == MoveType::RIGHT)
+        else if (move.moveType == MoveType::RIGHT)
         {
-            if (pentrisField.pentominoX >= move.destination) //see above
-                pentrisAI.bestMoveSequence.erase(pentrisAI.bestMoveSequence.begin());
-            else {
-                if (!pentrisField.MoveRightCurrentPentomino())
-                    pentrisAI.bestMoveSequence.begin()->destination--;
+            if (pentrisField.pentominoX >= move.destination)
+            {
+                aiPlanCursor++;
+                continue;
             }
+            blocked = !pentrisField.MoveRightCurrentPentomino();
         }
-        if (move.moveType == MoveType::DOWN)
+        else if (move.moveType == MoveType::DOWN)
         {
             if (pentrisField.pentominoY >= move.destination)
-                pentrisAI.bestMoveSequence.erase(pentrisAI.bestMoveSequence.begin());
-            else
-                fallTimer = -1.0f; //force the pentomino down
-        }
-        if (move.moveType == MoveType::ROTATE)
-        {
-            if (move.destination <= 0)
-                pentrisAI.bestMoveSequence.erase(pentrisAI.bestMoveSequence.begin());
-            else
             {
-                pentrisField.RotateCurrentPentomino();
-                pentrisAI.bestMoveSequence.begin()->destination--;
+                aiPlanCursor++;
+                continue;
             }
+            fallTimer = -1.0f; //force the pentomino down
         }
-        if (move.moveType == MoveType::REFLECT)
+        else if (move.moveType == MoveType::ROTATE)
         {
-            pentrisAI.bestMoveSequence.erase(pentrisAI.bestMoveSequence.begin());
-            pentrisField.ReflectCurrentPentomino();
+            for (int rotation = 0; rotation < move.destination; rotation++)
+                blocked = blocked || !pentrisField.RotateCurrentPentomino();
+            aiPlanCursor++;
         }
-        aiMoveTimer = std::min(aiMoveAfterSeconds, fallAfterSeconds - 0.02f);
-    }
-    else if ((aiLoop) && (gameOver))
-    {
-        NewGame();
-        pentrisAI.CalculateMoveSequence(pentrisField);
-        aiCalcStarted = timeElapsed;
-        pentrisAI.bestMoveSequence = pentrisAI.bestMoveSequence;
+        else if (move.moveType == MoveType::REFLECT)
+        {
+            blocked = !pentrisField.ReflectCurrentPentomino();
+            aiPlanCursor++;
+        }
+        else if (move.moveType == MoveType::HARD_DROP)
+        {
+            //Force the current piece down
+            pentrisField.pentominoY = terminalY;
+            fallTimer = 0;
+            aiPlanCursor++;
+        }
+        if (blocked)
+            PlanToAITarget();
+        return;
     }
-        
 }
 
 /* The main game logic method
@@ -191,7 +312,12 @@ void PentrisGame::PentominoMovementHandling(float fElapsedTime)
     {
         scoreCumulative += score;
         linesFilledCumulative += linesFilled;
+        logger.Log(LogEventType::GAME_OVER, { games, pieceCount - 1, linesFilled, score });
+        if (maxGravity)
+            logger.Log(LogEventType::LATENCY, { games, aiLatencies.Decisions(), aiLatencies.DeadlineMisses(), (std::int64_t)aiLatencies.Percentile(0.5),
+                (std::int64_t)aiLatencies.Percentile(0.99), (std::int64_t)aiLatencies.Percentile(1.0) });
         games++;
+        recorder.EndGame(score, linesFilled, pieceCount - 1);
     }
     gameOver = gameOverFrame;
 
@@ -200,13 +326,17 @@ void PentrisGame::PentominoMovementHandling(float fElapsedTime)
     bool recalculateAImove = false;
     if ((fallTimer <= 0) && (!gameOver))
     {
-        fallTimer = fallAfterSeconds;
+        fallTimer = FallSeconds();
         //Move down the current pentomino. if MoveDownCurrentPentomino returns false, it is at the field end..
         if (!pentrisField.MoveDownCurrentPentomino())
         {
             //Hence insert - the method will cycle to the next pentomino
+            const Placement placement = pentrisField.CurrentPlacement();
+            recorder.RecordPlacement(placement);
+            logger.Log(LogEventType::PLACEMENT, { games, pieceCount, placement.pentominoId, placement.orientation, placement.posX, placement.posY });
             pentrisField.InsertCurrentPentomino();
             pieceCount++;
+            logger.Log(LogEventType::SPAWN, { games, pieceCount, pentrisField.PentominoId(pentrisField.currentPentomino), pentrisField.PentominoId(pentrisField.nextPentomino) });
 
             if (pieceCount % 2 == 0)
                 if (fallAfterSeconds >= 0.05)
@@ -216,13 +346,15 @@ void PentrisGame::PentominoMovementHandling(float fElapsedTime)
             int newLinesFilled = pentrisField.MarkFilledRows(terminalY, terminalY + pentrisField.PENTOMINO_WIDTH - 1);
             if (newLinesFilled > 0) {
                 //If clearTimer <= clearLinesAfterSeconds, then previously cleared lines are currently "flashing", 
-                if (clearTimer <= clearLinesAfterSeconds)
-                    //hence make sure that they will be destroyed them in this frame (to clear up the field for fast players!)
+                //hence make sure that they will be destroyed them in this frame (to clear up the field for fast players!).
+                //Under maximum gravity the next pentomino would land before the flashing ends, so rows never flash
+                if ((clearTimer <= clearLinesAfterSeconds) || maxGravity)
                     clearTimer = 0.0f;
                 else
                     clearTimer = clearLinesAfterSeconds;
                 linesFilled += newLinesFilled;
                 score += (1 << newLinesFilled) * 100;
+                logger.Log(LogEventType::LINE_CLEAR, { games, pieceCount - 1, newLinesFilled, linesFilled, score });
             }
 
             terminalY = pentrisField.GetTerminalY();
@@ -236,38 +368,95 @@ void PentrisGame::PentominoMovementHandling(float fElapsedTime)
     {
         //The flashing effect is supposed to end if clearTimer reaches 0 and filled lines are supposed to be removed
         pentrisField.ClearFilledRows();
+        recorder.RecordClear();
         clearTimer = std::numeric_limits<float>::max();
-        //The field topology has changed, hence AI needs to recalculate its move
-        recalculateAImove = true;
+        //The field topology has changed, hence AI needs to recalculate its move - unless it already searched the cleared field
+        recalculateAImove = recalculateAImove || !aiSearchAhead;
+        aiSearchAhead = false;
     }
     if ((aiLoop) && (recalculateAImove))
     {
         while (!pentrisAI.AIThreadJoined()) //If the AI is currently calculating its move, then interrupt and wait for it to finish
             pentrisAI.interrupt = true;
         //Calculate new move
-        pentrisAI.CalculateMoveSequence(pentrisField);
-        aiCalcStarted = timeElapsed;
+        StartAICalculation();
     }
 }
 
-/*Update and draw the background star effect*/
-void PentrisGame::DrawStars(float fElapsedTime)
+/*Runs the ticks owed for this frame: fElapsedTime times the time scale, or as many as fit into the frame budget if
+  uncapped. Faster than real time, the clock stops while the AI is searching - otherwise gravity would outrun the search
+  and the AI would play worse the faster the game runs - so a fast-forwarded game plays like one at normal speed*/
+void PentrisGame::SimulationHandling(float fElapsedTime)
 {
-    for (auto& star : stars)
-    {
-        star.distance += star.speed * fElapsedTime * (star.distance / 100.0f);
-        if (star.distance > 800.0f) {
-            star.angle = Random(0.0f, 2.0f * 3.1459f);
-            star.speed = Random(10.0f, 100.0f);
-            star.distance = Random(20.0f, 200.0f);
-            float lum = Random(0.3f, 1.0f);
-            star.col = olc::PixelF(lum, lum, lum, 1.0f);
+    const auto frameStarted = std::chrono::steady_clock::now();
+    tickCountTimer += fElapsedTime;
+    if (tickCountTimer >= 1.0f)
+    {
+        ticksPerSecond = ticksCounted;
+        ticksCounted = 0;
+        tickCountTimer = 0.0f;
+    }
+    tickAccumulator += fElapsedTime * timeScale;
+    while ((timeScale == 0) || (tickAccumulator >= TICK_SECONDS))
+    {
+        const auto OverBudget = [&] { return std::chrono::duration<float>(std::chrono::steady_clock::now() - frameStarted).count() > FRAME_BUDGET_SECONDS; };
+        bool waitedOut = false;
+        if ((timeScale != 1) && aiLoop)
+            while (!pentrisAI.AIThreadJoined() && !(waitedOut = OverBudget()))
+            {
+                //A cooperative search only advances while it is being stepped
+                if (aiCooperative)
+                    pentrisAI.StepSearch(0, AI_SLICE_MICROSECONDS);
+                else
+                    std::this_thread::yield();
+            }
+        if (!waitedOut)
+        {
+            Tick();
+            tickAccumulator -= TICK_SECONDS;
+        }
+        //The time that did not fit into the budget is dropped rather than caught up with
+        if (waitedOut || OverBudget())
+        {
+            tickAccumulator = 0.0f;
+            break;
         }
-        Draw(olc::vf2d(cos(star.angle), sin(star.angle)) * star.distance + origin, star.col * (star.distance / 100.0f));
-        FillCircle(olc::vf2d(cos(star.angle), sin(star.angle)) * star.distance + origin, 1, star.col * (star.distance / 100.0f));
     }
 }
 
+/*Advances the game by one fixed step of TICK_SECONDS*/
+void PentrisGame::Tick()
+{
+    terminalY = pentrisField.GetTerminalY();
+    AIInputHandling(TICK_SECONDS);
+    PentominoMovementHandling(TICK_SECONDS);
+    timeElapsed += TICK_SECONDS;
+    ticksCounted++;
+}
+
+/*Gives the advisor its slice of the frame, on the position the player sees: while filled rows are flashing, it thinks
+  ahead on the field they leave behind (as the AI does), and its recommendation is shown once they are gone*/
+void PentrisGame::AdvisorHandling()
+{
+    if (!advisorOn || aiLoop || gameOver)
+        return;
+    if (clearTimer != std::numeric_limits<float>::max())
+    {
+        PentrisField clearedField = pentrisField;
+        clearedField.ClearFilledRows();
+        advisor.Update(clearedField);
+    }
+    else
+        advisor.Update(pentrisField);
+}
+
+/*Update and draw the background star effect*/
+void PentrisGame::DrawStars(float fElapsedTime)
+{
+    stars.Update(fElapsedTime);
+    stars.Draw(GetDrawTarget(), origin);
+}
+
 /*Draws the game field, the current and next pentomino, the strings on the sidebar, and the background star effect*/
 void PentrisGame::DrawHandling(float fElapsedTime)
 {
@@ -277,6 +466,12 @@ void PentrisGame::DrawHandling(float fElapsedTime)
     FillCircle(X_OFFSET + (pentrisField.pentominoX + pentrisField.PENTOMINO_WIDTH / 2) * PIXELS_PER_UNIT + PIXELS_PER_UNIT / 2, 10, 5, olc::WHITE);
     //Draw "Shadow" of the current pentomino at the target destination
     DrawPentomino(pentrisField.currentPentomino, pentrisField.pentominoX, terminalY, false, olc::VERY_DARK_GREY);
+    //Draw the advisor's recommendation as a second shadow
+    if (advisorOn && !aiLoop && !gameOver && advisor.HasAdvice() && (clearTimer == std::numeric_limits<float>::max()))
+    {
+        const Placement& advice = advisor.Advice();
+        DrawPentomino(pentrisField.OrientPentomino(advice.pentominoId, advice.orientation), advice.posX, advice.posY, false, olc::Pixel(0, 96, 96));
+    }
     DrawPentomino(pentrisField.currentPentomino, pentrisField.pentominoX, pentrisField.pentominoY, true, 0);
     DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 40, "NEXT");
     DrawPentomino(pentrisField.nextPentomino, pentrisField.Width() + 1, 2, true, 0);
@@ -285,6 +480,9 @@ void PentrisGame::DrawHandling(float fElapsedTime)
     DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 280, "Games: " + std::to_string(games));
     if (games > 0)
         DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 300, "Avg lines per game: " + std::to_string(linesFilledCumulative / games));
+    if (maxGravity)
+        DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 320, "Missed: " + std::to_string(aiLatencies.DeadlineMisses()) + "/" +
+            std::to_string(aiLatencies.Decisions()) + "  p99: " + std::to_string((int)aiLatencies.Percentile(0.99)) + " us");
     if (gameOver)
         DrawString(X_OFFSET + (pentrisField.Width() / 2 - 2) * PIXELS_PER_UNIT, (pentrisField.Height() / 2) * PIXELS_PER_UNIT, "GAME OVER", olc::WHITE, 2);
     DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 340, "CONTROLS");
@@ -293,9 +491,217 @@ void PentrisGame::DrawHandling(float fElapsedTime)
     DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 400, "V: Reflect");
     DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 420, "Space: Drop");
     DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 440, "Enter: New Game");
+    DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 460, "S: Stars (" + std::to_string(starCount) + ")");
     DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 480, "A: Let the machine play");
     DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 500, "  O: Slow down");
     DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 520, "  P: Speed up");
+    DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 560, recorder.IsOpen() ? "R: Stop recording (REC)" : "R: Record replays");
+    DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 580, useLinearEvaluator ? "L: Heuristic evaluator" : "L: Trained evaluator");
+    DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 600, pentrisAI.MCTSEnabled() ? "M: Exhaustive search" : "M: Monte Carlo search");
+    DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 620, logger.IsOpen() ? "G: Stop event log (LOG)" : "G: Log events");
+    DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 640, stream.IsOpen() ?
+        "N: Stop streaming (" + std::to_string(stream.Spectators()) + " watching)" : "N: Stream to spectators");
+    DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 660, "X: Grid of AI games");
+    DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 680, "T: Time " + ((timeScale == 0) ? std::string("uncapped") : "x" + std::to_string(timeScale)) +
+        " (" + std::to_string(ticksPerSecond) + " ticks/s)");
+    DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 700, aiCooperative ? "Y: AI on its own thread" : "Y: AI on the game thread");
+    DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 540, advisorOn ?
+        "H: Hide hints (" + std::to_string((int)advisor.LastUpdateMicroseconds()) + " us)" : "H: Show hints");
+    DrawString(X_OFFSET + pentrisField.Width() * PIXELS_PER_UNIT + 20, 720, maxGravity ? "F: Normal gravity" :
+        "F: Max gravity (" + std::to_string(aiDeadlineMicroseconds) + " us deadline)");
+}
+
+/*Hands the current state to the spectator stream, which sends only what changed since the previous frame*/
+void PentrisGame::PublishStreamFrame()
+{
+    streamFrame.Capture(pentrisField);
+    streamFrame.score = score;
+    streamFrame.lines = linesFilled;
+    streamFrame.games = games;
+    streamFrame.aiTarget = aiLoop ? aiTarget : Placement();
+    streamFrame.gameOver = gameOver;
+    stream.Publish(streamFrame);
+}
+
+/*Switches the AI between its built-in heuristic and the trained linear evaluator (if its weights file fits the field)*/
+void PentrisGame::ToggleLinearEvaluator()
+{
+    if (!useLinearEvaluator)
+    {
+        if (!linearEvaluator || (linearEvaluator->Width() != pentrisField.Width()) || (linearEvaluator->Height() != pentrisField.Height()))
+        {
+            linearEvaluator = std::make_shared<PentrisLinearEvaluator>(pentrisField.Width(), pentrisField.Height());
+            if (!linearEvaluator->Load(WEIGHTS_PATH))
+            {
+                std::cout << "Could not load " << WEIGHTS_PATH << " for a " << pentrisField.Width() << "x" << pentrisField.Height() << " field" << std::endl;
+                linearEvaluator = nullptr;
+                return;
+            }
+        }
+    }
+    useLinearEvaluator = !useLinearEvaluator;
+    //The evaluator must not change under a running search
+    while (!pentrisAI.AIThreadJoined())
+        pentrisAI.interrupt = true;
+    pentrisAI.CancelSpeculation();
+    if (useLinearEvaluator)
+    {
+        pentrisAI.SetEvaluator(linearEvaluator);
+        advisor.SetEvaluator(linearEvaluator);
+    }
+    else
+    {
+        pentrisAI.SetEvaluator(nullptr);
+        advisor.SetEvaluator(nullptr);
+    }
+    if (aiLoop)
+        StartAICalculation();
+}
+
+/*Switches the AI between the exhaustive two-ply search and Monte Carlo tree search on all cores*/
+void PentrisGame::ToggleMCTS()
+{
+    while (!pentrisAI.AIThreadJoined())
+        pentrisAI.interrupt = true;
+    if (pentrisAI.MCTSEnabled())
+        pentrisAI.DisableMCTS();
+    else
+        pentrisAI.EnableMCTS(mctsBudgetMs);
+    if (aiLoop)
+        StartAICalculation();
+}
+
+/*Switches the AI between searching on its own thread and searching on the game thread, a slice per frame*/
+void PentrisGame::ToggleCooperativeAI()
+{
+    if (maxGravity)
+        return;
+    while (!pentrisAI.AIThreadJoined())
+        pentrisAI.interrupt = true;
+    pentrisAI.CancelSpeculation();
+    aiCooperative = !aiCooperative;
+    pentrisAI.SetCooperative(aiCooperative);
+    if (aiLoop)
+        StartAICalculation();
+}
+
+/*Switches maximum gravity on and off. The deadline is only kept by the search on the AI's own thread, so maximum gravity
+  takes the AI off the game thread*/
+void PentrisGame::ToggleMaxGravity()
+{
+    while (!pentrisAI.AIThreadJoined())
+        pentrisAI.interrupt = true;
+    pentrisAI.CancelSpeculation();
+    maxGravity = !maxGravity;
+    if (maxGravity && aiCooperative)
+    {
+        aiCooperative = false;
+        pentrisAI.SetCooperative(false);
+    }
+    pentrisAI.SetDeadline(maxGravity ? aiDeadlineMicroseconds : 0);
+    aiLatencies.Clear();
+    fallTimer = std::min(fallTimer, FallSeconds());
+    if (aiLoop)
+        StartAICalculation();
+}
+
+/*Cycles the grid mode through 2x2, 4x4 and 8x8 boards and back to the single game*/
+void PentrisGame::ToggleGrid()
+{
+    if (gridSide == 0)
+    {
+        //The single game waits while the grid is shown
+        while (!pentrisAI.AIThreadJoined())
+            pentrisAI.interrupt = true;
+        gridSide = 2;
+    }
+    else if (gridSide < 8)
+        gridSide *= 2;
+    else
+    {
+        gridSide = 0;
+        grid.Resize(0, pentrisField.Width(), pentrisField.Height(), 0);
+        if (aiLoop)
+            StartAICalculation();
+        return;
+    }
+    RestartGrid();
+}
+
+/*Starts new games on all boards: fields of the game's size, played at depth 0 with the evaluator currently selected*/
+void PentrisGame::RestartGrid()
+{
+    grid.Resize(gridSide * gridSide, pentrisField.Width(), pentrisField.Height(), (std::uint32_t)rand());
+    if (useLinearEvaluator)
+        for (size_t i = 0; i < grid.Size(); i++)
+            grid.Board(i).SetEvaluator(linearEvaluator);
+    gridMoveTimer = 0.0f;
+}
+
+/*Replaces the game loop while the grid is shown: handles its keys, steps every board once every aiMoveAfterSeconds and draws*/
+void PentrisGame::GridHandling(float fElapsedTime)
+{
+    if (GetKey(olc::Key::X).bPressed)
+    {
+        ToggleGrid();
+        if (gridSide == 0)
+            return;
+    }
+    if (GetKey(olc::Key::ENTER).bPressed)
+        RestartGrid();
+    if (GetKey(olc::Key::P).bPressed)
+        aiMoveAfterSeconds = std::max(0.0f, aiMoveAfterSeconds - 0.01f);
+    if (GetKey(olc::Key::O).bPressed)
+        aiMoveAfterSeconds = std::max(0.0f, aiMoveAfterSeconds + 0.01f);
+    gridMoveTimer -= fElapsedTime;
+    if (gridMoveTimer <= 0)
+    {
+        grid.Step();
+        gridMoveTimer = aiMoveAfterSeconds;
+    }
+    DrawGrid();
+}
+
+/*Draws all boards of the grid in a single pass over the draw target, scaled to fit the window, each with its lines so far*/
+void PentrisGame::DrawGrid()
+{
+    Clear(olc::BLACK);
+    const size_t boards = grid.Size();
+    DrawString(10, 10, "GRID " + std::to_string(gridSide) + "x" + std::to_string(gridSide) + "  Games: " + std::to_string(grid.TotalGames()) +
+        "  Avg lines: " + std::to_string((int)grid.TotalAverageLines()) + "  " + std::to_string((int)(grid.lastStepUs / std::max<size_t>(1, boards))) +
+        " us/board  X: Next  Enter: Restart");
+    olc::Sprite* target = GetDrawTarget();
+    if ((target == nullptr) || (boards == 0))
+        return;
+    olc::Pixel* data = target->GetData();
+    const int width = pentrisField.Width();
+    const int height = pentrisField.Height();
+    const int cellWidth = ScreenWidth() / gridSide;
+    const int cellHeight = (ScreenHeight() - GRID_TOP) / gridSide;
+    //Leave room for a line of text below each board
+    const int unit = std::max(1, std::min((cellWidth - 4) / width, (cellHeight - 14) / height));
+    for (size_t b = 0; b < boards; b++)
+    {
+        const PentrisField& field = grid.Board(b).Field();
+        const int left = (int)(b % gridSide) * cellWidth + (cellWidth - width * unit) / 2;
+        const int top = GRID_TOP + (int)(b / gridSide) * cellHeight;
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+            {
+                const int block = field(x, y);
+                if ((block <= 0) || (block >= (int)gridPalette.size()))
+                    continue;
+                //Clip to the draw target: a field too large for its cell overflows it even at a unit of 1
+                const int x0 = std::max(0, left + x * unit);
+                const int y0 = std::max(0, top + y * unit);
+                const int x1 = std::min(target->width, left + (x + 1) * unit);
+                const int y1 = std::min(target->height, top + (y + 1) * unit);
+                for (int py = y0; py < y1; py++)
+                    for (int px = x0; px < x1; px++)
+                        data[px + py * target->width] = gridPalette[block];
+            }
+        DrawString(left, top + height * unit + 2, std::to_string(grid.Board(b).Lines()));
+    }
 }
 
 float PentrisGame::Random(float a, float b)
@@ -303,6 +709,27 @@ float PentrisGame::Random(float a, float b)
     return (b - a) * (float(rand()) / float(RAND_MAX)) + a;
 }
 
+/*Sets the time the AI has to commit to a placement under maximum gravity (takes effect immediately if it is on)*/
+void PentrisGame::SetAIDeadline(const int microseconds)
+{
+    aiDeadlineMicroseconds = std::max(1, microseconds);
+    if (!maxGravity)
+        return;
+    while (!pentrisAI.AIThreadJoined())
+        pentrisAI.interrupt = true;
+    pentrisAI.CancelSpeculation();
+    pentrisAI.SetDeadline(aiDeadlineMicroseconds);
+    if (aiLoop)
+        StartAICalculation();
+}
+
+/*Sets the number of background stars (takes effect immediately if the game is already running)*/
+void PentrisGame::SetStarCount(const int count)
+{
+    starCount = std::max(0, count);
+    stars.Resize(starCount);
+}
+
 /*Draws the game field (current falling pentomino and next pentomino need to be drawn separately)*/
 void PentrisGame::DrawField()
 {
@@ -322,7 +749,7 @@ void PentrisGame::DrawField()
 
 /*Draws a pentomino at the posX and posY (top left coordinates) point of the field.
   If useColormap == false, then the argument color is used to fill the pentomino*/
-void PentrisGame::DrawPentomino(const std::vector<int> pentomino, const int posX, const int posY, bool useColormap, olc::Pixel color)
+void PentrisGame::DrawPentomino(const std::vector<int>& pentomino, const int posX, const int posY, bool useColormap, olc::Pixel color)
 {
     if (pentomino.size() < pentrisField.PENTOMINO_WIDTH * pentrisField.PENTOMINO_WIDTH)
         return;
@@ -340,14 +767,20 @@ void PentrisGame::DrawPentomino(const std::vector<int> pentomino, const int posX
 
 void PentrisGame::NewGame()
 {
-    pentrisField.Reset();
+    //Seed the piece stream explicitly so that the game can be recorded and replayed
+    std::uint32_t seed = ((std::uint32_t)rand() << 16) ^ (std::uint32_t)rand();
+    pentrisField.Reset(seed);
+    recorder.BeginGame(seed, pentrisField);
+    logger.Log(LogEventType::GAME_START, { games, seed, pentrisField.Width(), pentrisField.Height() });
+    logger.Log(LogEventType::SPAWN, { games, 1, pentrisField.PentominoId(pentrisField.currentPentomino), pentrisField.PentominoId(pentrisField.nextPentomino) });
     score = 0;
     linesFilled = 0;
     pieceCount = 1;
     gameOver = false;
     moveTimer = 0.0f;
     fallAfterSeconds = 2.5f;
-    fallTimer = fallAfterSeconds;
+    fallTimer = FallSeconds();
+    aiLatencies.Clear();
     clearTimer = std::numeric_limits<float>::max();
 }
 
@@ -355,28 +788,38 @@ bool PentrisGame::OnUserCreate()
 {
     sAppName = "Pentomino Puzzle";
     srand((unsigned int)time(NULL));
-    stars.resize(starCount);
-    for (auto& star : stars)
+    stars.Resize(starCount);
+    pentrisAI.SetLogger(&logger);
+    std::shared_ptr<PentrisBook> book = std::make_shared<PentrisBook>();
+    if (book->Open(BOOK_PATH))
     {
-        star.angle = Random(0.0f, 2.0f * 3.1459f);
-        star.speed = Random(10.0f, 100.0f);
-        star.distance = Random(20.0f, 200.0f);
-        float lum = Random(0.3f, 1.0f);
-        star.col = olc::PixelF(lum, lum, lum, 1.0f);
+        pentrisAI.SetBook(book);
+        advisor.SetBook(book);
     }
+    for (const auto& color : PENTOMINO_COLORMAP)
+        gridPalette[color.first] = color.second;
     origin = { float(ScreenWidth() / 2), float(ScreenHeight() / 2) };
+    //The field was seeded before srand, so the first game is started here like every other one
+    NewGame();
     return true;
 }
 
 bool PentrisGame::OnUserUpdate(float fElapsedTime)
 {
+    if (gridSide > 0)
+    {
+        GridHandling(fElapsedTime);
+        return true;
+    }
     terminalY = pentrisField.GetTerminalY();
     UserInputHandling(fElapsedTime);
-    AIInputHandling(fElapsedTime);
-    PentominoMovementHandling(fElapsedTime);
-
-    timeElapsed += fElapsedTime;
+    if (aiCooperative)
+        pentrisAI.StepSearch(0, AI_SLICE_MICROSECONDS);
+    SimulationHandling(fElapsedTime);
+    AdvisorHandling();
 
+    if (stream.IsOpen())
+        PublishStreamFrame();
     DrawHandling(fElapsedTime);
 
     return true;
@@ -3,13 +3,15 @@
 #include "olcPixelGameEngine.h"
 #include "PentrisField.h"
 #include "PentrisAI.h"
-
-struct Star {
-    float angle = 0.0f;
-    float distance = 0.0f;
-    float speed = 0.0f;
-    olc::Pixel col = olc::WHITE;
-};
+#include "PentrisStarfield.h"
+#include "PentrisReplay.h"
+#include "PentrisPlanner.h"
+#include "PentrisLogger.h"
+#include "PentrisStream.h"
+#include "PentrisGrid.h"
+#include "PentrisAdvisor.h"
+#include <array>
+#include <memory>
 
 class PentrisGame : public olc::PixelGameEngine
 {
@@ -18,6 +20,12 @@ private:
     //The game field
     PentrisField pentrisField;
 
+    /*EVENT LOG*/
+    //Receives the game's events, the AI's decisions and the diagnostics of the E, D and B keys (declared before the AI,
+    //which logs into it, so that it outlives the AI). Written to LOG_PATH while logging is switched on
+    PentrisLogger logger;
+    const std::string LOG_PATH = "pentris_events.csv";
+
     /*AI VARIABLES*/
     PentrisAI pentrisAI;
     //The AI is playing if "true"
@@ -30,6 +38,35 @@ private:
     float aiCalcCutoff = 2.0f;
     //The point at which the AI started calculating (in seconds after the application started)
     float aiCalcStarted;
+    //Turns the AI's chosen placement into inputs
+    PentrisPlanner planner;
+    //The placement the current plan leads to
+    Placement aiTarget;
+    //The inputs to execute, consumed one step at a time by moving aiPlanCursor
+    std::array<MoveData, PentrisPlanner::MAX_STEPS> aiPlan;
+    int aiPlanLength = 0;
+    int aiPlanCursor = 0;
+    //True while the result of the running search still has to be turned into a plan
+    bool aiPlanPending = false;
+    //True if the running search was started on the field as it will be once the flashing rows are cleared.
+    //Its plan is held until the clear, which then needs no search of its own
+    bool aiSearchAhead = false;
+    //If "true", the AI searches on the game thread, in slices of AI_SLICE_MICROSECONDS per frame, instead of on its own thread
+    bool aiCooperative = false;
+    const int AI_SLICE_MICROSECONDS = 2000;
+
+    /*MAXIMUM GRAVITY*/
+    //If "true" (F), the pentomino falls a row every tick, and the AI gets aiDeadlineMicroseconds to commit to each placement
+    //before its best depth 0 move is played instead (see PentrisAI::SetDeadline). Meant for the AI: no human can play it
+    bool maxGravity = false;
+    int aiDeadlineMicroseconds = 1000;
+    //Latencies and deadline misses of the AI's decisions in the current game (logged when it ends)
+    DecisionLatencies aiLatencies;
+
+    /*PLACEMENT ADVISOR*/
+    //If "true" (H), the placement the AI recommends for the player's pentomino is drawn as a second shadow (not while the AI plays)
+    bool advisorOn = false;
+    PentrisAdvisor advisor;
 
     /*PLAYER INPUT VARIABLES*/
     //If the user keeps left/right/down pressed, then the pentomino only moves every moveAfterSeconds (to prevent near instantaneous jumps to the border at a high framerate)
@@ -50,6 +87,21 @@ private:
     int terminalY;
     float timeElapsed = 0;
 
+    /*SIMULATION CLOCK*/
+    //The game advances in fixed ticks of TICK_SECONDS, as many per frame as the time scale calls for; only the state after
+    //the frame's last tick is drawn
+    const float TICK_SECONDS = 1.0f / 240.0f;
+    //How many times faster than real time the game runs (T cycles through 1, 10, 100 and 0: uncapped)
+    int timeScale = 1;
+    //Simulated time still owed to the game (seconds)
+    float tickAccumulator = 0.0f;
+    //The wall time a frame may spend on ticks, so that drawing and input keep up at any time scale
+    const float FRAME_BUDGET_SECONDS = 0.03f;
+    //Ticks simulated in the current second of wall time, and in the previous one (shown on the sidebar)
+    int ticksCounted = 0;
+    int ticksPerSecond = 0;
+    float tickCountTimer = 0.0f;
+
     /*GAME STATS*/
     //Number of pieces delivered to the player
     int pieceCount = 1;
@@ -61,9 +113,43 @@ private:
     int games = 0;
     bool gameOver = false;
 
+    /*REPLAY RECORDING*/
+    PentrisRecorder recorder;
+    //Games are appended to this file while recording is switched on (starting with the next new game)
+    const std::string REPLAY_PATH = "pentris_replay.bin";
+
+    /*SPECTATOR STREAM*/
+    //While switched on, every frame's state is streamed to the spectators connected to 127.0.0.1:STREAM_PORT
+    PentrisStreamServer stream;
+    StreamFrame streamFrame;
+    const std::uint16_t STREAM_PORT = 7777;
+
+    /*GRID MODE*/
+    //Many AI games at once, gridSide x gridSide boards stepped in parallel (X cycles through 2x2, 4x4, 8x8 and off).
+    //The single game is paused meanwhile
+    PentrisGrid grid;
+    int gridSide = 0;
+    //Stores a countdown from aiMoveAfterSeconds to 0 - at 0, every board places its next pentomino
+    float gridMoveTimer = 0.0f;
+    //PENTOMINO_COLORMAP as a flat table, for drawing the boards straight into the draw target
+    std::array<olc::Pixel, 15> gridPalette;
+    //The boards are drawn below a line of text
+    const int GRID_TOP = 30;
+
+    /*AI EVALUATOR*/
+    //The trained linear evaluator, loaded from WEIGHTS_PATH when it is first switched on (nullptr while the built-in heuristic is used)
+    std::shared_ptr<PentrisLinearEvaluator> linearEvaluator;
+    bool useLinearEvaluator = false;
+    const std::string WEIGHTS_PATH = "pentris_linear.txt";
+    //Opening book (see PentrisBookTool), loaded from BOOK_PATH at startup if the file is there
+    const std::string BOOK_PATH = "pentris_book.bin";
+    //Time budget per move of the Monte Carlo tree search mode
+    int mctsBudgetMs = 100;
+
     /*DRAWING VARIABLES AND CONSTANTS*/
-    const int starCount = 500;
-    std::vector<Star> stars;
+    //Number of background stars; can be raised into the hundreds of thousands via SetStarCount (the S key cycles it)
+    int starCount = 500;
+    PentrisStarfield stars;
     olc::vf2d origin;
     //How many pixels a single block is tall and wide
     const int PIXELS_PER_UNIT = 20;
@@ -92,12 +178,32 @@ private:
     void DrawStars(float fElapsedTime);
     void UserInputHandling(float fElapsedTime);
     void AIInputHandling(float fElapsedTime);
+    void StartAICalculation(unsigned char maxDepth = 1);
+    void PlanAIMove();
+    bool PlanToAITarget();
+    void ToggleLinearEvaluator();
+    void ToggleMCTS();
+    void ToggleCooperativeAI();
+    void ToggleMaxGravity();
+    void AdvisorHandling();
+    //The seconds after which the pentomino falls by a row: fallAfterSeconds, or a single tick under maximum gravity
+    float FallSeconds() const { return maxGravity ? TICK_SECONDS : fallAfterSeconds; };
+    void ExecuteAIPlanStep();
     void PentominoMovementHandling(float fElapsedTime);
     void DrawHandling(float fElapsedTime);
+    void SimulationHandling(float fElapsedTime);
+    void Tick();
+    void PublishStreamFrame();
+    void ToggleGrid();
+    void RestartGrid();
+    void GridHandling(float fElapsedTime);
+    void DrawGrid();
 public:
     float Random(float a, float b);
+    void SetStarCount(const int count);
+    void SetAIDeadline(const int microseconds);
     void DrawField();
-    void DrawPentomino(const std::vector<int> pentomino, const int posX, const int posY, bool useColormap, olc::Pixel color);
+    void DrawPentomino(const std::vector<int>& pentomino, const int posX, const int posY, bool useColormap, olc::Pixel color);
 
     void NewGame();
 
@@ -0,0 +1,116 @@
+#include "PentrisGrid.h"
+#include <chrono>
+
+PentrisGrid::PentrisGrid(unsigned threads)
+{
+    //hardware_concurrency may report 0
+    if (threads > 256)
+        threads = 0;
+    for (unsigned i = 0; i < threads; i++)
+        workers.emplace_back(&PentrisGrid::WorkerLoop, this);
+}
+
+PentrisGrid::~PentrisGrid()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    stepStarted.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+void PentrisGrid::Resize(const size_t count, const unsigned width, const unsigned height, const std::uint32_t seed)
+{
+    baseSeed = seed;
+    boards.clear();
+    boards.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        boards[i].simulation = std::make_unique<PentrisSimulation>(width, height);
+        boards[i].simulation->Reset(baseSeed + 0x9E3779B9u * (std::uint32_t)i);
+    }
+}
+
+/*Wakes the workers, steps boards on the calling thread alongside them and waits until every board has been stepped*/
+void PentrisGrid::Step()
+{
+    const auto started = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        nextBoard = 0;
+        busyWorkers = (unsigned)workers.size();
+        generation++;
+    }
+    stepStarted.notify_all();
+    StepBoards();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stepDone.wait(lock, [this] { return busyWorkers == 0; });
+    }
+    lastStepUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count();
+}
+
+/*Claims boards until none are left, and plays one pentomino on each (or starts the board's next game)*/
+void PentrisGrid::StepBoards()
+{
+    for (size_t index = nextBoard++; index < boards.size(); index = nextBoard++)
+    {
+        BoardState& board = boards[index];
+        if (board.simulation->IsOver())
+        {
+            board.games++;
+            board.lines += board.simulation->Lines();
+            //Every board gets its own sequence of games
+            board.simulation->Reset(baseSeed + 0x9E3779B9u * (std::uint32_t)index + 0x85EBCA6Bu * (std::uint32_t)board.games);
+        }
+        else
+            board.simulation->Step();
+    }
+}
+
+void PentrisGrid::WorkerLoop()
+{
+    std::uint64_t stepped = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stepStarted.wait(lock, [&] { return stopping || (generation != stepped); });
+            if (stopping)
+                return;
+            stepped = generation;
+        }
+        StepBoards();
+        bool last;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            last = (--busyWorkers == 0);
+        }
+        if (last)
+            stepDone.notify_one();
+    }
+}
+
+double PentrisGrid::AverageLines(const size_t index) const
+{
+    return (boards[index].games > 0) ? (double)boards[index].lines / boards[index].games : 0.0;
+}
+
+int PentrisGrid::TotalGames() const
+{
+    int games = 0;
+    for (const BoardState& board : boards)
+        games += board.games;
+    return games;
+}
+
+double PentrisGrid::TotalAverageLines() const
+{
+    std::int64_t lines = 0;
+    for (const BoardState& board : boards)
+        lines += board.lines;
+    const int games = TotalGames();
+    return (games > 0) ? (double)lines / games : 0.0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "PentrisSimulation.h"
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+/*Many independent AI games side by side, each a PentrisSimulation with its own field and AI (and so its own strategy:
+  search depth and evaluator can be set per board). Step advances every board by one pentomino, spread over a pool of
+  worker threads that is started once and kept: the boards are claimed one at a time from a shared counter, so the
+  only cost that is not per board is one wake-up and one wait per step. A finished game is restarted right away*/
+class PentrisGrid
+{
+private:
+    struct BoardState {
+        std::unique_ptr<PentrisSimulation> simulation;
+        //Finished games, and the lines cleared in them
+        int games = 0;
+        std::int64_t lines = 0;
+    };
+    std::vector<BoardState> boards;
+    std::uint32_t baseSeed = 0;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable stepStarted;
+    std::condition_variable stepDone;
+    //Bumped by every Step; a worker steps boards once per generation
+    std::uint64_t generation = 0;
+    unsigned busyWorkers = 0;
+    bool stopping = false;
+    std::atomic<size_t> nextBoard{ 0 };
+    void WorkerLoop();
+    void StepBoards();
+public:
+    //Duration of the most recent Step in microseconds
+    double lastStepUs = 0;
+
+    //threads: worker threads besides the caller's (by default one less than the hardware threads)
+    explicit PentrisGrid(unsigned threads = std::thread::hardware_concurrency() - 1);
+    ~PentrisGrid();
+    PentrisGrid(const PentrisGrid&) = delete;
+    PentrisGrid& operator=(const PentrisGrid&) = delete;
+    //Replaces the boards by count new games on width*height fields; seed determines every board's piece streams
+    void Resize(const size_t count, const unsigned width, const unsigned height, const std::uint32_t seed);
+    //Places one pentomino on every board. Blocks until all boards are done
+    void Step();
+    size_t Size() const { return boards.size(); };
+    unsigned Threads() const { return (unsigned)workers.size() + 1; };
+    PentrisSimulation& Board(const size_t index) { return *boards[index].simulation; };
+    const PentrisSimulation& Board(const size_t index) const { return *boards[index].simulation; };
+    int Games(const size_t index) const { return boards[index].games; };
+    //Average lines per finished game of a board (0 before its first game has ended)
+    double AverageLines(const size_t index) const;
+    //Finished games and their average lines over all boards
+    int TotalGames() const;
+    double TotalAverageLines() const;
+};
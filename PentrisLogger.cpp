@@ -0,0 +1,173 @@
+#include "PentrisLogger.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    //Version of the BINARY format
+    const std::uint32_t BINARY_VERSION = 2;
+
+    void PutLittleEndian(std::uint8_t* out, const std::uint64_t value, const int bytes)
+    {
+        for (int i = 0; i < bytes; i++)
+            out[i] = (std::uint8_t)(value >> (8 * i));
+    }
+}
+
+PentrisLogger::PentrisLogger(const size_t capacity) : ring(capacity)
+{
+    created = std::chrono::steady_clock::now();
+    writer = std::thread(&PentrisLogger::WriterLoop, this);
+}
+
+PentrisLogger::~PentrisLogger()
+{
+    running = false;
+    writer.join();
+    Close();
+}
+
+bool PentrisLogger::Open(const std::string& path, const Format newFormat)
+{
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    Drain();
+    open = false;
+    file.close();
+    format = newFormat;
+    file.open(path, std::ios::out | std::ios::trunc | ((format == Format::BINARY) ? std::ios::binary : std::ios::out));
+    if (!file.is_open())
+        return false;
+    if (format == Format::CSV)
+        file << "time_us,event,v0,v1,v2,v3,v4,v5,text\n";
+    else
+    {
+        std::uint8_t header[16];
+        std::memcpy(header, "PNTRSLOG", 8);
+        PutLittleEndian(header + 8, BINARY_VERSION, 4);
+        PutLittleEndian(header + 12, LogEvent::RECORD_SIZE, 4);
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    }
+    open = true;
+    return true;
+}
+
+void PentrisLogger::Close()
+{
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    Drain();
+    open = false;
+    file.close();
+}
+
+void PentrisLogger::Log(const LogEventType type, std::initializer_list<std::int64_t> values, const char* text)
+{
+    if (!open && (type != LogEventType::DIAGNOSTIC))
+        return;
+    LogEvent event;
+    event.timeUs = (std::uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - created).count();
+    event.type = type;
+    for (std::int64_t value : values)
+        if (event.valueCount < LogEvent::VALUES)
+            event.values[event.valueCount++] = value;
+    if (text != nullptr)
+        std::strncpy(event.text, text, LogEvent::TEXT_LENGTH - 1);
+    if (!ring.TryPush(event))
+        dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+const char* PentrisLogger::EventName(const LogEventType type)
+{
+    switch (type)
+    {
+    case LogEventType::GAME_START: return "game_start";
+    case LogEventType::SPAWN: return "spawn";
+    case LogEventType::PLACEMENT: return "placement";
+    case LogEventType::LINE_CLEAR: return "line_clear";
+    case LogEventType::GAME_OVER: return "game_over";
+    case LogEventType::AI_DECISION: return "ai_decision";
+    case LogEventType::DIAGNOSTIC: return "diagnostic";
+    case LogEventType::DROPPED: return "dropped";
+    case LogEventType::LATENCY: return "latency";
+    }
+    return "unknown";
+}
+
+/*Writes a single event to the file (if one is open) and echoes diagnostics. Called by the writer with sinkMutex held*/
+void PentrisLogger::Write(const LogEvent& event)
+{
+    if (event.type == LogEventType::DIAGNOSTIC)
+    {
+        std::cout << event.text;
+        for (int i = 0; i < event.valueCount; i++)
+            std::cout << ((i == 0) ? " " : ", ") << event.values[i];
+        std::cout << std::endl;
+    }
+    if (!file.is_open())
+        return;
+    if (format == Format::BINARY)
+    {
+        //Field by field, so that the record holds no padding and does not depend on the compiler's layout of LogEvent
+        std::uint8_t record[LogEvent::RECORD_SIZE];
+        PutLittleEndian(record, event.timeUs, 8);
+        record[8] = (std::uint8_t)event.type;
+        record[9] = event.valueCount;
+        for (int i = 0; i < LogEvent::VALUES; i++)
+            PutLittleEndian(record + 10 + 8 * i, (std::uint64_t)event.values[i], 8);
+        std::memcpy(record + 10 + 8 * LogEvent::VALUES, event.text, LogEvent::TEXT_LENGTH);
+        file.write(reinterpret_cast<const char*>(record), sizeof(record));
+    }
+    else
+    {
+        file << event.timeUs << ',' << EventName(event.type);
+        for (int i = 0; i < LogEvent::VALUES; i++)
+        {
+            file << ',';
+            if (i < event.valueCount)
+                file << event.values[i];
+        }
+        //The text never holds commas or quotes, so it needs no escaping
+        file << ',' << event.text << '\n';
+    }
+    written++;
+}
+
+/*Writes out every event in the ring, reports the drops since the last report and flushes the file. Called with sinkMutex
+  held, which also keeps the ring's consumers (the writer, Open and Close) from taking turns at the same time*/
+void PentrisLogger::Drain()
+{
+    LogEvent event;
+    while (ring.TryPop(event))
+        Write(event);
+    //Record the drops since the last report as an event of their own
+    const std::uint64_t droppedNow = dropped;
+    if ((droppedNow != droppedReported) && file.is_open())
+    {
+        LogEvent report;
+        report.timeUs = (std::uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - created).count();
+        report.type = LogEventType::DROPPED;
+        report.values[0] = (std::int64_t)droppedNow;
+        report.valueCount = 1;
+        Write(report);
+        droppedReported = droppedNow;
+    }
+    if (file.is_open())
+        file.flush();
+}
+
+/*Drains the ring until the logger is destroyed, sleeping for flushIntervalMs whenever it runs empty*/
+void PentrisLogger::WriterLoop()
+{
+    for (;;)
+    {
+        //Read the flag before draining, so that the events logged before the destructor ran are all written
+        const bool stopping = !running;
+        {
+            std::lock_guard<std::mutex> lock(sinkMutex);
+            Drain();
+        }
+        if (stopping)
+            return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(flushIntervalMs));
+    }
+}
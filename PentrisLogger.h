@@ -0,0 +1,86 @@
+#pragma once
+
+#include "PentrisMPSCRing.h"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+
+/*The kinds of events in the game log, and the meaning of their values (v0-v5):
+  GAME_START   game, seed, field width, field height
+  SPAWN        game, piece number, pentomino id, next pentomino id
+  PLACEMENT    game, piece number, pentomino id, orientation, x, y
+  LINE_CLEAR   game, piece number, lines cleared at once, lines this game, score
+  GAME_OVER    game, pieces, lines, score
+  AI_DECISION  search id, valuation, pentomino id, orientation, x, y (text: the move sequence)
+  DIAGNOSTIC   free form values requested by the player (text: what they are); echoed on the console
+  DROPPED      events dropped so far (written by the logger itself)
+  LATENCY      game, AI decisions, deadline misses, median, 99th percentile and slowest latency in microseconds (at the end
+               of a game under maximum gravity)*/
+enum class LogEventType : std::uint8_t { GAME_START, SPAWN, PLACEMENT, LINE_CLEAR, GAME_OVER, AI_DECISION, DIAGNOSTIC, DROPPED, LATENCY };
+
+/*A fixed size log record, copied through the ring by value. In a BINARY log, each event is a RECORD_SIZE byte record:
+  timeUs (u64), type (u8), valueCount (u8), values (VALUES i64), text (TEXT_LENGTH bytes), all integers little endian*/
+struct LogEvent {
+    static const int VALUES = 6;
+    static const int TEXT_LENGTH = 40;
+    //Microseconds since the logger was created
+    std::uint64_t timeUs = 0;
+    std::int64_t values[VALUES] = {};
+    LogEventType type = LogEventType::DIAGNOSTIC;
+    std::uint8_t valueCount = 0;
+    //Zero terminated (and truncated to fit)
+    char text[TEXT_LENGTH] = {};
+
+    static const int RECORD_SIZE = 8 + 1 + 1 + 8 * VALUES + TEXT_LENGTH;
+};
+
+/*Asynchronous event log. Log() only copies the event into a lock-free ring (see PentrisMPSCRing) and returns, so the game
+  and AI threads never wait for the disk (or the console): if the ring is full, the event is dropped and counted instead.
+  A background thread drains the ring, writes the events to the open file (as CSV, or as LogEvent records behind a
+  "PNTRSLOG" header, a version (u32) and the record size (u32)) and echoes DIAGNOSTIC events on the console. Events logged
+  while no file is open are discarded, except for the diagnostics. Open and Close first drain the ring into the file that
+  was open, so no event logged before them is lost*/
+class PentrisLogger
+{
+public:
+    enum class Format { CSV, BINARY };
+private:
+    PentrisMPSCRing<LogEvent> ring;
+    std::chrono::steady_clock::time_point created;
+    std::atomic<bool> running{ true };
+    std::atomic<bool> open{ false };
+    std::atomic<std::uint64_t> dropped{ 0 };
+    std::atomic<std::uint64_t> written{ 0 };
+    //Held by the writer while it writes a batch, and by Open and Close
+    std::mutex sinkMutex;
+    std::ofstream file;
+    Format format = Format::CSV;
+    std::uint64_t droppedReported = 0;
+    std::thread writer;
+    void WriterLoop();
+    void Drain();
+    void Write(const LogEvent& event);
+public:
+    //How long the writer sleeps once the ring is empty
+    int flushIntervalMs = 5;
+
+    explicit PentrisLogger(const size_t capacity = 4096);
+    ~PentrisLogger();
+    PentrisLogger(const PentrisLogger&) = delete;
+    PentrisLogger& operator=(const PentrisLogger&) = delete;
+    //Starts writing events to the file at path (replacing it); closes the previous file
+    bool Open(const std::string& path, const Format newFormat = Format::CSV);
+    void Close();
+    bool IsOpen() const { return open; };
+    //Queues an event. Never blocks; safe to call from any thread
+    void Log(const LogEventType type, std::initializer_list<std::int64_t> values, const char* text = nullptr);
+    //Events dropped because the ring was full, and events written to a file
+    std::uint64_t Dropped() const { return dropped; };
+    std::uint64_t Written() const { return written; };
+    static const char* EventName(const LogEventType type);
+};
@@ -0,0 +1,224 @@
+#include "PentrisMCTS.h"
+#include <thread>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+/*Places the field's current pentomino at placement and clears the rows it fills. Returns the number of cleared rows*/
+int PentrisMCTS::Place(PentrisField& field, const Placement& placement)
+{
+    field.currentPentomino = field.OrientPentomino(placement.pentominoId, placement.orientation);
+    field.pentominoX = placement.posX;
+    field.pentominoY = placement.posY;
+    field.InsertCurrentPentomino();
+    int lines = field.MarkFilledRows(placement.posY, placement.posY + field.PENTOMINO_WIDTH - 1);
+    if (lines > 0)
+        field.ClearFilledRows();
+    return lines;
+}
+
+/*Creates the children of a decision node: the maxChildren best placements of the field's current pentomino by the
+  evaluation of the field right after each of them, best first*/
+void PentrisMCTS::Expand(Worker& worker, MCTSNode* node, const PentrisField& field)
+{
+    node->expanded = true;
+    worker.ai.EnumeratePlacements(field, worker.candidates);
+    const CandidateList& candidates = worker.candidates;
+    std::vector<std::pair<int, int>> ranked;
+    PentrisField scratch = field;
+    for (size_t i = 0; i < candidates.placements.size(); i++)
+    {
+        const Placement& placement = candidates.placements[i];
+        const std::vector<int> pentomino = field.OrientPentomino(placement.pentominoId, placement.orientation);
+        scratch.InsertPentomino(pentomino, placement.posX, placement.posY);
+        //Sorted ascending below, hence the negated evaluation (ties keep the enumeration order through the index)
+        ranked.push_back({ -worker.ai.EvaluateField(scratch), (int)i });
+        scratch.RemovePentomino(pentomino, placement.posX, placement.posY);
+    }
+    std::sort(ranked.begin(), ranked.end());
+    if ((int)ranked.size() > maxChildren)
+        ranked.resize(maxChildren);
+    MCTSNode** link = &node->firstChild;
+    for (const auto& entry : ranked)
+    {
+        MCTSNode* child = worker.arena.Allocate();
+        child->placement = candidates.placements[entry.second];
+        child->candidateIndex = entry.second;
+        *link = child;
+        link = &child->nextSibling;
+    }
+}
+
+/*UCT: the first unvisited child, otherwise the child with the best mean value (scaled to [0, 1]) plus exploration bonus*/
+MCTSNode* PentrisMCTS::Select(const Worker& worker, const MCTSNode* node) const
+{
+    const double range = worker.maxValue - worker.minValue;
+    const double logVisits = std::log((double)std::max(1, node->visits));
+    MCTSNode* best = nullptr;
+    double bestScore = -std::numeric_limits<double>::infinity();
+    for (MCTSNode* child = node->firstChild; child != nullptr; child = child->nextSibling)
+    {
+        if (child->visits == 0)
+            return child;
+        const double mean = child->totalValue / child->visits;
+        const double scaled = (range > 0) ? (mean - worker.minValue) / range : 0.5;
+        const double score = scaled + exploration * std::sqrt(logVisits / child->visits);
+        if (score > bestScore)
+        {
+            bestScore = score;
+            best = child;
+        }
+    }
+    return best;
+}
+
+/*Plays rolloutLength pentominos greedily (depth 0 search) and returns the value of the outcome: the lines cleared since
+  the root plus the evaluation of the final field, or GAME_OVER_VALUE if the game was lost*/
+double PentrisMCTS::Rollout(Worker& worker, PentrisField& field, int lines)
+{
+    for (int step = 0; step < rolloutLength; step++)
+    {
+        if (!field.DoesPentominoFit(field.currentPentomino, field.pentominoX, field.pentominoY))
+            return GAME_OVER_VALUE + lines * LINE_VALUE;
+        worker.ai.Search(field, 0);
+        if (worker.ai.bestMoveSequence.empty())
+            return GAME_OVER_VALUE + lines * LINE_VALUE;
+        lines += Place(field, worker.ai.bestPlacement);
+    }
+    return lines * LINE_VALUE + worker.ai.EvaluateField(field);
+}
+
+/*One iteration: descend from the root along the UCT choices (expanding decision nodes on their second visit), value the
+  reached node by a rollout and add the value to every node on the path*/
+void PentrisMCTS::Iterate(Worker& worker, const PentrisField& rootField)
+{
+    PentrisField field = rootField;
+    //The next pentomino is known, every later one is drawn from a fresh seed
+    field.Seed(worker.rng());
+    worker.path.clear();
+    worker.path.push_back(worker.root);
+    MCTSNode* node = worker.root;
+    int lines = 0;
+    double value;
+    while (true)
+    {
+        if ((node->visits == 0) && (node != worker.root))
+        {
+            value = Rollout(worker, field, lines);
+            break;
+        }
+        if (!node->expanded)
+            Expand(worker, node, field);
+        if (node->firstChild == nullptr)
+        {
+            value = GAME_OVER_VALUE + lines * LINE_VALUE;
+            break;
+        }
+        MCTSNode* child = Select(worker, node);
+        lines += Place(field, child->placement);
+        worker.path.push_back(child);
+        if (!field.DoesPentominoFit(field.currentPentomino, field.pentominoX, field.pentominoY))
+        {
+            value = GAME_OVER_VALUE + lines * LINE_VALUE;
+            break;
+        }
+        //Find (or create) the decision node for the pentomino that followed
+        const int pentominoId = field.PentominoId(field.currentPentomino);
+        MCTSNode* next = child->firstChild;
+        while ((next != nullptr) && (next->pentominoId != pentominoId))
+            next = next->nextSibling;
+        if (next == nullptr)
+        {
+            next = worker.arena.Allocate();
+            next->pentominoId = pentominoId;
+            next->nextSibling = child->firstChild;
+            child->firstChild = next;
+        }
+        worker.path.push_back(next);
+        node = next;
+    }
+    if (worker.iterations == 0)
+        worker.minValue = worker.maxValue = value;
+    worker.minValue = std::min(worker.minValue, value);
+    worker.maxValue = std::max(worker.maxValue, value);
+    for (MCTSNode* visited : worker.path)
+    {
+        visited->visits++;
+        visited->totalValue += value;
+    }
+    worker.iterations++;
+}
+
+/*Grows one tree until the deadline, the iteration limit or an interrupt*/
+void PentrisMCTS::SearchTree(Worker& worker, const PentrisField& field, const std::chrono::steady_clock::time_point deadline)
+{
+    worker.arena.Reset();
+    worker.iterations = 0;
+    worker.ai.SetEvaluator(evaluator);
+    worker.root = worker.arena.Allocate();
+    worker.root->pentominoId = field.PentominoId(field.currentPentomino);
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        if ((interrupt != nullptr) && *interrupt)
+            break;
+        if ((maxIterations > 0) && (worker.iterations >= maxIterations))
+            break;
+        Iterate(worker, field);
+    }
+}
+
+/*Searches the field's current pentomino for budgetMs milliseconds on threads trees and stores the most visited root
+  placement into bestPlacement and bestMoveSequence. Returns the mean value of that placement*/
+int PentrisMCTS::Search(const PentrisField& field, const std::uint32_t seed)
+{
+    auto started = std::chrono::steady_clock::now();
+    auto deadline = started + std::chrono::milliseconds(budgetMs);
+    bestMoveSequence.clear();
+    bestPlacement = Placement();
+    stats = MCTSStats();
+    stats.threads = (threads > 0) ? threads : std::max(1u, std::thread::hardware_concurrency());
+    while (workers.size() < stats.threads)
+        workers.emplace_back(new Worker());
+    workers[0]->ai.EnumeratePlacements(field, rootCandidates);
+    if (rootCandidates.placements.empty())
+        return GAME_OVER_VALUE;
+
+    std::vector<std::thread> searchThreads;
+    for (unsigned i = 0; i < stats.threads; i++)
+    {
+        workers[i]->rng.seed(seed * 7919u + i);
+        if (i > 0)
+            searchThreads.emplace_back(&PentrisMCTS::SearchTree, this, std::ref(*workers[i]), std::cref(field), deadline);
+    }
+    SearchTree(*workers[0], field, deadline);
+    for (auto& thread : searchThreads)
+        thread.join();
+
+    //Merge the trees: sum up the visits and values of each root placement over all trees
+    std::vector<std::uint64_t> visits(rootCandidates.placements.size(), 0);
+    std::vector<double> values(rootCandidates.placements.size(), 0.0);
+    std::uint64_t totalVisits = 0;
+    for (unsigned i = 0; i < stats.threads; i++)
+    {
+        const Worker& worker = *workers[i];
+        for (const MCTSNode* child = worker.root->firstChild; child != nullptr; child = child->nextSibling)
+        {
+            visits[child->candidateIndex] += child->visits;
+            values[child->candidateIndex] += child->totalValue;
+            totalVisits += child->visits;
+        }
+        stats.iterations += worker.iterations;
+        stats.nodes += worker.arena.Allocated();
+    }
+    //Without a single finished iteration, fall back to the first placement the enumeration found
+    size_t best = 0;
+    for (size_t i = 1; i < visits.size(); i++)
+        if ((visits[i] > visits[best]) || ((visits[i] == visits[best]) && (visits[i] > 0) && (values[i] / visits[i] > values[best] / visits[best])))
+            best = i;
+    bestPlacement = rootCandidates.placements[best];
+    bestPlacement.orientation = field.PentominoOrientation(field.OrientPentomino(bestPlacement.pentominoId, bestPlacement.orientation));
+    bestMoveSequence.assign(rootCandidates.moves.begin() + rootCandidates.moveStart[best], rootCandidates.moves.begin() + rootCandidates.moveStart[best + 1]);
+    stats.chosenShare = (totalVisits > 0) ? (double)visits[best] / totalVisits : 0.0;
+    stats.wallTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    return (visits[best] > 0) ? (int)(values[best] / visits[best]) : 0;
+}
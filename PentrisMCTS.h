@@ -0,0 +1,98 @@
+#pragma once
+
+#include "PentrisField.h"
+#include "PentrisAI.h"
+#include "PentrisArena.h"
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <cstdint>
+
+/*Statistics of one Monte Carlo search, summed over all of its trees*/
+struct MCTSStats {
+    unsigned threads = 0;
+    std::uint64_t iterations = 0;
+    std::uint64_t nodes = 0;
+    double wallTimeMs = 0.0;
+    //Visits of the chosen placement as a share of all visits of the root's placements
+    double chosenShare = 0.0;
+};
+
+/*A node of a search tree. A decision node stands for a field on which pentominoId is to be placed; its children are
+  placement nodes, one per terminal placement kept by the expansion. The children of a placement node are decision nodes,
+  one per pentomino that followed it: the pentomino after the next one is unknown, hence it is drawn anew in every iteration*/
+struct MCTSNode {
+    MCTSNode* firstChild = nullptr;
+    MCTSNode* nextSibling = nullptr;
+    int visits = 0;
+    double totalValue = 0.0;
+    //Decision nodes: the pentomino to place
+    int pentominoId = 0;
+    bool expanded = false;
+    //Placement nodes: the placement, and its index in the parent's enumeration (used to merge the roots of several trees)
+    Placement placement;
+    int candidateIndex = 0;
+};
+
+/*Monte Carlo tree search over placements, as an alternative to PentrisAI's exhaustive two-ply search that can see past the
+  next pentomino. Nodes are expanded with PentrisAI's placement enumeration (keeping the best few placements by their
+  evaluation), and leaves are valued by a short greedy rollout (a depth 0 search per pentomino).
+  The search is root-parallel: each thread grows its own tree until the time budget is spent, then the visit counts of the
+  root placements are merged and the most visited placement is chosen*/
+class PentrisMCTS
+{
+private:
+    /*The state of one tree and the thread searching it. Kept from move to move so that the arenas keep their memory*/
+    struct Worker {
+        PentrisArena<MCTSNode> arena;
+        //Used for the enumeration of placements and for the rollouts
+        PentrisAI ai;
+        CandidateList candidates;
+        std::mt19937 rng;
+        std::uint64_t iterations = 0;
+        //The range of values seen so far, to scale values to [0, 1] for the selection
+        double minValue = 0.0;
+        double maxValue = 0.0;
+        std::vector<MCTSNode*> path;
+        MCTSNode* root = nullptr;
+    };
+    std::vector<std::unique_ptr<Worker>> workers;
+    //The root placements (the same in every tree, as the enumeration is deterministic)
+    CandidateList rootCandidates;
+
+    void SearchTree(Worker& worker, const PentrisField& field, const std::chrono::steady_clock::time_point deadline);
+    void Iterate(Worker& worker, const PentrisField& rootField);
+    void Expand(Worker& worker, MCTSNode* node, const PentrisField& field);
+    MCTSNode* Select(const Worker& worker, const MCTSNode* node) const;
+    double Rollout(Worker& worker, PentrisField& field, int lines);
+    static int Place(PentrisField& field, const Placement& placement);
+public:
+    //Value of a cleared line and of losing the game, in units of the evaluation
+    static const int LINE_VALUE = 100;
+    static const int GAME_OVER_VALUE = -10000;
+
+    //Time budget of a search in milliseconds
+    int budgetMs = 100;
+    //Number of trees (0 = one per hardware thread)
+    unsigned threads = 0;
+    //Pentominos placed greedily per rollout
+    int rolloutLength = 4;
+    //Placements kept per decision node (the best ones by their evaluation)
+    int maxChildren = 6;
+    //Weight of the exploration term of the UCT selection
+    double exploration = 0.5;
+    //If > 0, each tree stops after this many iterations even if the budget is not spent
+    std::uint64_t maxIterations = 0;
+    //Evaluator for the expansion and the rollouts (nullptr = the built-in heuristic)
+    std::shared_ptr<const PentrisEvaluator> evaluator;
+    //If set and raised, the search stops early and returns the best placement found so far
+    const std::atomic<bool>* interrupt = nullptr;
+
+    std::vector<MoveData> bestMoveSequence;
+    Placement bestPlacement;
+    MCTSStats stats;
+
+    int Search(const PentrisField& field, const std::uint32_t seed = 1);
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+/*A bounded lock-free queue for many producers and a single consumer.
+  Every slot carries a sequence number telling whose turn it is: a producer claims the next position with a compare and
+  swap and publishes the value by advancing the slot's sequence, the consumer takes the value and hands the slot to the
+  producer one lap ahead. TryPush never waits: if the ring is full it fails immediately.
+  The capacity is rounded up to a power of two*/
+template<typename T>
+class PentrisMPSCRing
+{
+    static_assert(std::is_trivially_copyable<T>::value, "PentrisMPSCRing requires a trivially copyable type");
+private:
+    struct alignas(64) Slot {
+        std::atomic<std::uint64_t> sequence{ 0 };
+        T value;
+    };
+    std::unique_ptr<Slot[]> slots;
+    std::uint64_t mask = 0;
+    //Claimed by the producers; kept on its own cache line, away from the consumer's position
+    alignas(64) std::atomic<std::uint64_t> enqueuePosition{ 0 };
+    alignas(64) std::uint64_t dequeuePosition = 0;
+
+public:
+    explicit PentrisMPSCRing(const size_t minCapacity)
+    {
+        size_t capacity = 2;
+        while (capacity < minCapacity)
+            capacity *= 2;
+        slots.reset(new Slot[capacity]);
+        mask = capacity - 1;
+        for (size_t i = 0; i < capacity; i++)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /*Appends value; returns false (without waiting) if the ring is full. Safe to call from any number of threads*/
+    bool TryPush(const T& value)
+    {
+        std::uint64_t position = enqueuePosition.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot& slot = slots[position & mask];
+            const std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const std::int64_t lap = (std::int64_t)(sequence - position);
+            if (lap == 0)
+            {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    slot.value = value;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            //The consumer has not taken the value of the previous lap yet
+            else if (lap < 0)
+                return false;
+            //Another producer claimed the position first
+            else
+                position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    /*Takes the oldest value; returns false if there is none. Only to be called from the single consumer thread*/
+    bool TryPop(T& value)
+    {
+        Slot& slot = slots[dequeuePosition & mask];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeuePosition + 1)
+            return false;
+        value = slot.value;
+        slot.sequence.store(dequeuePosition + mask + 1, std::memory_order_release);
+        dequeuePosition++;
+        return true;
+    }
+
+    size_t Capacity() const { return (size_t)(mask + 1); };
+};
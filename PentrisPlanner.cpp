@@ -0,0 +1,151 @@
+#include "PentrisPlanner.h"
+#include <algorithm>
+
+namespace
+{
+    //Orientation index after a clockwise rotation, see Placement
+    int Rotated(const int orientation)
+    {
+        return (orientation & 4) | ((orientation + 1) & 3);
+    }
+
+    //Orientation index after a reflection: reflecting a rotated pentomino equals reflecting first and rotating the other way
+    int Reflected(const int orientation)
+    {
+        return ((orientation & 4) ^ 4) | ((4 - (orientation & 3)) & 3);
+    }
+}
+
+/*Tries the pentomino in the given orientation at x and at the kick offsets PentrisField uses when rotating or reflecting*/
+bool PentrisPlanner::Kick(const PentrisField& field, const int orientation, const int x, const int y, int& kickedX) const
+{
+    const int kicks[] = { 0, 1, 2, -1, -2 };
+    for (int kick : kicks)
+        if (field.DoesPentominoFit(shapes[orientation], x + kick, y))
+        {
+            kickedX = x + kick;
+            return true;
+        }
+    return false;
+}
+
+int PentrisPlanner::Plan(const PentrisField& field, const Placement& target, MoveData* plan)
+{
+    const int pentominoId = field.PentominoId(field.currentPentomino);
+    if ((pentominoId != target.pentominoId) || (pentominoId == 0))
+        return 0;
+    for (int orientation = 0; orientation < 8; orientation++)
+    {
+        shapes[orientation] = field.OrientPentomino(pentominoId, orientation);
+        canonical[orientation] = orientation;
+        for (int other = 0; other < orientation; other++)
+            if (shapes[other] == shapes[orientation])
+            {
+                canonical[orientation] = other;
+                break;
+            }
+    }
+    const int startOrientation = field.PentominoOrientation(field.currentPentomino);
+    const int targetOrientation = canonical[target.orientation & 7];
+    if (startOrientation < 0)
+        return 0;
+
+    //Pentominos can never move up, hence only rows between the start and the target need to be considered
+    minX = -field.PENTOMINO_WIDTH + 1;
+    minY = field.pentominoY;
+    spanX = field.Width() + field.PENTOMINO_WIDTH - 1;
+    spanY = target.posY - minY + 1;
+    if ((spanY <= 0) || (target.posX < minX) || (target.posX >= minX + spanX))
+        return 0;
+    nodes.assign(8 * spanX * spanY, Node());
+    std::vector<bool> visited(nodes.size(), false);
+    queue.clear();
+
+    const int start = StateIndex(field.pentominoX, field.pentominoY, canonical[startOrientation]);
+    visited[start] = true;
+    queue.push_back(start);
+    int goal = -1;
+    for (size_t head = 0; (head < queue.size()) && (goal < 0); head++)
+    {
+        const int state = queue[head];
+        const int x = state % spanX + minX;
+        const int y = (state / spanX) % spanY + minY;
+        const int orientation = state / (spanX * spanY);
+        //Goal: the target column and orientation, at the target row or directly above it with a free drop
+        if ((x == target.posX) && (orientation == targetOrientation)
+            && ((y == target.posY) || (field.GetTerminalY(shapes[orientation], x, y) == target.posY)))
+        {
+            goal = state;
+            break;
+        }
+
+        auto Visit = [&](const int nextX, const int nextY, const int nextOrientation, const MoveType moveType, const int amount)
+        {
+            if ((nextY > target.posY) || (nextX < minX) || (nextX >= minX + spanX))
+                return;
+            const int next = StateIndex(nextX, nextY, canonical[nextOrientation]);
+            if (visited[next])
+                return;
+            visited[next] = true;
+            nodes[next].parent = state;
+            nodes[next].moveType = moveType;
+            nodes[next].amount = amount;
+            queue.push_back(next);
+        };
+
+        if (field.DoesPentominoFit(shapes[orientation], x - 1, y))
+            Visit(x - 1, y, orientation, MoveType::LEFT, 1);
+        if (field.DoesPentominoFit(shapes[orientation], x + 1, y))
+            Visit(x + 1, y, orientation, MoveType::RIGHT, 1);
+        if (field.DoesPentominoFit(shapes[orientation], x, y + 1))
+            Visit(x, y + 1, orientation, MoveType::DOWN, 1);
+        //One to three clockwise rotations within a single step, each with its own wall kick
+        int rotatedX = x;
+        int rotatedOrientation = orientation;
+        for (int rotations = 1; rotations <= 3; rotations++)
+        {
+            rotatedOrientation = Rotated(rotatedOrientation);
+            if (!Kick(field, rotatedOrientation, rotatedX, y, rotatedX))
+                break;
+            Visit(rotatedX, y, rotatedOrientation, MoveType::ROTATE, rotations);
+        }
+        int reflectedX;
+        if (Kick(field, Reflected(orientation), x, y, reflectedX))
+            Visit(reflectedX, y, Reflected(orientation), MoveType::REFLECT, 1);
+    }
+    if (goal < 0)
+        return 0;
+
+    //Walk back from the goal, then merge runs of single column/row moves into one step with a destination
+    std::vector<int> path;
+    for (int state = goal; state != start; state = nodes[state].parent)
+        path.push_back(state);
+    std::reverse(path.begin(), path.end());
+    int steps = 0;
+    for (int state : path)
+    {
+        const Node& node = nodes[state];
+        const int x = state % spanX + minX;
+        const int y = (state / spanX) % spanY + minY;
+        if (steps >= MAX_STEPS - 1)
+            return 0;
+        if ((node.moveType == MoveType::LEFT) || (node.moveType == MoveType::RIGHT))
+        {
+            if ((steps > 0) && (plan[steps - 1].moveType == node.moveType))
+                plan[steps - 1].destination = x;
+            else
+                plan[steps++] = MoveData(node.moveType, x);
+        }
+        else if (node.moveType == MoveType::DOWN)
+        {
+            if ((steps > 0) && (plan[steps - 1].moveType == MoveType::DOWN))
+                plan[steps - 1].destination = y;
+            else
+                plan[steps++] = MoveData(MoveType::DOWN, y);
+        }
+        else
+            plan[steps++] = MoveData(node.moveType, node.amount);
+    }
+    plan[steps++] = MoveData(MoveType::HARD_DROP, target.posX);
+    return steps;
+}
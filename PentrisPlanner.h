@@ -0,0 +1,39 @@
+#pragma once
+
+#include "PentrisField.h"
+#include "PentrisAI.h"
+#include <vector>
+
+/*Turns a target placement into the shortest sequence of inputs that takes the current pentomino there.
+  The search is a breadth-first search over (x, y, orientation) using the same moves (and the same wall kicks)
+  as PentrisField's Move/Rotate/ReflectCurrentPentomino. Every step of the returned plan costs one execution step:
+    LEFT/RIGHT destination  - one column per step until x == destination
+    DOWN destination        - one row per step until y == destination
+    ROTATE n                - n clockwise rotations within a single step (n = 3 is a counterclockwise turn)
+    REFLECT                 - a single reflection
+    HARD_DROP               - drops the pentomino (always the last step)*/
+class PentrisPlanner
+{
+public:
+    static const int MAX_STEPS = 64;
+private:
+    struct Node {
+        int parent = -1;
+        MoveType moveType = MoveType::HARD_DROP;
+        int amount = 0;
+    };
+    std::vector<Node> nodes;
+    std::vector<int> queue;
+    std::vector<int> shapes[8];
+    //The smallest orientation index with the same shape, for each orientation index (symmetric pentominos share shapes)
+    int canonical[8] = {};
+    int minX = 0, minY = 0, spanX = 0, spanY = 0;
+
+    int StateIndex(const int x, const int y, const int orientation) const { return ((orientation * spanY) + (y - minY)) * spanX + (x - minX); };
+    bool Kick(const PentrisField& field, const int orientation, const int x, const int y, int& kickedX) const;
+public:
+    //Writes the plan for bringing the field's current pentomino to target into plan (room for MAX_STEPS moves).
+    //Returns the number of steps, or 0 if target cannot be reached (it is for another pentomino, above the pentomino's row, or
+    //blocked off); plan is then left unspecified and the caller has to decide what to do instead
+    int Plan(const PentrisField& field, const Placement& target, MoveData* plan);
+};
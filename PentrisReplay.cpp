@@ -0,0 +1,237 @@
+#include "PentrisReplay.h"
+#include <cstring>
+
+PentrisRecorder::~PentrisRecorder()
+{
+    Close();
+}
+
+/*Opens path for appending; a file header is written if the file is new*/
+bool PentrisRecorder::Open(const std::string& path)
+{
+    Close();
+    file.open(path, std::ios::binary | std::ios::out | std::ios::app);
+    if (!file.is_open())
+        return false;
+    if (file.tellp() == 0)
+    {
+        file.write(PentrisReplayFormat::MAGIC, sizeof(PentrisReplayFormat::MAGIC));
+        file.put((char)PentrisReplayFormat::VERSION);
+    }
+    return true;
+}
+
+/*Closes the file. A game still in progress is dropped: without its GAME_END record, the games appended after it could not be
+  replayed*/
+void PentrisRecorder::Close()
+{
+    if (!file.is_open())
+        return;
+    buffer.clear();
+    file.close();
+    inGame = false;
+}
+
+void PentrisRecorder::PutVarint(std::uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        buffer.push_back((std::uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back((std::uint8_t)value);
+}
+
+void PentrisRecorder::Flush()
+{
+    file.write((const char*)buffer.data(), buffer.size());
+    buffer.clear();
+}
+
+/*Starts a new game record; a game still in progress (abandoned without EndGame) is dropped*/
+void PentrisRecorder::BeginGame(const std::uint32_t seed, const PentrisField& field)
+{
+    if (!file.is_open())
+        return;
+    buffer.clear();
+    buffer.push_back(PentrisReplayFormat::GAME_BEGIN);
+    for (int i = 0; i < 4; i++)
+        buffer.push_back((std::uint8_t)(seed >> (8 * i)));
+    PutVarint(field.Width());
+    PutVarint(field.Height());
+    inGame = true;
+}
+
+void PentrisRecorder::RecordPlacement(const Placement& placement)
+{
+    if (!file.is_open() || !inGame)
+        return;
+    buffer.push_back((std::uint8_t)(placement.pentominoId | (placement.orientation << 4)));
+    PutVarint(placement.posX + PentrisReplayFormat::PLACEMENT_X_BIAS);
+    PutVarint(placement.posY);
+}
+
+void PentrisRecorder::RecordClear()
+{
+    if (!file.is_open() || !inGame)
+        return;
+    buffer.push_back(PentrisReplayFormat::LINE_CLEAR);
+}
+
+/*Closes the current game record and writes it out (games are buffered in memory until they end)*/
+void PentrisRecorder::EndGame(const int score, const int lines, const int pieces)
+{
+    if (!file.is_open() || !inGame)
+        return;
+    buffer.push_back(PentrisReplayFormat::GAME_END);
+    PutVarint(score);
+    PutVarint(lines);
+    PutVarint(pieces);
+    Flush();
+    inGame = false;
+}
+
+bool PentrisReplayer::Open(const std::string& path)
+{
+    //A large stream buffer, since replays are read byte by byte
+    readBuffer.resize(1 << 20);
+    file.close();
+    file.rdbuf()->pubsetbuf(readBuffer.data(), readBuffer.size());
+    file.open(path, std::ios::binary | std::ios::in);
+    if (!file.is_open())
+        return false;
+    char header[sizeof(PentrisReplayFormat::MAGIC) + 1];
+    if (!file.read(header, sizeof(header)) || (std::memcmp(header, PentrisReplayFormat::MAGIC, sizeof(PentrisReplayFormat::MAGIC)) != 0)
+        || ((std::uint8_t)header[sizeof(PentrisReplayFormat::MAGIC)] != PentrisReplayFormat::VERSION))
+    {
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+bool PentrisReplayer::GetByte(std::uint8_t& value)
+{
+    int c = file.get();
+    if (c == std::char_traits<char>::eof())
+        return false;
+    value = (std::uint8_t)c;
+    return true;
+}
+
+bool PentrisReplayer::GetVarint(std::uint32_t& value)
+{
+    value = 0;
+    std::uint8_t byte;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        if (!GetByte(byte))
+            return false;
+        value |= (std::uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+/*Skips the remaining records of the current game (used after stopping early)*/
+bool PentrisReplayer::SkipToGameEnd()
+{
+    std::uint8_t tag;
+    std::uint32_t value;
+    while (GetByte(tag))
+    {
+        if (tag == PentrisReplayFormat::GAME_END)
+            return GetVarint(value) && GetVarint(value) && GetVarint(value);
+        if ((tag != PentrisReplayFormat::LINE_CLEAR) && !(GetVarint(value) && GetVarint(value)))
+            return false;
+    }
+    return false;
+}
+
+/*Replays the next game with the same rules as PentrisGame: each placement is inserted, filled rows are marked and scored,
+  and marked rows are removed whenever the recording says they were*/
+bool PentrisReplayer::NextGame(ReplayResult& result, PentrisField& field, const int stopAtPiece)
+{
+    result = ReplayResult();
+    if (!file.is_open())
+        return false;
+    std::uint8_t tag;
+    if (!GetByte(tag) || (tag != PentrisReplayFormat::GAME_BEGIN))
+        return false;
+    std::uint8_t seedBytes[4];
+    std::uint32_t width, height;
+    for (auto& byte : seedBytes)
+        if (!GetByte(byte))
+            return false;
+    if (!GetVarint(width) || !GetVarint(height) || (width < (std::uint32_t)PentrisField::MIN_WIDTH) || (height < (std::uint32_t)PentrisField::MIN_HEIGHT)
+        || (width > (std::uint32_t)PentrisField::MAX_WIDTH) || (height > (std::uint32_t)PentrisField::MAX_HEIGHT))
+        return false;
+    result.seed = seedBytes[0] | (seedBytes[1] << 8) | (seedBytes[2] << 16) | ((std::uint32_t)seedBytes[3] << 24);
+    result.width = width;
+    result.height = height;
+
+    PentrisField replayField(width, height);
+    replayField.Reset(result.seed);
+    bool consistent = true;
+    while (GetByte(tag))
+    {
+        if (tag == PentrisReplayFormat::GAME_END)
+        {
+            std::uint32_t score, lines, pieces;
+            if (!GetVarint(score) || !GetVarint(lines) || !GetVarint(pieces))
+                return false;
+            result.recordedScore = score;
+            result.recordedLines = lines;
+            result.recordedPieces = pieces;
+            result.verified = consistent && (result.score == result.recordedScore) && (result.lines == result.recordedLines)
+                && (result.pieces == result.recordedPieces);
+            field = replayField;
+            return true;
+        }
+        if (tag == PentrisReplayFormat::LINE_CLEAR)
+        {
+            replayField.ClearFilledRows();
+            continue;
+        }
+        if (result.pieces == stopAtPiece)
+        {
+            result.stopped = true;
+            field = replayField;
+            SkipToGameEnd();
+            return true;
+        }
+        std::uint32_t x, y;
+        if (!GetVarint(x) || !GetVarint(y))
+            return false;
+        Placement placement;
+        placement.pentominoId = tag & 0x0F;
+        placement.orientation = tag >> 4;
+        //Any other tag is no placement the recorder writes: the file is corrupt
+        if ((placement.pentominoId < 1) || (placement.pentominoId > 12) || (placement.orientation > 7))
+            return false;
+        placement.posX = (int)x - PentrisReplayFormat::PLACEMENT_X_BIAS;
+        placement.posY = y;
+        if (onPosition)
+            onPosition(replayField);
+        //The piece stream must agree with the seed
+        if (replayField.PentominoId(replayField.currentPentomino) != placement.pentominoId)
+            consistent = false;
+        replayField.currentPentomino = replayField.OrientPentomino(placement.pentominoId, placement.orientation);
+        replayField.pentominoX = placement.posX;
+        replayField.pentominoY = placement.posY;
+        if (!replayField.DoesPentominoFit(replayField.currentPentomino, placement.posX, placement.posY))
+            consistent = false;
+        replayField.InsertCurrentPentomino();
+        result.pieces++;
+        int newLinesFilled = replayField.MarkFilledRows(placement.posY, placement.posY + replayField.PENTOMINO_WIDTH - 1);
+        if (newLinesFilled > 0)
+        {
+            result.lines += newLinesFilled;
+            result.score += (1 << newLinesFilled) * 100;
+        }
+        if (onPlacement)
+            onPlacement(replayField, newLinesFilled);
+    }
+    return false;
+}
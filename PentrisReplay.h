@@ -0,0 +1,88 @@
+#pragma once
+
+#include "PentrisField.h"
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+/*Binary replay format (all multi-byte integers are LEB128 varints unless stated otherwise):
+    File header:  "PTRP" followed by a version byte
+    Game start:   GAME_BEGIN, seed (4 bytes, little endian), field width, field height
+    Placement:    (pentominoId | orientation << 4), posX + PLACEMENT_X_BIAS, posY   -> 3 bytes per piece on regular fields
+    Line clear:   LINE_CLEAR (the flashing rows were removed from the field)
+    Game end:     GAME_END, score, lines, pieces
+  Pieces are not stored separately: the seed reproduces the piece stream, and the pentomino id in each placement
+  is used to verify it. A file may contain any number of games back to back*/
+namespace PentrisReplayFormat
+{
+    const char MAGIC[4] = { 'P', 'T', 'R', 'P' };
+    const std::uint8_t VERSION = 1;
+    const std::uint8_t GAME_BEGIN = 0xF0;
+    const std::uint8_t LINE_CLEAR = 0xF1;
+    const std::uint8_t GAME_END = 0xF2;
+    //Pentominos may hang over the left wall by up to 4 columns, hence posX is stored with a bias
+    const int PLACEMENT_X_BIAS = 4;
+}
+
+/*Writes games into a replay file. The game calls BeginGame after seeding its field, RecordPlacement right before
+  each pentomino is inserted, RecordClear whenever filled rows are removed and EndGame once the game is lost.
+  Only finished games are written: a game abandoned before EndGame (by BeginGame or Close) is dropped*/
+class PentrisRecorder
+{
+private:
+    std::ofstream file;
+    std::vector<std::uint8_t> buffer;
+    bool inGame = false;
+    void PutVarint(std::uint32_t value);
+    void Flush();
+public:
+    ~PentrisRecorder();
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return file.is_open(); };
+    void BeginGame(const std::uint32_t seed, const PentrisField& field);
+    void RecordPlacement(const Placement& placement);
+    void RecordClear();
+    void EndGame(const int score, const int lines, const int pieces);
+};
+
+/*The outcome of replaying a single game, together with what the recording claimed*/
+struct ReplayResult {
+    std::uint32_t seed = 0;
+    int width = 0;
+    int height = 0;
+    int pieces = 0;
+    int lines = 0;
+    int score = 0;
+    int recordedPieces = 0;
+    int recordedLines = 0;
+    int recordedScore = 0;
+    //True if the piece stream matched the seed, every placement fit, and the final score, lines and pieces agree with the recording
+    bool verified = false;
+    //True if the game was cut short at stopAtPiece (the field is then left at that position)
+    bool stopped = false;
+};
+
+/*Streams games out of a replay file and reconstructs them without rendering, at full CPU speed*/
+class PentrisReplayer
+{
+private:
+    std::ifstream file;
+    std::vector<char> readBuffer;
+    bool GetByte(std::uint8_t& value);
+    bool GetVarint(std::uint32_t& value);
+    bool SkipToGameEnd();
+public:
+    //If set, called with the field right before each recorded placement (the current pentomino still at its spawn position)
+    std::function<void(const PentrisField&)> onPosition;
+    //If set, called with the field right after each placement, with the rows it filled marked but not yet cleared
+    std::function<void(const PentrisField&, int)> onPlacement;
+
+    bool Open(const std::string& path);
+    //Replays the next game in the file into field. Returns false at the end of the file, or where it is corrupt (a field size out
+    //of range, a placement tag holding no valid pentomino id and orientation).
+    //If stopAtPiece >= 0, replaying stops right before that piece is placed so the position can be inspected
+    bool NextGame(ReplayResult& result, PentrisField& field, const int stopAtPiece = -1);
+};
@@ -0,0 +1,58 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+#include "PentrisReplay.h"
+
+/*Headless replay verifier.
+  Usage: PentrisReplayTool <replay file> [game index] [piece index]
+  Without indices, every game in the file is replayed and checked against its recorded score.
+  With indices, the given game is replayed up to (but excluding) the given piece and the field is printed*/
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " <replay file> [game index] [piece index]" << std::endl;
+        return 1;
+    }
+    PentrisReplayer replayer;
+    if (!replayer.Open(argv[1]))
+    {
+        std::cout << "Could not open replay file " << argv[1] << std::endl;
+        return 1;
+    }
+    long long stopGame = (argc >= 4) ? std::atoll(argv[2]) : -1;
+    int stopPiece = (argc >= 4) ? std::atoi(argv[3]) : -1;
+
+    PentrisField field;
+    ReplayResult result;
+    long long games = 0, verified = 0, pieces = 0;
+    auto started = std::chrono::steady_clock::now();
+    while (replayer.NextGame(result, field, (games == stopGame) ? stopPiece : -1))
+    {
+        if (games == stopGame)
+        {
+            std::cout << "Game " << games << " (seed " << result.seed << ") before piece " << result.pieces
+                << ", score " << result.score << ", lines " << result.lines << std::endl;
+            for (int j = 0; j < field.Height(); j++)
+            {
+                for (int i = 0; i < field.Width(); i++)
+                    std::cout << ((field(i, j) == 0) ? '.' : ((field(i, j) == field.WALL) ? '#' : 'X'));
+                std::cout << std::endl;
+            }
+            return 0;
+        }
+        games++;
+        pieces += result.pieces;
+        if (result.verified)
+            verified++;
+        else
+            std::cout << "Game " << games - 1 << " (seed " << result.seed << ") does not match its recording: score "
+                << result.score << " vs " << result.recordedScore << ", lines " << result.lines << " vs " << result.recordedLines
+                << ", pieces " << result.pieces << " vs " << result.recordedPieces << std::endl;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << games << " games (" << verified << " verified), " << pieces << " pieces in " << seconds << " s ("
+        << ((seconds > 0) ? pieces / seconds : 0) << " pieces/s)" << std::endl;
+    return (verified == games) ? 0 : 2;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/*A sequence lock holding a single trivially copyable value.
+  Readers never block writers and never take a lock: Load() copies the value and retries if a
+  write was in progress. Writers are serialised by spinning on the (odd) sequence number, so
+  several threads may publish into the same lock.
+  The value is stored as relaxed atomic words, so concurrent reads are well defined*/
+template<typename T>
+class PentrisSeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "PentrisSeqLock requires a trivially copyable type");
+private:
+    static const size_t WORDS = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+    //Odd while a write is in progress; incremented by 2 for every completed write
+    std::atomic<std::uint64_t> sequence{ 0 };
+    std::atomic<std::uint64_t> words[WORDS];
+
+public:
+    PentrisSeqLock()
+    {
+        for (auto& word : words)
+            word.store(0, std::memory_order_relaxed);
+        Store(T());
+        sequence.store(0, std::memory_order_release);
+    }
+
+    void Store(const T& value)
+    {
+        std::uint64_t buffer[WORDS] = {};
+        std::memcpy(buffer, &value, sizeof(T));
+        std::uint64_t seq = sequence.load(std::memory_order_relaxed);
+        //Acquire the write side by moving the sequence from even to odd
+        do {
+            while (seq & 1)
+                seq = sequence.load(std::memory_order_relaxed);
+        } while (!sequence.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire, std::memory_order_relaxed));
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; i++)
+            words[i].store(buffer[i], std::memory_order_relaxed);
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    T Load() const
+    {
+        std::uint64_t buffer[WORDS];
+        std::uint64_t seqBefore, seqAfter;
+        do {
+            seqBefore = sequence.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORDS; i++)
+                buffer[i] = words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            seqAfter = sequence.load(std::memory_order_relaxed);
+        } while ((seqBefore & 1) || (seqBefore != seqAfter));
+        T value;
+        std::memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+
+    //The number of completed writes, usable to detect whether a new value was published
+    std::uint64_t Version() const { return sequence.load(std::memory_order_acquire) / 2; }
+};
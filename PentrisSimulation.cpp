@@ -0,0 +1,80 @@
+#include "PentrisSimulation.h"
+
+PentrisSimulation::PentrisSimulation(const unsigned width, const unsigned height) : field(width, height)
+{
+    Reset(0);
+}
+
+PentrisSimulation::PentrisSimulation() : PentrisSimulation(18, 35)
+{
+}
+
+/*Starts a new game whose piece stream is determined by seed*/
+void PentrisSimulation::Reset(const std::uint32_t newSeed)
+{
+    seed = newSeed;
+    field.Reset(seed);
+    score = 0;
+    lines = 0;
+    pieces = 0;
+    gameOver = false;
+    latencies.Clear();
+    if (recorder != nullptr)
+        recorder->BeginGame(seed, field);
+}
+
+/*Plays a single pentomino. Returns false if the game is over*/
+bool PentrisSimulation::Step()
+{
+    if (gameOver)
+        return false;
+    if (!field.DoesPentominoFit(field.currentPentomino, field.pentominoX, field.pentominoY))
+    {
+        EndGame();
+        return false;
+    }
+    ai.Search(field, searchDepth);
+    latencies.Record(ai.LastStats());
+    if (ai.bestMoveSequence.empty())
+    {
+        EndGame();
+        return false;
+    }
+    const Placement& placement = ai.bestPlacement;
+    field.currentPentomino = field.OrientPentomino(placement.pentominoId, placement.orientation);
+    field.pentominoX = placement.posX;
+    field.pentominoY = placement.posY;
+    if (recorder != nullptr)
+        recorder->RecordPlacement(placement);
+    field.InsertCurrentPentomino();
+    pieces++;
+    int newLinesFilled = field.MarkFilledRows(placement.posY, placement.posY + field.PENTOMINO_WIDTH - 1);
+    if (newLinesFilled > 0)
+    {
+        field.ClearFilledRows();
+        if (recorder != nullptr)
+            recorder->RecordClear();
+        lines += newLinesFilled;
+        score += (1 << newLinesFilled) * 100;
+    }
+    if ((maxPieces > 0) && (pieces >= maxPieces))
+    {
+        EndGame();
+        return false;
+    }
+    return true;
+}
+
+/*Plays a whole game from seed*/
+void PentrisSimulation::PlayGame(const std::uint32_t newSeed)
+{
+    Reset(newSeed);
+    while (Step());
+}
+
+void PentrisSimulation::EndGame()
+{
+    gameOver = true;
+    if (recorder != nullptr)
+        recorder->EndGame(score, lines, pieces);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "PentrisField.h"
+#include "PentrisAI.h"
+#include "PentrisReplay.h"
+#include <cstdint>
+#include <memory>
+
+/*A headless game played by the AI: no rendering, no timers and no flashing rows. Each Step searches the current field,
+  places the pentomino at the chosen placement and clears filled rows right away. Used for self-play (training records,
+  evaluator and tournament benchmarks)*/
+class PentrisSimulation
+{
+private:
+    PentrisField field;
+    PentrisAI ai;
+    PentrisRecorder* recorder = nullptr;
+    std::uint32_t seed = 0;
+    int score = 0;
+    int lines = 0;
+    int pieces = 0;
+    bool gameOver = false;
+    DecisionLatencies latencies;
+    void EndGame();
+public:
+    //Search depth of the AI (see PentrisAI::Search)
+    unsigned char searchDepth = 0;
+    //If > 0, the game ends after this many pentominos even if it is not lost
+    int maxPieces = 0;
+
+    PentrisSimulation(const unsigned width, const unsigned height);
+    PentrisSimulation();
+    void Reset(const std::uint32_t seed);
+    bool Step();
+    void PlayGame(const std::uint32_t seed);
+    void SetEvaluator(const std::shared_ptr<const PentrisEvaluator>& evaluator) { ai.SetEvaluator(evaluator); };
+    //Gives the AI microseconds per decision (see PentrisAI::SetDeadline); 0 for no deadline
+    void SetDeadline(const int microseconds) { ai.SetDeadline(microseconds); };
+    //Records every game into recorder (which has to be open, and outlive the simulation); nullptr stops recording
+    void SetRecorder(PentrisRecorder* newRecorder) { recorder = newRecorder; };
+
+    const PentrisField& Field() const { return field; };
+    PentrisAI& AI() { return ai; };
+    std::uint32_t Seed() const { return seed; };
+    int Score() const { return score; };
+    int Lines() const { return lines; };
+    int Pieces() const { return pieces; };
+    //The AI's decisions of the current game: their latencies, and how many missed the deadline
+    const DecisionLatencies& Latencies() const { return latencies; };
+    //True if the game is over (lost, or maxPieces reached)
+    bool IsOver() const { return gameOver; };
+    //True if the game was lost, i.e. the next pentomino could not be placed
+    bool IsLost() const { return gameOver && ((maxPieces <= 0) || (pieces < maxPieces)); };
+};
@@ -0,0 +1,153 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include "PentrisSolver.h"
+
+/*Puzzle solver front end: searches for placements of a fixed sequence of pentominos that clear the field completely,
+  or that clear a number of lines.
+  Usage: PentrisSolveTool <pieces> [options]
+    pieces: comma separated pentomino ids (1-12), or random:<count>:<seed> for the seeded piece stream of a game
+    Options:
+        --lines <n>         clear n lines instead of the whole field
+        --field <file>      starting field: one line per row, '#' for a block and '.' for an empty cell, the last line
+                            being the bottom row (default: empty)
+        --width <w> --height <h> field size including walls and floor (default 12x22, whose 10 cells wide rows take
+                            whole pentomino counts to clear)
+        --threads <n>       default: one per core
+        --time <ms>         give up after this long, leaving the answer unknown (default: 5000; 0 for no limit)
+        --nodes <n>         give up after about n nodes (default: no limit)*/
+
+namespace
+{
+    bool LoadField(const std::string& path, PentrisField& field)
+    {
+        std::ifstream file(path);
+        if (!file.is_open())
+            return false;
+        std::vector<std::string> rows;
+        std::string line;
+        while (std::getline(file, line))
+            if (!line.empty())
+                rows.push_back(line);
+        if ((int)rows.size() > field.Height() - 1)
+            return false;
+        for (size_t r = 0; r < rows.size(); r++)
+        {
+            const int posY = field.Height() - 1 - (int)(rows.size() - r);
+            for (int i = 0; (i < (int)rows[r].size()) && (i < field.Width() - 2); i++)
+                if (rows[r][i] == '#')
+                    field.SetBlock(i + 1, posY, field.WALL);
+        }
+        return true;
+    }
+
+    void PrintField(const PentrisField& field)
+    {
+        for (int j = field.StackTop(); j < field.Height() - 1; j++)
+        {
+            std::string row;
+            for (int i = 1; i < field.Width() - 1; i++)
+                row += (field(i, j) != 0) ? '#' : '.';
+            std::cout << "    " << row << std::endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " <ids,... | random:<count>:<seed>> [--lines n] [--field file] [--width w] [--height h]"
+            << " [--threads n] [--time ms] [--nodes n]" << std::endl;
+        return 1;
+    }
+    int targetLines = 0, width = 12, height = 22;
+    std::string fieldPath;
+    PentrisSolver solver;
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--lines") == 0)
+            targetLines = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--field") == 0)
+            fieldPath = argv[i + 1];
+        else if (std::strcmp(argv[i], "--width") == 0)
+            width = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--height") == 0)
+            height = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--threads") == 0)
+            solver.threads = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--time") == 0)
+            solver.timeLimitMs = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--nodes") == 0)
+            solver.nodeLimit = std::strtoull(argv[i + 1], nullptr, 10);
+        else
+        {
+            std::cout << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    PentrisField field(width, height);
+    std::vector<int> pieces;
+    std::string piecesArg = argv[1];
+    if (piecesArg.compare(0, 7, "random:") == 0)
+    {
+        int count = std::atoi(piecesArg.c_str() + 7);
+        size_t separator = piecesArg.find(':', 7);
+        field.Seed((separator != std::string::npos) ? (std::uint32_t)std::strtoul(piecesArg.c_str() + separator + 1, nullptr, 10) : 1);
+        for (int i = 0; i < count; i++)
+            pieces.push_back(field.PentominoId(field.GetRandomPentomino()));
+    }
+    else
+    {
+        std::stringstream stream(piecesArg);
+        std::string id;
+        while (std::getline(stream, id, ','))
+        {
+            pieces.push_back(std::atoi(id.c_str()));
+            if ((pieces.back() < 1) || (pieces.back() > 12))
+            {
+                std::cout << "Invalid pentomino id " << id << std::endl;
+                return 1;
+            }
+        }
+    }
+    field.Reset();
+    if (!fieldPath.empty() && !LoadField(fieldPath, field))
+    {
+        std::cout << "Could not load field " << fieldPath << std::endl;
+        return 1;
+    }
+
+    std::cout << "Pieces:";
+    for (int id : pieces)
+        std::cout << " " << id;
+    std::cout << std::endl << "Goal: " << ((targetLines > 0) ? std::to_string(targetLines) + " lines" : std::string("perfect clear")) << std::endl;
+    SolverResult result = solver.Solve(field, pieces, targetLines);
+    const SolverStats& stats = solver.stats;
+    std::cout << ((result == SolverResult::SOLVED) ? "Solved" : (result == SolverResult::NO_SOLUTION) ? "No solution" : "Unknown (gave up)")
+        << " in " << stats.wallTimeMs << " ms on " << stats.threads << " threads: " << stats.nodes << " nodes, pruned "
+        << stats.prunedArea << " by area, " << stats.prunedParity << " by parity, " << stats.memoHits << " memo hits, "
+        << stats.deadStates << " dead states" << std::endl;
+    if (result != SolverResult::SOLVED)
+        return 2;
+    for (size_t i = 0; i < solver.solution.size(); i++)
+    {
+        const Placement& placement = solver.solution[i];
+        field.currentPentomino = field.OrientPentomino(placement.pentominoId, placement.orientation);
+        field.pentominoX = placement.posX;
+        field.pentominoY = placement.posY;
+        field.InsertCurrentPentomino();
+        if (field.MarkFilledRows(placement.posY, placement.posY + field.PENTOMINO_WIDTH - 1) > 0)
+            field.ClearFilledRows();
+        std::cout << i + 1 << ": pentomino " << placement.pentominoId << ", orientation " << placement.orientation << " at "
+            << placement.posX << ", " << placement.posY << " (" << solver.solutionMoves[i].size() << " moves)" << std::endl;
+        PrintField(field);
+    }
+    std::cout << solver.solutionLines << " lines cleared" << std::endl;
+    return 0;
+}
@@ -0,0 +1,313 @@
+#include "PentrisSolver.h"
+#include <thread>
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+
+namespace
+{
+    //Alternating column colours: bit x of a row word is set iff column x (of the word's 64) is even
+    const std::uint64_t EVEN_COLUMNS = 0x5555555555555555ull;
+    //Added to the valuation of a placement per line it clears, when ordering the placements
+    const int LINE_VALUE = 100;
+}
+
+PentrisSolver::PentrisSolver()
+{
+    PentrisField field;
+    for (int id = 1; id <= 12; id++)
+        for (int orientation = 0; orientation < 8; orientation++)
+        {
+            const std::vector<int> pentomino = field.OrientPentomino(id, orientation);
+            int imbalance = 0;
+            for (int i = 0; i < field.PENTOMINO_WIDTH * field.PENTOMINO_WIDTH; i++)
+                if (pentomino[i] != 0)
+                    imbalance += ((i % field.PENTOMINO_WIDTH) % 2 == 0) ? 1 : -1;
+            maxImbalance[id] = std::max(maxImbalance[id], std::abs(imbalance));
+        }
+}
+
+bool PentrisSolver::IsDead(const std::uint64_t key)
+{
+    MemoShard& shard = memo[key % MEMO_SHARDS];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.dead.count(key) > 0;
+}
+
+void PentrisSolver::MarkDead(const std::uint64_t key)
+{
+    MemoShard& shard = memo[key % MEMO_SHARDS];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.dead.insert(key);
+}
+
+/*Identifies a search state: the occupancy of the field, the number of pentominos placed (which fixes the ones still to come)
+  and the lines cleared so far. Two states are taken to be the same if their keys collide, which at 64 bits is negligible*/
+std::uint64_t PentrisSolver::StateKey(const PentrisField& field, const int placed, const int lines)
+{
+    std::uint64_t key = field.Hash() ^ (((std::uint64_t)placed << 32) | (std::uint32_t)lines);
+    key *= 0x9E3779B97F4A7C15ull;
+    return key ^ (key >> 29);
+}
+
+/*Places the field's current pentomino at placement and clears the rows it fills. Returns the number of cleared rows*/
+int PentrisSolver::Place(PentrisField& field, const Placement& placement)
+{
+    field.currentPentomino = field.OrientPentomino(placement.pentominoId, placement.orientation);
+    field.pentominoX = placement.posX;
+    field.pentominoY = placement.posY;
+    field.InsertCurrentPentomino();
+    int lines = field.MarkFilledRows(placement.posY, placement.posY + field.PENTOMINO_WIDTH - 1);
+    if (lines > 0)
+        field.ClearFilledRows();
+    return lines;
+}
+
+bool PentrisSolver::IsGoal(const PentrisField& field, const int lines) const
+{
+    if (targetLines > 0)
+        return lines >= targetLines;
+    return field.StackTop() == field.Height() - 1;
+}
+
+/*Returns false if the goal can no longer be reached with the pentominos left (by the area and parity bounds)*/
+bool PentrisSolver::Feasible(const PentrisField& field, const int placed, const int lines, Worker& worker) const
+{
+    const int rowWidth = field.Width() - 2;
+    const int remaining = (int)pieces.size() - placed;
+    const std::uint64_t* interior = field.InteriorMask();
+    if (targetLines > 0)
+    {
+        //Every line still to be cleared is a distinct row that the remaining pentominos have to complete: at best the rows
+        //with the fewest empty cells (rows above the stack being entirely empty)
+        const int needed = targetLines - lines;
+        std::vector<int>& empty = worker.rowEmpty;
+        empty.clear();
+        for (int j = field.StackTop(); j < field.Height() - 1; j++)
+        {
+            int filledRow = 0;
+            for (int k = 0; k < field.WordsPerRow(); k++)
+                filledRow += PentrisFieldKernels::PopCount(field.RowBits(j)[k] & interior[k]);
+            empty.push_back(rowWidth - filledRow);
+        }
+        while ((int)empty.size() < needed)
+            empty.push_back(rowWidth);
+        std::partial_sort(empty.begin(), empty.begin() + needed, empty.end());
+        int cellsNeeded = 0;
+        for (int i = 0; i < needed; i++)
+            cellsNeeded += empty[i];
+        if (cellsNeeded > 5 * remaining)
+        {
+            worker.stats.prunedArea++;
+            return false;
+        }
+        return true;
+    }
+
+    //Filled cells, and their colour imbalance (even minus odd columns)
+    int filled = 0;
+    int imbalance = 0;
+    for (int j = field.StackTop(); j < field.Height() - 1; j++)
+    {
+        const std::uint64_t* row = field.RowBits(j);
+        for (int k = 0; k < field.WordsPerRow(); k++)
+        {
+            const std::uint64_t cells = row[k] & interior[k];
+            filled += PentrisFieldKernels::PopCount(cells);
+            imbalance += PentrisFieldKernels::PopCount(cells & EVEN_COLUMNS) - PentrisFieldKernels::PopCount(cells & ~EVEN_COLUMNS);
+        }
+    }
+    //The colour imbalance of a full row, and the height of the stack
+    int rowImbalance = 0;
+    for (int k = 0; k < field.WordsPerRow(); k++)
+        rowImbalance += PentrisFieldKernels::PopCount(interior[k] & EVEN_COLUMNS) - PentrisFieldKernels::PopCount(interior[k] & ~EVEN_COLUMNS);
+    const int stackHeight = field.Height() - 1 - field.StackTop();
+    bool areaFeasible = false;
+    int imbalanceReach = 0;
+    for (int m = 1; m <= remaining; m++)
+    {
+        imbalanceReach += maxImbalance[pieces[placed + m - 1]];
+        //The field is cleared after m more pentominos only if all cells make up whole rows, and the rows cover the stack
+        if ((filled + 5 * m) % rowWidth != 0)
+            continue;
+        const int rows = (filled + 5 * m) / rowWidth;
+        if (rows < stackHeight)
+            continue;
+        areaFeasible = true;
+        //The m pentominos have to make up the imbalance of those rows, each changing it by an odd amount
+        const int needed = rows * rowImbalance - imbalance;
+        if ((std::abs(needed) <= imbalanceReach) && ((std::abs(needed) - m) % 2 == 0))
+            return true;
+    }
+    if (areaFeasible)
+        worker.stats.prunedParity++;
+    else
+        worker.stats.prunedArea++;
+    return false;
+}
+
+/*Enumerates the placements of pieces[placed] on field into worker.candidates[placed], and keeps those that can still lead to a
+  solution in worker.children[placed], best first (placements reaching the goal first of all). No placements are kept if the
+  pentomino does not fit at its spawn position (i.e. the game would be lost)*/
+void PentrisSolver::Expand(Worker& worker, const PentrisField& field, const int placed, const int lines)
+{
+    CandidateList& candidates = worker.candidates[placed];
+    std::vector<Child>& children = worker.children[placed];
+    candidates.Clear();
+    children.clear();
+    PentrisField& scratch = worker.scratch;
+    scratch = field;
+    scratch.currentPentomino = scratch.GetPentomino(pieces[placed]);
+    scratch.pentominoX = scratch.Width() / 2 - scratch.PENTOMINO_WIDTH / 2;
+    scratch.pentominoY = 0;
+    if (!scratch.DoesPentominoFit(scratch.currentPentomino, scratch.pentominoX, scratch.pentominoY))
+        return;
+    worker.ai.EnumeratePlacements(scratch, candidates);
+    worker.visited.clear();
+    for (size_t i = 0; i < candidates.placements.size(); i++)
+    {
+        scratch = field;
+        Child child;
+        child.index = (int)i;
+        child.lines = Place(scratch, candidates.placements[i]);
+        //Placements that lead to the same field (e.g. a drop, and a move down and sideways) are searched once
+        const std::uint64_t hash = scratch.Hash();
+        if (std::find(worker.visited.begin(), worker.visited.end(), hash) != worker.visited.end())
+            continue;
+        worker.visited.push_back(hash);
+        if (IsGoal(scratch, lines + child.lines))
+            child.eval = std::numeric_limits<int>::max();
+        else if (!Feasible(scratch, placed + 1, lines + child.lines, worker))
+            continue;
+        else
+            child.eval = worker.ai.EvaluateField(scratch) + child.lines * LINE_VALUE;
+        children.push_back(child);
+    }
+    std::stable_sort(children.begin(), children.end(), [](const Child& a, const Child& b) { return a.eval > b.eval; });
+}
+
+/*Depth-first search below field, on which placed pentominos have been placed, clearing lines rows.
+  Returns true once a solution has been stored (by this or another thread)*/
+bool PentrisSolver::Solve_Recursive(Worker& worker, const PentrisField& field, const int placed, const int lines)
+{
+    if (stop)
+        return false;
+    if (++worker.stats.nodes % NODE_CHECK_INTERVAL == 0)
+    {
+        const std::uint64_t nodes = (nodesSearched += NODE_CHECK_INTERVAL);
+        if (((timeLimitMs > 0) && (std::chrono::steady_clock::now() > deadline)) || ((nodeLimit > 0) && (nodes >= nodeLimit)))
+        {
+            timedOut = true;
+            stop = true;
+            return false;
+        }
+    }
+    if ((placed > 0) && IsGoal(field, lines))
+    {
+        std::lock_guard<std::mutex> lock(solutionMutex);
+        if (!solved)
+        {
+            solution.clear();
+            solutionMoves.clear();
+            for (int depth = 0; depth < placed; depth++)
+            {
+                const CandidateList& candidates = worker.candidates[depth];
+                const int index = worker.path[depth];
+                solution.push_back(candidates.placements[index]);
+                solutionMoves.emplace_back(candidates.moves.begin() + candidates.moveStart[index], candidates.moves.begin() + candidates.moveStart[index + 1]);
+            }
+            solutionLines = lines;
+            solved = true;
+        }
+        stop = true;
+        return true;
+    }
+    if (placed == (int)pieces.size())
+        return false;
+    const std::uint64_t key = StateKey(field, placed, (targetLines > 0) ? lines : 0);
+    if ((placed > 0) && IsDead(key))
+    {
+        worker.stats.memoHits++;
+        return false;
+    }
+
+    Expand(worker, field, placed, lines);
+    PentrisField& next = worker.fields[placed + 1];
+    //The first pentomino's placements are shared out among the threads: each thread takes the next one not yet taken
+    int claimed = (placed == 0) ? nextRootChild++ : 0;
+    for (size_t i = 0; i < worker.children[placed].size(); i++)
+    {
+        if (placed == 0)
+        {
+            if ((int)i != claimed)
+                continue;
+            claimed = nextRootChild++;
+        }
+        const Child& child = worker.children[placed][i];
+        next = field;
+        Place(next, worker.candidates[placed].placements[child.index]);
+        worker.path[placed] = child.index;
+        if (Solve_Recursive(worker, next, placed + 1, lines + child.lines))
+            return true;
+        if (stop)
+            return false;
+    }
+    //The subtree was searched in full (the root is searched by several threads, and is never looked up)
+    if ((placed > 0) && !stop)
+    {
+        MarkDead(key);
+        worker.stats.deadStates++;
+    }
+    return false;
+}
+
+/*Searches for placements of pieceIds (in this order) on field that clear it completely (targetLines <= 0) or that clear
+  targetLines lines. On success, the placements and move sequences are stored into solution and solutionMoves*/
+SolverResult PentrisSolver::Solve(const PentrisField& field, const std::vector<int>& pieceIds, const int lineTarget)
+{
+    auto started = std::chrono::steady_clock::now();
+    deadline = started + std::chrono::milliseconds(timeLimitMs);
+    pieces = pieceIds;
+    targetLines = lineTarget;
+    solution.clear();
+    solutionMoves.clear();
+    solutionLines = 0;
+    solved = false;
+    stop = false;
+    timedOut = false;
+    nextRootChild = 0;
+    nodesSearched = 0;
+    for (auto& shard : memo)
+        shard.dead.clear();
+    stats = SolverStats();
+    stats.threads = (threads > 0) ? threads : std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (unsigned i = 0; i < stats.threads; i++)
+    {
+        workers.emplace_back(new Worker());
+        workers[i]->candidates.resize(pieces.size() + 1);
+        workers[i]->children.resize(pieces.size() + 1);
+        workers[i]->fields.resize(pieces.size() + 1, field);
+        workers[i]->path.resize(pieces.size() + 1);
+    }
+    std::vector<std::thread> searchThreads;
+    for (unsigned i = 1; i < stats.threads; i++)
+        searchThreads.emplace_back(&PentrisSolver::Solve_Recursive, this, std::ref(*workers[i]), std::cref(field), 0, 0);
+    Solve_Recursive(*workers[0], field, 0, 0);
+    for (auto& thread : searchThreads)
+        thread.join();
+
+    for (const auto& worker : workers)
+    {
+        stats.nodes += worker->stats.nodes;
+        stats.prunedArea += worker->stats.prunedArea;
+        stats.prunedParity += worker->stats.prunedParity;
+        stats.memoHits += worker->stats.memoHits;
+        stats.deadStates += worker->stats.deadStates;
+    }
+    stats.wallTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    if (solved)
+        return SolverResult::SOLVED;
+    return timedOut ? SolverResult::ABORTED : SolverResult::NO_SOLUTION;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "PentrisField.h"
+#include "PentrisAI.h"
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+#include <chrono>
+#include <cstdint>
+
+//ABORTED: the time or node budget ran out before the search was decided, so whether there is a solution is unknown
+enum class SolverResult { SOLVED, NO_SOLUTION, ABORTED };
+
+/*Statistics of one solver run, summed over all threads*/
+struct SolverStats {
+    unsigned threads = 0;
+    //Fields visited by the depth-first search
+    std::uint64_t nodes = 0;
+    //Fields cut off by the area and parity bounds, and by the memo of dead fields
+    std::uint64_t prunedArea = 0;
+    std::uint64_t prunedParity = 0;
+    std::uint64_t memoHits = 0;
+    std::uint64_t deadStates = 0;
+    double wallTimeMs = 0.0;
+};
+
+/*Puzzle mode: given a field and a fixed sequence of pentominos, searches for placements that clear the field completely
+  (a perfect clear) or that clear a target number of lines. Unlike PentrisAI, which greedily maximises a heuristic, the
+  solver is exact: it either finds a solution or proves that there is none (given PentrisAI's set of reachable placements).
+  The search is a depth-first search over the placements of each pentomino, cut off by
+  - area: a perfect clear after m more pentominos needs the filled cells plus 5m to be a whole number of rows, at least as
+    many as the stack is high; n more lines need at least as many cells as the n rows with the fewest empty cells lack,
+  - parity: colouring the columns alternately, every row removes a fixed colour imbalance, and every pentomino changes the
+    imbalance by an odd amount of at most its largest column imbalance (which row clears cannot change),
+  - a memo of dead states (field hash, pentominos placed, lines cleared) shared by all threads.
+  Placements leading to the same field are searched once, and the rest are searched best first by PentrisAI::EvaluateField
+  (so that solvable puzzles are solved long before the search would be exhaustive).
+  The placements of the first pentomino are shared out among the threads.
+  Refuting an unsolvable puzzle takes an exhaustive search, which for a perfect clear with 10 or more pentominos on 10 cells
+  wide rows can run for minutes; the time budget (a few seconds by default) and the node budget turn that into an ABORTED
+  result instead*/
+class PentrisSolver
+{
+private:
+    /*A placement worth searching: its index in the enumeration, the lines it clears and the valuation of the field after it*/
+    struct Child {
+        int index = 0;
+        int lines = 0;
+        int eval = 0;
+    };
+    struct Worker {
+        PentrisAI ai;
+        //Per search depth: the placements of the pentomino, the ones left after pruning (best first), and the field being searched
+        std::vector<CandidateList> candidates;
+        std::vector<std::vector<Child>> children;
+        std::vector<PentrisField> fields;
+        PentrisField scratch;
+        std::vector<std::uint64_t> visited;
+        std::vector<int> rowEmpty;
+        //The index of the placement chosen at each depth
+        std::vector<int> path;
+        SolverStats stats;
+    };
+    //The largest column colour imbalance of each pentomino (over its orientations), by pentomino id
+    int maxImbalance[13] = {};
+    std::vector<int> pieces;
+    int targetLines = 0;
+    std::atomic<bool> solved{ false };
+    std::atomic<bool> stop{ false };
+    std::atomic<bool> timedOut{ false };
+    //The next placement of the first pentomino to be searched (the threads take turns)
+    std::atomic<int> nextRootChild{ 0 };
+    //Nodes searched by all threads, brought up to date every NODE_CHECK_INTERVAL nodes of each thread (see nodeLimit)
+    std::atomic<std::uint64_t> nodesSearched{ 0 };
+    static const int NODE_CHECK_INTERVAL = 1024;
+    std::chrono::steady_clock::time_point deadline;
+    std::mutex solutionMutex;
+    //Dead states, sharded to keep the threads from contending for a single lock
+    static const int MEMO_SHARDS = 64;
+    struct MemoShard {
+        std::mutex mutex;
+        std::unordered_set<std::uint64_t> dead;
+    };
+    MemoShard memo[MEMO_SHARDS];
+    bool IsDead(const std::uint64_t key);
+    void MarkDead(const std::uint64_t key);
+    static std::uint64_t StateKey(const PentrisField& field, const int placed, const int lines);
+    static int Place(PentrisField& field, const Placement& placement);
+    bool Feasible(const PentrisField& field, const int placed, const int lines, Worker& worker) const;
+    bool IsGoal(const PentrisField& field, const int lines) const;
+    void Expand(Worker& worker, const PentrisField& field, const int placed, const int lines);
+    bool Solve_Recursive(Worker& worker, const PentrisField& field, const int placed, const int lines);
+public:
+    //The number of threads (0: one per core)
+    unsigned threads = 0;
+    //Give up (ABORTED) after this many milliseconds (0: no limit)
+    int timeLimitMs = 5000;
+    //Give up (ABORTED) after about this many nodes over all threads (0: no limit); unlike the time limit, independent of the machine
+    std::uint64_t nodeLimit = 0;
+    //The solution: one placement and move sequence per pentomino placed, and the lines it clears
+    std::vector<Placement> solution;
+    std::vector<std::vector<MoveData>> solutionMoves;
+    int solutionLines = 0;
+    SolverStats stats;
+
+    PentrisSolver();
+    //Searches for a perfect clear (targetLines <= 0) or for targetLines cleared lines, placing the pentominos (ids 1-12) in order
+    SolverResult Solve(const PentrisField& field, const std::vector<int>& pieceIds, const int lineTarget = 0);
+};
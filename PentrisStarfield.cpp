@@ -0,0 +1,78 @@
+#include "PentrisStarfield.h"
+
+PentrisStarfield::PentrisStarfield() : rng(std::random_device{}())
+{
+}
+
+float PentrisStarfield::Random(float a, float b)
+{
+    return std::uniform_real_distribution<float>(a, b)(rng);
+}
+
+/*Places the star at index at a new random angle, speed, distance and luminance*/
+void PentrisStarfield::Respawn(const int index)
+{
+    float angle = Random(0.0f, 2.0f * 3.14159f);
+    dirX[index] = cosf(angle);
+    dirY[index] = sinf(angle);
+    speed[index] = Random(10.0f, 100.0f);
+    distance[index] = Random(20.0f, 200.0f);
+    lum[index] = Random(0.3f, 1.0f);
+}
+
+/*Sets the number of stars; newly added stars are spawned at random*/
+void PentrisStarfield::Resize(const int count)
+{
+    int oldCount = Count();
+    dirX.resize(count);
+    dirY.resize(count);
+    distance.resize(count);
+    speed.resize(count);
+    lum.resize(count);
+    for (int i = oldCount; i < count; i++)
+        Respawn(i);
+}
+
+/*Moves every star outwards. The first loop only touches contiguous float arrays and has no branches,
+  so the compiler can vectorise it; respawning is done in a separate (rarely taken) pass*/
+void PentrisStarfield::Update(float fElapsedTime)
+{
+    const int count = Count();
+    float* dist = distance.data();
+    const float* spd = speed.data();
+    const float scale = fElapsedTime / 100.0f;
+    for (int i = 0; i < count; i++)
+        dist[i] += spd[i] * scale * dist[i];
+    for (int i = 0; i < count; i++)
+        if (dist[i] > MAX_DISTANCE)
+            Respawn(i);
+}
+
+/*Writes each star as a small cross of pixels straight into the target's pixel buffer.
+  Brightness grows with distance (saturating at 1), matching the previous Draw + FillCircle look*/
+void PentrisStarfield::Draw(olc::Sprite* target, const olc::vf2d& origin) const
+{
+    if (target == nullptr)
+        return;
+    olc::Pixel* data = target->GetData();
+    const int width = target->width;
+    const int height = target->height;
+    const int count = Count();
+    for (int i = 0; i < count; i++)
+    {
+        int x = (int)(origin.x + dirX[i] * distance[i]);
+        int y = (int)(origin.y + dirY[i] * distance[i]);
+        //The cross spans one pixel in each direction
+        if ((x < 1) || (y < 1) || (x >= width - 1) || (y >= height - 1))
+            continue;
+        float brightness = std::min(1.0f, lum[i] * distance[i] / 100.0f);
+        uint8_t c = (uint8_t)(brightness * 255.0f);
+        olc::Pixel col(c, c, c);
+        olc::Pixel* p = data + x + y * width;
+        p[0] = col;
+        p[-1] = col;
+        p[1] = col;
+        p[-width] = col;
+        p[width] = col;
+    }
+}
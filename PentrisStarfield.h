@@ -0,0 +1,33 @@
+#pragma once
+
+#include "olcPixelGameEngine.h"
+#include <vector>
+#include <random>
+
+/*The background star effect, stored as a structure of arrays so that the per-frame update is a
+  straight loop over contiguous floats. Directions are unit vectors computed once per respawn,
+  and stars are written directly into the draw target rather than through Draw/FillCircle*/
+class PentrisStarfield
+{
+private:
+    //Unit direction of each star away from the origin (constant until the star respawns)
+    std::vector<float> dirX;
+    std::vector<float> dirY;
+    std::vector<float> distance;
+    std::vector<float> speed;
+    //Base luminance in [0, 1]; the drawn brightness scales with distance
+    std::vector<float> lum;
+    std::minstd_rand rng;
+
+    //Stars beyond this distance from the origin are respawned
+    const float MAX_DISTANCE = 800.0f;
+
+    float Random(float a, float b);
+    void Respawn(const int index);
+public:
+    PentrisStarfield();
+    void Resize(const int count);
+    int Count() const { return (int)distance.size(); };
+    void Update(float fElapsedTime);
+    void Draw(olc::Sprite* target, const olc::vf2d& origin) const;
+};
@@ -0,0 +1,568 @@
+#include "PentrisStream.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+    typedef SOCKET SocketHandle;
+    const int SEND_FLAGS = 0;
+
+    bool InitSockets()
+    {
+        static bool initialised = false;
+        if (!initialised)
+        {
+            WSADATA data;
+            initialised = (WSAStartup(MAKEWORD(2, 2), &data) == 0);
+        }
+        return initialised;
+    }
+    void CloseSocket(const std::intptr_t handle) { closesocket((SocketHandle)handle); }
+    bool SetNonBlocking(const std::intptr_t handle)
+    {
+        u_long enable = 1;
+        return ioctlsocket((SocketHandle)handle, FIONBIO, &enable) == 0;
+    }
+    bool WouldBlock() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+#else
+    typedef int SocketHandle;
+#ifdef MSG_NOSIGNAL
+    //A spectator hanging up must not kill the game with SIGPIPE
+    const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    const int SEND_FLAGS = 0;
+#endif
+
+    bool InitSockets() { return true; }
+    void CloseSocket(const std::intptr_t handle) { close((SocketHandle)handle); }
+    bool SetNonBlocking(const std::intptr_t handle)
+    {
+        const int flags = fcntl((SocketHandle)handle, F_GETFL, 0);
+        return (flags != -1) && (fcntl((SocketHandle)handle, F_SETFL, flags | O_NONBLOCK) == 0);
+    }
+    bool WouldBlock() { return (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR); }
+#endif
+
+    void PutVarint(std::vector<std::uint8_t>& out, std::uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back((std::uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((std::uint8_t)value);
+    }
+
+    std::uint32_t ZigZag(const int value) { return ((std::uint32_t)value << 1) ^ (std::uint32_t)(value >> 31); }
+    int UnZigZag(const std::uint32_t value) { return (int)(value >> 1) ^ -(int)(value & 1); }
+
+    void PutPlacement(std::vector<std::uint8_t>& out, const Placement& placement)
+    {
+        out.push_back((std::uint8_t)placement.pentominoId);
+        out.push_back((std::uint8_t)placement.orientation);
+        PutVarint(out, ZigZag(placement.posX));
+        PutVarint(out, ZigZag(placement.posY));
+    }
+
+    bool SamePlacement(const Placement& a, const Placement& b)
+    {
+        return (a.pentominoId == b.pentominoId) && (a.orientation == b.orientation) && (a.posX == b.posX) && (a.posY == b.posY);
+    }
+
+    /*Bounds checked reading of a frame*/
+    struct FrameReader {
+        const std::uint8_t* data;
+        size_t size;
+        size_t position = 0;
+        bool ok = true;
+
+        std::uint8_t Byte()
+        {
+            if (position >= size)
+            {
+                ok = false;
+                return 0;
+            }
+            return data[position++];
+        }
+        std::uint32_t Varint()
+        {
+            std::uint32_t value = 0;
+            for (int shift = 0; shift < 35; shift += 7)
+            {
+                const std::uint8_t byte = Byte();
+                value |= (std::uint32_t)(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                    return value;
+            }
+            ok = false;
+            return 0;
+        }
+        void ReadPlacement(Placement& placement)
+        {
+            placement.pentominoId = Byte();
+            placement.orientation = Byte();
+            placement.posX = UnZigZag(Varint());
+            placement.posY = UnZigZag(Varint());
+        }
+    };
+}
+
+void StreamFrame::Capture(const PentrisField& field)
+{
+    width = field.Width();
+    height = field.Height();
+    blocks.resize(field.blocks.size());
+    for (size_t i = 0; i < blocks.size(); i++)
+        blocks[i] = (std::uint8_t)field.blocks[i];
+    piece = field.CurrentPlacement();
+    nextPentominoId = field.PentominoId(field.nextPentomino);
+}
+
+bool PentrisStreamEncoder::Encode(const StreamFrame& frame, std::vector<std::uint8_t>& out, const bool forceKeyframe)
+{
+    using namespace PentrisStreamFormat;
+    const bool keyframe = forceKeyframe || !hasPrevious || (frame.width != previous.width) || (frame.height != previous.height) ||
+        (sinceKeyframe >= keyframeInterval);
+    std::uint8_t flags = KEYFRAME | ALL;
+    if (!keyframe)
+    {
+        flags = 0;
+        if (frame.blocks != previous.blocks)
+            flags |= CELLS;
+        if (!SamePlacement(frame.piece, previous.piece))
+            flags |= PIECE;
+        if (frame.nextPentominoId != previous.nextPentominoId)
+            flags |= NEXT;
+        if ((frame.score != previous.score) || (frame.lines != previous.lines) || (frame.games != previous.games))
+            flags |= SCORE;
+        if (!SamePlacement(frame.aiTarget, previous.aiTarget))
+            flags |= AI;
+        if (frame.gameOver != previous.gameOver)
+            flags |= GAME_OVER;
+    }
+    body.clear();
+    body.push_back(flags);
+    if (keyframe)
+    {
+        PutVarint(body, frame.width);
+        PutVarint(body, frame.height);
+        for (size_t i = 0; i < frame.blocks.size();)
+        {
+            size_t run = 1;
+            while ((i + run < frame.blocks.size()) && (frame.blocks[i + run] == frame.blocks[i]))
+                run++;
+            PutVarint(body, (std::uint32_t)run);
+            body.push_back(frame.blocks[i]);
+            i += run;
+        }
+    }
+    else if (flags & CELLS)
+    {
+        std::uint32_t changed = 0;
+        for (size_t i = 0; i < frame.blocks.size(); i++)
+            changed += (frame.blocks[i] != previous.blocks[i]);
+        PutVarint(body, changed);
+        size_t next = 0;
+        for (size_t i = 0; i < frame.blocks.size(); i++)
+            if (frame.blocks[i] != previous.blocks[i])
+            {
+                PutVarint(body, (std::uint32_t)(i - next));
+                body.push_back(frame.blocks[i]);
+                next = i + 1;
+            }
+    }
+    if (flags & PIECE)
+        PutPlacement(body, frame.piece);
+    if (flags & NEXT)
+        body.push_back((std::uint8_t)frame.nextPentominoId);
+    if (flags & SCORE)
+    {
+        PutVarint(body, frame.score);
+        PutVarint(body, frame.lines);
+        PutVarint(body, frame.games);
+    }
+    if (flags & AI)
+        PutPlacement(body, frame.aiTarget);
+    if (flags & GAME_OVER)
+        body.push_back(frame.gameOver ? 1 : 0);
+
+    PutVarint(out, (std::uint32_t)body.size());
+    out.insert(out.end(), body.begin(), body.end());
+    previous = frame;
+    hasPrevious = true;
+    sinceKeyframe = keyframe ? 1 : sinceKeyframe + 1;
+    return keyframe;
+}
+
+int PentrisStreamDecoder::Feed(const std::uint8_t* data, const size_t size)
+{
+    bytes += size;
+    buffer.insert(buffer.end(), data, data + size);
+    int decoded = 0;
+    for (;;)
+    {
+        //Read the length prefix (it may not have arrived completely yet)
+        size_t position = bufferStart;
+        std::uint32_t length = 0;
+        bool complete = false;
+        for (int shift = 0; (shift < 35) && (position < buffer.size()); shift += 7)
+        {
+            const std::uint8_t byte = buffer[position++];
+            length |= (std::uint32_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                complete = true;
+                break;
+            }
+        }
+        if (!complete || (buffer.size() - position < length))
+            break;
+        if (DecodeFrame(&buffer[position], length))
+            decoded++;
+        bufferStart = position + length;
+    }
+    //Drop the consumed bytes once they make up most of the buffer
+    if (bufferStart > buffer.size() / 2)
+    {
+        buffer.erase(buffer.begin(), buffer.begin() + bufferStart);
+        bufferStart = 0;
+    }
+    return decoded;
+}
+
+/*Applies one frame to the state in frame. Returns false if it had to be skipped (not synced yet, or malformed)*/
+bool PentrisStreamDecoder::DecodeFrame(const std::uint8_t* data, const size_t size)
+{
+    using namespace PentrisStreamFormat;
+    FrameReader reader{ data, size };
+    const std::uint8_t flags = reader.Byte();
+    const bool keyframe = (flags & KEYFRAME) != 0;
+    if (!keyframe && !synced)
+        return false;
+    if (keyframe)
+    {
+        const std::uint32_t width = reader.Varint();
+        const std::uint32_t height = reader.Varint();
+        //The dimensions come off the wire: bound them before allocating
+        if (!reader.ok || (width > (std::uint32_t)PentrisField::MAX_WIDTH) || (height > (std::uint32_t)PentrisField::MAX_HEIGHT))
+        {
+            errors++;
+            synced = false;
+            return false;
+        }
+        frame.width = (int)width;
+        frame.height = (int)height;
+        const size_t cells = (size_t)frame.width * frame.height;
+        frame.blocks.assign(cells, 0);
+        for (size_t i = 0; reader.ok && (i < cells);)
+        {
+            const size_t run = reader.Varint();
+            const std::uint8_t value = reader.Byte();
+            if ((run == 0) || (i + run > cells))
+                reader.ok = false;
+            else
+                std::fill(frame.blocks.begin() + i, frame.blocks.begin() + i + run, value);
+            i += run;
+        }
+    }
+    else if (flags & CELLS)
+    {
+        const std::uint32_t changed = reader.Varint();
+        size_t next = 0;
+        for (std::uint32_t c = 0; reader.ok && (c < changed); c++)
+        {
+            const size_t i = next + reader.Varint();
+            const std::uint8_t value = reader.Byte();
+            if (i >= frame.blocks.size())
+                reader.ok = false;
+            else
+                frame.blocks[i] = value;
+            next = i + 1;
+        }
+    }
+    if (flags & PIECE)
+        reader.ReadPlacement(frame.piece);
+    if (flags & NEXT)
+        frame.nextPentominoId = reader.Byte();
+    if (flags & SCORE)
+    {
+        frame.score = (int)reader.Varint();
+        frame.lines = (int)reader.Varint();
+        frame.games = (int)reader.Varint();
+    }
+    if (flags & AI)
+        reader.ReadPlacement(frame.aiTarget);
+    if (flags & GAME_OVER)
+        frame.gameOver = (reader.Byte() != 0);
+    if (!reader.ok)
+    {
+        //The state can no longer be trusted; wait for the next keyframe
+        errors++;
+        synced = false;
+        return false;
+    }
+    synced = true;
+    frames++;
+    keyframes += keyframe;
+    return true;
+}
+
+PentrisStreamServer::~PentrisStreamServer()
+{
+    Close();
+}
+
+bool PentrisStreamServer::ListenTCP(const std::uint16_t port)
+{
+    Close();
+    if (!InitSockets())
+        return false;
+    SocketHandle handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if ((std::intptr_t)handle == -1)
+        return false;
+    listenSocket = (std::intptr_t)handle;
+    int reuse = 1;
+    setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((bind(handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) || (listen(handle, 8) != 0) || !SetNonBlocking(listenSocket))
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool PentrisStreamServer::ListenUnix(const std::string& path)
+{
+    Close();
+#ifdef _WIN32
+    (void)path;
+    return false;
+#else
+    sockaddr_un address = {};
+    if (path.size() >= sizeof(address.sun_path))
+        return false;
+    SocketHandle handle = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (handle == -1)
+        return false;
+    listenSocket = handle;
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    //A socket file left behind by an earlier run would make bind fail
+    unlink(path.c_str());
+    if ((bind(handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) || (listen(handle, 8) != 0) || !SetNonBlocking(listenSocket))
+    {
+        Close();
+        return false;
+    }
+    unixPath = path;
+    return true;
+#endif
+}
+
+void PentrisStreamServer::Close()
+{
+    for (auto& spectator : spectators)
+        CloseSocket(spectator.socket);
+    spectators.clear();
+    if (listenSocket != -1)
+        CloseSocket(listenSocket);
+    listenSocket = -1;
+#ifndef _WIN32
+    if (!unixPath.empty())
+        unlink(unixPath.c_str());
+#endif
+    unixPath.clear();
+    encoder.Reset();
+}
+
+void PentrisStreamServer::AcceptSpectators()
+{
+    for (;;)
+    {
+        SocketHandle handle = accept((SocketHandle)listenSocket, nullptr, nullptr);
+        if ((std::intptr_t)handle == -1)
+            return;
+        Spectator spectator;
+        spectator.socket = (std::intptr_t)handle;
+        if (!SetNonBlocking(spectator.socket))
+        {
+            CloseSocket(spectator.socket);
+            continue;
+        }
+        //Frames are tiny and latency matters more than packet count (fails harmlessly on Unix domain sockets)
+        int noDelay = 1;
+        setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+        spectators.push_back(std::move(spectator));
+    }
+}
+
+/*Sends as much of the spectator's backlog as the socket takes without waiting. Returns false if the connection is gone*/
+bool PentrisStreamServer::Send(Spectator& spectator)
+{
+    size_t sent = 0;
+    while (sent < spectator.backlog.size())
+    {
+        const int result = (int)send((SocketHandle)spectator.socket, reinterpret_cast<const char*>(spectator.backlog.data() + sent),
+            (int)(spectator.backlog.size() - sent), SEND_FLAGS);
+        if (result < 0)
+        {
+            if (!WouldBlock())
+                return false;
+            break;
+        }
+        sent += result;
+    }
+    bytesSent += sent;
+    spectator.headSent += sent;
+    while (!spectator.frameSizes.empty() && (spectator.headSent >= spectator.frameSizes.front()))
+    {
+        spectator.headSent -= spectator.frameSizes.front();
+        spectator.frameSizes.pop_front();
+    }
+    spectator.backlog.erase(spectator.backlog.begin(), spectator.backlog.begin() + sent);
+    return true;
+}
+
+void PentrisStreamServer::Publish(const StreamFrame& frame)
+{
+    if (!IsOpen())
+        return;
+    AcceptSpectators();
+    if (spectators.empty())
+    {
+        //Whoever connects next starts with a keyframe anyway
+        encoder.Reset();
+        return;
+    }
+    bool forceKeyframe = keyframeRequested;
+    for (const auto& spectator : spectators)
+        forceKeyframe = forceKeyframe || spectator.awaitingKeyframe;
+    keyframeRequested = false;
+    encoded.clear();
+    const bool keyframe = encoder.Encode(frame, encoded, forceKeyframe);
+    framesPublished++;
+    for (size_t i = 0; i < spectators.size();)
+    {
+        Spectator& spectator = spectators[i];
+        if (spectator.awaitingKeyframe && keyframe)
+            spectator.awaitingKeyframe = false;
+        if (!spectator.awaitingKeyframe)
+        {
+            if (spectator.backlog.size() + encoded.size() > maxBacklogBytes)
+            {
+                //The spectator cannot keep up: drop its backlog (except the rest of a frame it has partly received)
+                //and let it resume at the next keyframe
+                const size_t keep = (spectator.headSent > 0) ? spectator.frameSizes.front() - spectator.headSent : 0;
+                spectator.backlog.resize(keep);
+                spectator.frameSizes.resize((keep > 0) ? 1 : 0);
+                spectator.awaitingKeyframe = true;
+                keyframeRequested = true;
+                resyncs++;
+            }
+            else
+            {
+                spectator.backlog.insert(spectator.backlog.end(), encoded.begin(), encoded.end());
+                spectator.frameSizes.push_back(encoded.size());
+            }
+        }
+        if (!Send(spectator))
+        {
+            CloseSocket(spectator.socket);
+            spectators.erase(spectators.begin() + i);
+            continue;
+        }
+        i++;
+    }
+}
+
+PentrisStreamClient::~PentrisStreamClient()
+{
+    Close();
+}
+
+bool PentrisStreamClient::ConnectTCP(const std::string& host, const std::uint16_t port)
+{
+    Close();
+    if (!InitSockets())
+        return false;
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, (host == "localhost") ? "127.0.0.1" : host.c_str(), &address.sin_addr) != 1)
+        return false;
+    SocketHandle handle = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if ((std::intptr_t)handle == -1)
+        return false;
+    socket = (std::intptr_t)handle;
+    if (connect(handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool PentrisStreamClient::ConnectUnix(const std::string& path)
+{
+    Close();
+#ifdef _WIN32
+    (void)path;
+    return false;
+#else
+    sockaddr_un address = {};
+    if (path.size() >= sizeof(address.sun_path))
+        return false;
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    SocketHandle handle = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (handle == -1)
+        return false;
+    socket = handle;
+    if (connect(handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        Close();
+        return false;
+    }
+    return true;
+#endif
+}
+
+void PentrisStreamClient::Close()
+{
+    if (socket != -1)
+        CloseSocket(socket);
+    socket = -1;
+}
+
+int PentrisStreamClient::Receive(PentrisStreamDecoder& decoder)
+{
+    if (socket == -1)
+        return 0;
+    std::uint8_t data[4096];
+    const int received = (int)recv((SocketHandle)socket, reinterpret_cast<char*>(data), sizeof(data), 0);
+    if (received <= 0)
+        return 0;
+    decoder.Feed(data, received);
+    return received;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "PentrisField.h"
+#include <vector>
+#include <deque>
+#include <string>
+#include <cstdint>
+
+/*Live state stream format. The stream is a sequence of frames, each prefixed by its length (a LEB128 varint):
+    Flags byte:   KEYFRAME | which of the sections below follow
+    Cells:        keyframe: field width, field height, then the blocks as runs (run length varint, block value byte)
+                  otherwise: number of changed blocks, then per block the gap since the previous change (varint) and its value
+    Piece:        pentomino id, orientation, posX and posY (zigzag varints)
+    Next:         next pentomino id
+    Score:        score, lines, games
+    AI:           the placement the AI is heading for, like the piece (pentomino id 0: none)
+    Game over:    0 or 1
+  A delta frame only holds the sections that changed since the previous frame, so a tick in which nothing moved costs two
+  bytes. A keyframe holds every section; clients can only start decoding at a keyframe*/
+namespace PentrisStreamFormat
+{
+    const std::uint8_t KEYFRAME = 0x80;
+    const std::uint8_t CELLS = 0x01;
+    const std::uint8_t PIECE = 0x02;
+    const std::uint8_t NEXT = 0x04;
+    const std::uint8_t SCORE = 0x08;
+    const std::uint8_t AI = 0x10;
+    const std::uint8_t GAME_OVER = 0x20;
+    const std::uint8_t ALL = 0x3F;
+}
+
+/*The state of the game shown to spectators in one tick*/
+struct StreamFrame {
+    int width = 0;
+    int height = 0;
+    std::vector<std::uint8_t> blocks;
+    Placement piece;
+    int nextPentominoId = 0;
+    int score = 0;
+    int lines = 0;
+    int games = 0;
+    Placement aiTarget;
+    bool gameOver = false;
+
+    //Copies the field's blocks, current and next pentomino (the counters and the AI target are set by the caller)
+    void Capture(const PentrisField& field);
+};
+
+/*Turns frames into the byte stream, each frame delta-encoded against the previous one.
+  A keyframe is written every keyframeInterval frames, when the field size changes or when one is forced*/
+class PentrisStreamEncoder
+{
+private:
+    StreamFrame previous;
+    bool hasPrevious = false;
+    int sinceKeyframe = 0;
+    std::vector<std::uint8_t> body;
+public:
+    int keyframeInterval = 600;
+    //Appends the encoded, length-prefixed frame to out; returns true if it is a keyframe
+    bool Encode(const StreamFrame& frame, std::vector<std::uint8_t>& out, const bool forceKeyframe = false);
+    void Reset() { hasPrevious = false; };
+};
+
+/*Rebuilds the frames from the byte stream, which may arrive in pieces of any size*/
+class PentrisStreamDecoder
+{
+private:
+    std::vector<std::uint8_t> buffer;
+    size_t bufferStart = 0;
+    bool synced = false;
+    bool DecodeFrame(const std::uint8_t* data, const size_t size);
+public:
+    //The most recently decoded state
+    StreamFrame frame;
+    std::uint64_t frames = 0;
+    std::uint64_t keyframes = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t errors = 0;
+    //Feeds received bytes; returns the number of frames completed (frame then holds the latest one)
+    int Feed(const std::uint8_t* data, const size_t size);
+    //True once a keyframe has been decoded (delta frames before it are skipped)
+    bool Synced() const { return synced; };
+};
+
+/*Publishes the stream to any number of spectators on a local TCP port or Unix domain socket.
+  Everything is non-blocking and runs on the caller's thread: Publish accepts new spectators, encodes the frame and hands
+  each spectator as much as its socket takes right now. Whatever a spectator cannot take is kept in its backlog; a
+  spectator whose backlog outgrows maxBacklogBytes loses the backlog and resumes at the next keyframe, so a slow
+  consumer costs memory up to that bound but never stalls the game loop*/
+class PentrisStreamServer
+{
+private:
+    struct Spectator {
+        std::intptr_t socket = -1;
+        std::vector<std::uint8_t> backlog;
+        //The sizes of the frames in the backlog, and how much of the first one has been sent already
+        std::deque<size_t> frameSizes;
+        size_t headSent = 0;
+        //Frames are withheld until the next keyframe (new spectators, and those whose backlog was dropped)
+        bool awaitingKeyframe = true;
+    };
+    std::intptr_t listenSocket = -1;
+    std::string unixPath;
+    std::vector<Spectator> spectators;
+    PentrisStreamEncoder encoder;
+    std::vector<std::uint8_t> encoded;
+    bool keyframeRequested = false;
+    void AcceptSpectators();
+    bool Send(Spectator& spectator);
+public:
+    size_t maxBacklogBytes = 64 * 1024;
+    std::uint64_t framesPublished = 0;
+    std::uint64_t bytesSent = 0;
+    std::uint64_t resyncs = 0;
+
+    ~PentrisStreamServer();
+    //Listens on 127.0.0.1:port
+    bool ListenTCP(const std::uint16_t port);
+    //Listens on a Unix domain socket at path (not available on Windows)
+    bool ListenUnix(const std::string& path);
+    void Close();
+    bool IsOpen() const { return listenSocket != -1; };
+    size_t Spectators() const { return spectators.size(); };
+    void SetKeyframeInterval(const int frames) { encoder.keyframeInterval = frames; };
+    void Publish(const StreamFrame& frame);
+};
+
+/*A spectator's end of the stream (blocking), used by the stream client tool*/
+class PentrisStreamClient
+{
+private:
+    std::intptr_t socket = -1;
+public:
+    ~PentrisStreamClient();
+    bool ConnectTCP(const std::string& host, const std::uint16_t port);
+    bool ConnectUnix(const std::string& path);
+    void Close();
+    //Waits for data and feeds it to decoder; returns the number of bytes received (0 once the server has closed the stream)
+    int Receive(PentrisStreamDecoder& decoder);
+};
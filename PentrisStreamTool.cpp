@@ -0,0 +1,134 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include "PentrisStream.h"
+#include "PentrisSimulation.h"
+
+/*Spectator and test server for the live state stream (see PentrisStream.h).
+  Usage:
+    PentrisStreamTool watch tcp <port> [every]   connects to the game (127.0.0.1) and draws the reconstructed board
+    PentrisStreamTool watch unix <path> [every]  every: draw every n-th frame (default 60)
+    PentrisStreamTool serve tcp <port> [tps]     streams headless AI games at tps ticks per second (default 60),
+    PentrisStreamTool serve unix <path> [tps]    placing a pentomino every 10 ticks; reports the bandwidth*/
+
+namespace
+{
+    void DrawFrame(const StreamFrame& frame, const PentrisField& shapes)
+    {
+        std::vector<char> cells(frame.blocks.size());
+        for (size_t i = 0; i < frame.blocks.size(); i++)
+            cells[i] = (frame.blocks[i] == 0) ? '.' : (frame.blocks[i] == shapes.FILLEDROW) ? '*' : (frame.blocks[i] == shapes.WALL) ? '|' : '#';
+        //Overlay the AI's target and the falling pentomino
+        auto Overlay = [&](const Placement& placement, char symbol)
+        {
+            if ((placement.pentominoId < 1) || (placement.pentominoId > 12))
+                return;
+            const std::vector<int> pentomino = shapes.OrientPentomino(placement.pentominoId, placement.orientation);
+            for (int j = 0; j < shapes.PENTOMINO_WIDTH; j++)
+                for (int i = 0; i < shapes.PENTOMINO_WIDTH; i++)
+                {
+                    const int x = placement.posX + i;
+                    const int y = placement.posY + j;
+                    if ((pentomino[i + j * shapes.PENTOMINO_WIDTH] != 0) && (x >= 0) && (x < frame.width) && (y >= 0) && (y < frame.height))
+                        cells[x + y * frame.width] = symbol;
+                }
+        };
+        Overlay(frame.aiTarget, 'x');
+        Overlay(frame.piece, 'o');
+        for (int y = 0; y < frame.height; y++)
+            std::cout << std::string(cells.begin() + y * frame.width, cells.begin() + (y + 1) * frame.width) << std::endl;
+        std::cout << "Score " << frame.score << ", lines " << frame.lines << ", games " << frame.games << ", next " << frame.nextPentominoId
+            << (frame.gameOver ? ", GAME OVER" : "") << std::endl;
+    }
+
+    int Watch(PentrisStreamClient& client, const int every)
+    {
+        PentrisStreamDecoder decoder;
+        PentrisField shapes;
+        std::uint64_t lastDrawn = 0;
+        while (client.Receive(decoder) > 0)
+        {
+            if (decoder.Synced() && (decoder.frames >= lastDrawn + every))
+            {
+                lastDrawn = decoder.frames;
+                DrawFrame(decoder.frame, shapes);
+                std::cout << decoder.frames << " frames (" << decoder.keyframes << " keyframes), " << decoder.bytes << " bytes, "
+                    << (double)decoder.bytes / decoder.frames << " bytes per frame" << std::endl << std::endl;
+            }
+        }
+        std::cout << "Stream closed after " << decoder.frames << " frames, " << decoder.bytes << " bytes, " << decoder.errors << " errors" << std::endl;
+        return 0;
+    }
+
+    int Serve(PentrisStreamServer& server, const int ticksPerSecond)
+    {
+        PentrisSimulation simulation;
+        StreamFrame frame;
+        int games = 0;
+        simulation.Reset((std::uint32_t)std::rand());
+        auto reported = std::chrono::steady_clock::now();
+        std::uint64_t reportedBytes = 0, reportedFrames = 0;
+        for (std::uint64_t tick = 1;; tick++)
+        {
+            if (tick % 10 == 0)
+            {
+                if (simulation.IsOver())
+                {
+                    games++;
+                    simulation.Reset((std::uint32_t)std::rand());
+                }
+                else
+                    simulation.Step();
+            }
+            frame.Capture(simulation.Field());
+            frame.score = simulation.Score();
+            frame.lines = simulation.Lines();
+            frame.games = games;
+            frame.gameOver = simulation.IsOver();
+            server.Publish(frame);
+            std::this_thread::sleep_for(std::chrono::microseconds(1000000 / ticksPerSecond));
+            if (std::chrono::steady_clock::now() - reported > std::chrono::seconds(5))
+            {
+                const std::uint64_t frames = server.framesPublished - reportedFrames;
+                std::cout << server.Spectators() << " spectators, " << frames << " frames, "
+                    << ((frames > 0) ? (double)(server.bytesSent - reportedBytes) / frames : 0.0) << " bytes per frame sent, "
+                    << server.resyncs << " resyncs" << std::endl;
+                reported = std::chrono::steady_clock::now();
+                reportedBytes = server.bytesSent;
+                reportedFrames = server.framesPublished;
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if ((argc < 4) || ((std::strcmp(argv[1], "watch") != 0) && (std::strcmp(argv[1], "serve") != 0)) ||
+        ((std::strcmp(argv[2], "tcp") != 0) && (std::strcmp(argv[2], "unix") != 0)))
+    {
+        std::cout << "Usage: " << argv[0] << " watch tcp <port> [every] | watch unix <path> [every] | serve tcp <port> [tps] | serve unix <path> [tps]" << std::endl;
+        return 1;
+    }
+    const bool tcp = (std::strcmp(argv[2], "tcp") == 0);
+    if (std::strcmp(argv[1], "watch") == 0)
+    {
+        PentrisStreamClient client;
+        if (!(tcp ? client.ConnectTCP("127.0.0.1", (std::uint16_t)std::atoi(argv[3])) : client.ConnectUnix(argv[3])))
+        {
+            std::cout << "Could not connect to " << argv[3] << std::endl;
+            return 1;
+        }
+        return Watch(client, (argc > 4) ? std::max(1, std::atoi(argv[4])) : 60);
+    }
+    PentrisStreamServer server;
+    if (!(tcp ? server.ListenTCP((std::uint16_t)std::atoi(argv[3])) : server.ListenUnix(argv[3])))
+    {
+        std::cout << "Could not listen on " << argv[3] << std::endl;
+        return 1;
+    }
+    return Serve(server, (argc > 4) ? std::max(1, std::atoi(argv[4])) : 60);
+}
@@ -0,0 +1,251 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include "PentrisSimulation.h"
+#include "PentrisEvaluator.h"
+
+/*AI-vs-AI tournament: two AI configurations play the same seeded piece streams (game i uses the same seed for both),
+  games run in parallel on all cores, and a sequential probability ratio test on the paired differences stops the
+  tournament as soon as the result is significant.
+  Usage: PentrisTournamentTool <config A> <config B> [options]
+    A config is a comma separated list of settings (or "default" for the built-in heuristic at depth 1):
+        depth=<0|1>       search depth
+        weights=<file>    trained linear evaluator (see PentrisTrainTool)
+        features=<file>   feature evaluator with the weights in file ("default" for its default weights)
+        mcts=<ms>         Monte Carlo tree search with this budget per move (one tree per game)
+    Options:
+        --metric lines|score   what is compared (default lines)
+        --delta <d>            the difference per game worth detecting (default 5 lines or 1000 points)
+        --alpha <a> --beta <b> error rates of the test (default 0.05 each)
+        --max-games <n>        give up without a verdict after n games (default 2000)
+        --max-pieces <n>       cap on the length of a game (default 2000)
+        --threads <n>          default: one per core
+        --width <w> --height <h> field size (default 18x35)*/
+
+namespace
+{
+    struct PlayerConfig {
+        std::string description;
+        unsigned char depth = 1;
+        std::shared_ptr<const PentrisEvaluator> evaluator;
+        int mctsBudgetMs = 0;
+    };
+
+    bool ParseConfig(const std::string& text, const int width, const int height, PlayerConfig& config)
+    {
+        config.description = text;
+        if (text == "default")
+            return true;
+        std::stringstream stream(text);
+        std::string setting;
+        while (std::getline(stream, setting, ','))
+        {
+            size_t separator = setting.find('=');
+            if (separator == std::string::npos)
+                return false;
+            std::string key = setting.substr(0, separator);
+            std::string value = setting.substr(separator + 1);
+            if (key == "depth")
+                config.depth = (unsigned char)std::atoi(value.c_str());
+            else if (key == "mcts")
+                config.mctsBudgetMs = std::atoi(value.c_str());
+            else if (key == "weights")
+            {
+                auto evaluator = std::make_shared<PentrisLinearEvaluator>(width, height);
+                if (!evaluator->Load(value))
+                {
+                    std::cout << "Could not load weights " << value << " for a " << width << "x" << height << " field" << std::endl;
+                    return false;
+                }
+                config.evaluator = evaluator;
+            }
+            else if (key == "features")
+            {
+                auto evaluator = std::make_shared<PentrisFeatureEvaluator>();
+                if ((value != "default") && !evaluator->Load(value))
+                {
+                    std::cout << "Could not load feature weights " << value << std::endl;
+                    return false;
+                }
+                config.evaluator = evaluator;
+            }
+            else
+                return false;
+        }
+        return true;
+    }
+
+    struct GameResult {
+        bool done = false;
+        double a = 0;
+        double b = 0;
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cout << "Usage: " << argv[0] << " <config A> <config B> [--metric lines|score] [--delta d] [--alpha a] [--beta b]"
+            << " [--max-games n] [--max-pieces n] [--threads n] [--width w] [--height h]" << std::endl;
+        std::cout << "  config: default, or comma separated depth=<0|1>, weights=<file>, features=<file|default>, mcts=<ms>" << std::endl;
+        return 1;
+    }
+    bool scoreMetric = false;
+    double delta = -1, alpha = 0.05, beta = 0.05;
+    int maxGames = 2000, maxPieces = 2000, width = 18, height = 35;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 3; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--metric") == 0)
+            scoreMetric = (std::strcmp(argv[i + 1], "score") == 0);
+        else if (std::strcmp(argv[i], "--delta") == 0)
+            delta = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--alpha") == 0)
+            alpha = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--beta") == 0)
+            beta = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--max-games") == 0)
+            maxGames = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--max-pieces") == 0)
+            maxPieces = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--threads") == 0)
+            threads = std::max(1, std::atoi(argv[i + 1]));
+        else if (std::strcmp(argv[i], "--width") == 0)
+            width = std::atoi(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--height") == 0)
+            height = std::atoi(argv[i + 1]);
+        else
+        {
+            std::cout << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if (delta <= 0)
+        delta = scoreMetric ? 1000.0 : 5.0;
+    PlayerConfig players[2];
+    for (int p = 0; p < 2; p++)
+        if (!ParseConfig(argv[1 + p], width, height, players[p]))
+        {
+            std::cout << "Invalid config " << argv[1 + p] << std::endl;
+            return 1;
+        }
+
+    //Two one-sided tests on the mean paired difference d = A - B, using the normal approximation with the sample variance:
+    //"A is better by delta" against "no difference", and "B is better by delta" against "no difference".
+    //The log likelihood ratio of mean delta against mean 0 after n games with sum S is delta / variance * (S - n * delta / 2)
+    const double upperBound = std::log((1 - beta) / alpha);
+    const double lowerBound = std::log(beta / (1 - alpha));
+    //The variance estimate is too unreliable before this many games
+    const int MIN_GAMES = 16;
+
+    std::vector<GameResult> results(maxGames);
+    std::mutex resultsMutex;
+    std::atomic<int> nextGame{ 0 };
+    std::atomic<bool> stop{ false };
+    int consumed = 0;
+    double sum = 0, sumSquares = 0, sumA = 0, sumB = 0;
+    //+1: A is better, -1: B is better, 0: neither by delta; 2 while undecided
+    int verdict = 2;
+    bool upperOpen = true, lowerOpen = true;
+    auto started = std::chrono::steady_clock::now();
+
+    //Consumes finished games in index order (so the verdict does not depend on the thread timing); called under resultsMutex
+    auto Consume = [&]()
+    {
+        while ((consumed < maxGames) && results[consumed].done && (verdict == 2))
+        {
+            double d = results[consumed].a - results[consumed].b;
+            sum += d;
+            sumSquares += d * d;
+            sumA += results[consumed].a;
+            sumB += results[consumed].b;
+            consumed++;
+            if (consumed < MIN_GAMES)
+                continue;
+            double mean = sum / consumed;
+            double variance = std::max(sumSquares / consumed - mean * mean, 1e-9);
+            double llrUpper = delta / variance * (sum - consumed * delta / 2);
+            double llrLower = delta / variance * (-sum - consumed * delta / 2);
+            if (upperOpen && (llrUpper >= upperBound))
+                verdict = 1;
+            else if (lowerOpen && (llrLower >= upperBound))
+                verdict = -1;
+            if (llrUpper <= lowerBound)
+                upperOpen = false;
+            if (llrLower <= lowerBound)
+                lowerOpen = false;
+            if (!upperOpen && !lowerOpen && (verdict == 2))
+                verdict = 0;
+            if (consumed % 50 == 0)
+                std::cout << consumed << " games: " << sumA / consumed << " vs " << sumB / consumed << ", LLR A>B " << llrUpper
+                    << ", B>A " << llrLower << " (bounds " << lowerBound << ", " << upperBound << ")" << std::endl;
+        }
+        if (verdict != 2)
+            stop = true;
+    };
+
+    auto Worker = [&]()
+    {
+        PentrisSimulation simulations[2] = { PentrisSimulation(width, height), PentrisSimulation(width, height) };
+        for (int p = 0; p < 2; p++)
+        {
+            simulations[p].searchDepth = players[p].depth;
+            simulations[p].maxPieces = maxPieces;
+            simulations[p].SetEvaluator(players[p].evaluator);
+            if (players[p].mctsBudgetMs > 0)
+                simulations[p].AI().EnableMCTS(players[p].mctsBudgetMs, 1);
+        }
+        while (!stop)
+        {
+            int game = nextGame++;
+            if (game >= maxGames)
+                break;
+            std::uint32_t seed = 0x9E3779B9u * (game + 1);
+            double outcome[2];
+            for (int p = 0; p < 2; p++)
+            {
+                simulations[p].PlayGame(seed);
+                outcome[p] = scoreMetric ? simulations[p].Score() : simulations[p].Lines();
+            }
+            std::lock_guard<std::mutex> lock(resultsMutex);
+            results[game].a = outcome[0];
+            results[game].b = outcome[1];
+            results[game].done = true;
+            Consume();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < threads; i++)
+        workers.emplace_back(Worker);
+    for (auto& worker : workers)
+        worker.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "A: " << players[0].description << std::endl << "B: " << players[1].description << std::endl;
+    std::cout << consumed << " game pairs in " << std::fixed << std::setprecision(1) << seconds << " s on " << threads << " threads ("
+        << seconds * threads / 3600 << " CPU hours)" << std::endl;
+    if (consumed > 0)
+        std::cout << "Mean " << (scoreMetric ? "score" : "lines") << " per game: A " << sumA / consumed << ", B " << sumB / consumed
+            << ", difference " << sum / consumed << std::endl;
+    if (verdict == 1)
+        std::cout << "Verdict: A is stronger (by at least " << delta << " per game)" << std::endl;
+    else if (verdict == -1)
+        std::cout << "Verdict: B is stronger (by at least " << delta << " per game)" << std::endl;
+    else if (verdict == 0)
+        std::cout << "Verdict: no difference of " << delta << " per game" << std::endl;
+    else
+        std::cout << "No verdict after " << consumed << " games" << std::endl;
+    return 0;
+}
@@ -0,0 +1,271 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include "PentrisSimulation.h"
+#include "PentrisEvaluator.h"
+#include "PentrisReplay.h"
+
+/*Offline training of the linear evaluator (see PentrisLinearEvaluator).
+  Usage:
+    PentrisTrainTool selfplay <replay file> <games> [weights file] [max pieces]
+        Lets the AI play games on a standard field (with the built-in heuristic, or with the given weights) and records them
+    PentrisTrainTool fit <weights file> <replay file> [discount] [game over penalty]
+        Fits the weights to the recorded games: the value of the field after each placement is the discounted number
+        of lines cleared from that placement on, minus the penalty (in lines) if the game is lost
+    PentrisTrainTool tune <weights file> [iterations] [initial weights file]
+        Improves the weights by self-play with the cross-entropy method: each iteration plays the same games with a population
+        of weight vectors drawn around the current mean and moves the mean to the best of them (starting from the
+        built-in heuristic, or from the given weights)*/
+
+namespace
+{
+    const int FIELD_WIDTH = 18;
+    const int FIELD_HEIGHT = 35;
+    //Evaluation units per line
+    const double EVAL_SCALE = 100.0;
+    //Regularisation of the least squares fit
+    const double RIDGE = 1e-3;
+
+    //Cross-entropy method parameters: population per iteration, how many of them are kept, games per weight vector
+    const int TUNE_POPULATION = 32;
+    const int TUNE_ELITE = 8;
+    const int TUNE_GAMES = 4;
+    const int TUNE_MAX_PIECES = 1000;
+
+    int SelfPlay(const std::string& replayPath, const int games, const std::string& weightsPath, const int maxPieces)
+    {
+        PentrisRecorder recorder;
+        if (!recorder.Open(replayPath))
+        {
+            std::cout << "Could not open replay file " << replayPath << std::endl;
+            return 1;
+        }
+        PentrisSimulation simulation(FIELD_WIDTH, FIELD_HEIGHT);
+        if (!weightsPath.empty())
+        {
+            auto evaluator = std::make_shared<PentrisLinearEvaluator>(FIELD_WIDTH, FIELD_HEIGHT);
+            if (!evaluator->Load(weightsPath))
+            {
+                std::cout << "Could not load weights " << weightsPath << std::endl;
+                return 1;
+            }
+            simulation.SetEvaluator(evaluator);
+        }
+        simulation.maxPieces = maxPieces;
+        simulation.SetRecorder(&recorder);
+        long long lines = 0, pieces = 0;
+        for (int game = 0; game < games; game++)
+        {
+            simulation.PlayGame((std::uint32_t)game * 2654435761u + 1);
+            lines += simulation.Lines();
+            pieces += simulation.Pieces();
+        }
+        std::cout << games << " games, " << (double)lines / games << " lines and " << (double)pieces / games << " pieces per game" << std::endl;
+        return 0;
+    }
+
+    /*Solves matrix * x = rhs (matrix is size x size, row major) by Gaussian elimination with partial pivoting*/
+    std::vector<double> Solve(std::vector<double> matrix, std::vector<double> rhs, const int size)
+    {
+        for (int col = 0; col < size; col++)
+        {
+            int pivot = col;
+            for (int row = col + 1; row < size; row++)
+                if (std::fabs(matrix[row * size + col]) > std::fabs(matrix[pivot * size + col]))
+                    pivot = row;
+            for (int k = 0; k < size; k++)
+                std::swap(matrix[col * size + k], matrix[pivot * size + k]);
+            std::swap(rhs[col], rhs[pivot]);
+            if (matrix[col * size + col] == 0)
+                continue;
+            for (int row = col + 1; row < size; row++)
+            {
+                double factor = matrix[row * size + col] / matrix[col * size + col];
+                for (int k = col; k < size; k++)
+                    matrix[row * size + k] -= factor * matrix[col * size + k];
+                rhs[row] -= factor * rhs[col];
+            }
+        }
+        std::vector<double> x(size, 0.0);
+        for (int row = size - 1; row >= 0; row--)
+        {
+            double sum = rhs[row];
+            for (int k = row + 1; k < size; k++)
+                sum -= matrix[row * size + k] * x[k];
+            x[row] = (matrix[row * size + row] != 0) ? sum / matrix[row * size + row] : 0.0;
+        }
+        return x;
+    }
+
+    int Fit(const std::string& weightsPath, const std::string& replayPath, const double discount, const double penalty)
+    {
+        PentrisReplayer replayer;
+        if (!replayer.Open(replayPath))
+        {
+            std::cout << "Could not open replay file " << replayPath << std::endl;
+            return 1;
+        }
+        const int size = PentrisLinearEvaluator::FeatureCount(FIELD_WIDTH);
+        std::vector<std::int16_t> features(PentrisLinearEvaluator::PaddedFeatureCount(FIELD_WIDTH));
+        //The normal equations of the least squares fit
+        std::vector<double> matrix(size * size, 0.0);
+        std::vector<double> rhs(size, 0.0);
+        //Features and lines of every placement of the game being replayed
+        std::vector<std::vector<std::int16_t>> gameFeatures;
+        std::vector<int> gameLines;
+        replayer.onPlacement = [&](const PentrisField& field, int newLinesFilled)
+        {
+            if ((field.Width() != FIELD_WIDTH) || (field.Height() != FIELD_HEIGHT))
+                return;
+            PentrisLinearEvaluator::ExtractFeatures(field, features.data());
+            gameFeatures.push_back(features);
+            gameLines.push_back(newLinesFilled);
+        };
+        PentrisField field;
+        ReplayResult result;
+        long long games = 0, samples = 0;
+        while (replayer.NextGame(result, field))
+        {
+            bool lost = !field.DoesPentominoFit(field.currentPentomino, field.pentominoX, field.pentominoY);
+            double value = lost ? -penalty : 0.0;
+            for (int t = (int)gameFeatures.size() - 1; t >= 0; t--)
+            {
+                value = gameLines[t] + discount * value;
+                const std::vector<std::int16_t>& x = gameFeatures[t];
+                for (int i = 0; i < size; i++)
+                {
+                    if (x[i] == 0)
+                        continue;
+                    rhs[i] += x[i] * value;
+                    for (int k = 0; k < size; k++)
+                        matrix[i * size + k] += (double)x[i] * x[k];
+                }
+            }
+            samples += gameFeatures.size();
+            gameFeatures.clear();
+            gameLines.clear();
+            games++;
+        }
+        if (samples == 0)
+        {
+            std::cout << "No placements on a " << FIELD_WIDTH << "x" << FIELD_HEIGHT << " field in " << replayPath << std::endl;
+            return 1;
+        }
+        for (int i = 0; i < size; i++)
+            matrix[i * size + i] += RIDGE * samples;
+        std::vector<double> weights = Solve(matrix, rhs, size);
+        for (auto& weight : weights)
+            weight *= EVAL_SCALE;
+        PentrisLinearEvaluator evaluator(FIELD_WIDTH, FIELD_HEIGHT);
+        evaluator.SetWeights(weights);
+        if (!evaluator.Save(weightsPath))
+        {
+            std::cout << "Could not write weights " << weightsPath << std::endl;
+            return 1;
+        }
+        std::cout << "Fitted " << size << " weights to " << samples << " placements of " << games << " games" << std::endl;
+        return 0;
+    }
+
+    int Tune(const std::string& weightsPath, const int iterations, const std::string& initialPath)
+    {
+        PentrisLinearEvaluator evaluator(FIELD_WIDTH, FIELD_HEIGHT);
+        if (!initialPath.empty() && !evaluator.Load(initialPath))
+        {
+            std::cout << "Could not load weights " << initialPath << std::endl;
+            return 1;
+        }
+        const int size = PentrisLinearEvaluator::FeatureCount(FIELD_WIDTH);
+        std::vector<double> mean = evaluator.RealWeights();
+        std::vector<double> deviation(size);
+        for (int i = 0; i < size; i++)
+            deviation[i] = std::max(std::fabs(mean[i]) * 0.1, 0.1);
+        std::mt19937 rng(12345);
+        const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+        for (int iteration = 0; iteration < iterations; iteration++)
+        {
+            std::vector<std::vector<double>> population(TUNE_POPULATION, std::vector<double>(size));
+            //The current mean competes as well, so an iteration never settles on a worse mean by chance
+            population[0] = mean;
+            for (int c = 1; c < TUNE_POPULATION; c++)
+                for (int i = 0; i < size; i++)
+                    population[c][i] = std::normal_distribution<double>(mean[i], deviation[i])(rng);
+            //All candidates play the same games, so that they are compared on equal terms
+            std::vector<std::uint32_t> seeds(TUNE_GAMES);
+            for (auto& seed : seeds)
+                seed = rng();
+            std::vector<long long> lines(TUNE_POPULATION, 0);
+            std::atomic<int> next{ 0 };
+            auto Worker = [&]()
+            {
+                PentrisSimulation simulation(FIELD_WIDTH, FIELD_HEIGHT);
+                simulation.maxPieces = TUNE_MAX_PIECES;
+                for (int index = next++; index < TUNE_POPULATION; index = next++)
+                {
+                    auto candidate = std::make_shared<PentrisLinearEvaluator>(FIELD_WIDTH, FIELD_HEIGHT);
+                    candidate->SetWeights(population[index]);
+                    simulation.SetEvaluator(candidate);
+                    for (const std::uint32_t seed : seeds)
+                    {
+                        simulation.PlayGame(seed);
+                        lines[index] += simulation.Lines();
+                    }
+                }
+            };
+            std::vector<std::thread> workers;
+            for (unsigned i = 0; i < threads; i++)
+                workers.emplace_back(Worker);
+            for (auto& worker : workers)
+                worker.join();
+
+            std::vector<int> order(TUNE_POPULATION);
+            for (int i = 0; i < TUNE_POPULATION; i++)
+                order[i] = i;
+            std::sort(order.begin(), order.end(), [&](int a, int b) { return lines[a] > lines[b]; });
+            for (int i = 0; i < size; i++)
+            {
+                double sum = 0, sumSquares = 0;
+                for (int e = 0; e < TUNE_ELITE; e++)
+                {
+                    sum += population[order[e]][i];
+                    sumSquares += population[order[e]][i] * population[order[e]][i];
+                }
+                mean[i] = sum / TUNE_ELITE;
+                //Extra noise that fades out over the iterations keeps the search from collapsing early
+                deviation[i] = std::sqrt(std::max(0.0, sumSquares / TUNE_ELITE - mean[i] * mean[i])) + 0.1 * (iterations - iteration) / iterations;
+            }
+            std::cout << "Iteration " << iteration + 1 << ": best " << (double)lines[order[0]] / TUNE_GAMES << " lines per game, elite "
+                << (double)lines[order[TUNE_ELITE - 1]] / TUNE_GAMES << std::endl;
+            evaluator.SetWeights(mean);
+            if (!evaluator.Save(weightsPath))
+            {
+                std::cout << "Could not write weights " << weightsPath << std::endl;
+                return 1;
+            }
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if ((argc >= 4) && (std::strcmp(argv[1], "selfplay") == 0))
+        return SelfPlay(argv[2], std::atoi(argv[3]), (argc >= 5) ? argv[4] : "", (argc >= 6) ? std::atoi(argv[5]) : 2000);
+    if ((argc >= 4) && (std::strcmp(argv[1], "fit") == 0))
+        return Fit(argv[2], argv[3], (argc >= 5) ? std::atof(argv[4]) : 0.95, (argc >= 6) ? std::atof(argv[5]) : 50.0);
+    if ((argc >= 3) && (std::strcmp(argv[1], "tune") == 0))
+        return Tune(argv[2], (argc >= 4) ? std::atoi(argv[3]) : 20, (argc >= 5) ? argv[4] : "");
+    std::cout << "Usage: " << argv[0] << " selfplay <replay file> <games> [weights file] [max pieces]" << std::endl;
+    std::cout << "       " << argv[0] << " fit <weights file> <replay file> [discount] [game over penalty]" << std::endl;
+    std::cout << "       " << argv[0] << " tune <weights file> [iterations] [initial weights file]" << std::endl;
+    return 1;
+}